@@ -58,11 +58,13 @@ bool build_common_linux()
 
         bool rebuild = nob_needs_rebuild1(object_file, source_file);
         rebuild = rebuild || nob_needs_rebuild1(object_file, COMMON_H_PATH);
+        rebuild = rebuild || nob_needs_rebuild1(object_file, SEARCH_STATS_PATH);
         if(!rebuild) continue;
 
         nob_cmd_append(&cmd, COMPILER, "-fPIC");
         nob_cmd_append(&cmd, "-c", source_file);
         nob_cmd_append(&cmd, "-o", object_file);
+        if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
         nob_cmd_append(&cmd, "-O3", "-ggdb");
 
         Nob_Proc proc = nob_cmd_run_async_and_reset(&cmd);
@@ -99,6 +101,7 @@ bool build_client_linux()
     if (!rebuild) return true;
 
     nob_cmd_append(&cmd, COMPILER, "-o", CLIENT_OUTPUT_PATH);
+    if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
 
     for(int i = 0; i < deps.count; i++)
     {
@@ -106,7 +109,7 @@ bool build_client_linux()
     }
 
     nob_cmd_append(&cmd, "-I"RAYLIB_SRC_DIR, "-I"BUILD_DIR);
-    nob_cmd_append(&cmd, "-lm", "-O1", "-ggdb");
+    nob_cmd_append(&cmd, "-lm", "-lpthread", "-O1", "-ggdb");
 
     if(!nob_cmd_run_sync(cmd)) return false;
 
@@ -124,19 +127,44 @@ bool build_server_linux()
     if (!rebuild) return true;
 
     nob_cmd_append(&cmd, COMPILER, "-o", SERVER_OUTPUT_PATH);
+    if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
 
     for(int i = 0; i < deps.count; i++)
     {
         nob_cmd_append(&cmd, deps.items[i]);
     }
 
-    nob_cmd_append(&cmd, "-lm", "-O1", "-ggdb");
+    nob_cmd_append(&cmd, "-lm", "-lpthread", "-O1", "-ggdb");
 
     if(!nob_cmd_run_sync(cmd)) return false;
 
     return true;
 }
 
+bool build_tools_linux()
+{
+    Nob_Cmd cmd = {0};
+
+    for(int i = 0; i < NOB_ARRAY_LEN(tools); i++)
+    {
+        char *output_path = nob_temp_sprintf("%s%s", BUILD_DIR, tools[i].name);
+        const char *deps[] = { tools[i].source, COMMON_PATH };
+
+        bool rebuild = nob_needs_rebuild(output_path, deps, NOB_ARRAY_LEN(deps));
+        if (!rebuild) continue;
+
+        cmd.count = 0;
+        nob_cmd_append(&cmd, COMPILER, "-o", output_path);
+        if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
+        nob_cmd_append(&cmd, tools[i].source, COMMON_PATH);
+        nob_cmd_append(&cmd, "-lm", "-lpthread", "-O3", "-ggdb");
+
+        if(!nob_cmd_run_sync(cmd)) return false;
+    }
+
+    return true;
+}
+
 #undef COMPILER
 #undef PLATFORM_PREFIX
 #undef LIBRAYLIB_PATH
@@ -60,11 +60,13 @@ bool build_common_mingw()
 
         bool rebuild = nob_needs_rebuild1(object_file, source_file);
         rebuild = rebuild || nob_needs_rebuild1(object_file, COMMON_H_PATH);
+        rebuild = rebuild || nob_needs_rebuild1(object_file, SEARCH_STATS_PATH);
         if(!rebuild) continue;
 
         nob_cmd_append(&cmd, COMPILER, "-fPIC");
         nob_cmd_append(&cmd, "-c", source_file);
         nob_cmd_append(&cmd, "-o", object_file);
+        if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
         nob_cmd_append(&cmd, "-O3");
 
         Nob_Proc proc = nob_cmd_run_async_and_reset(&cmd);
@@ -100,6 +102,7 @@ bool build_client_mingw()
     if (!rebuild) return true;
 
     nob_cmd_append(&cmd, COMPILER, "-o", CLIENT_OUTPUT_PATH".exe");
+    if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
 
     for(int i = 0; i < deps.count; i++)
     {
@@ -126,6 +129,7 @@ bool build_server_mingw()
     if (!rebuild) return true;
 
     nob_cmd_append(&cmd, COMPILER, "-o", SERVER_OUTPUT_PATH);
+    if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
 
     for(int i = 0; i < deps.count; i++)
     {
@@ -140,6 +144,31 @@ bool build_server_mingw()
     return true;
 }
 
+bool build_tools_mingw()
+{
+    Nob_Cmd cmd = {0};
+
+    for(int i = 0; i < NOB_ARRAY_LEN(tools); i++)
+    {
+        char *output_path = nob_temp_sprintf("%s%s.exe", BUILD_DIR, tools[i].name);
+        const char *deps[] = { tools[i].source, COMMON_PATH };
+
+        bool rebuild = nob_needs_rebuild(output_path, deps, NOB_ARRAY_LEN(deps));
+        if (!rebuild) continue;
+
+        cmd.count = 0;
+        nob_cmd_append(&cmd, COMPILER, "-o", output_path);
+        if(search_stats) nob_cmd_append(&cmd, "-DSEARCH_STATS");
+        nob_cmd_append(&cmd, tools[i].source, COMMON_PATH);
+        nob_cmd_append(&cmd, "-lm", "-O3");
+        nob_cmd_append(&cmd, "-static-libgcc", "-lwinmm", "-lws2_32");
+
+        if(!nob_cmd_run_sync(cmd)) return false;
+    }
+
+    return true;
+}
+
 #undef COMPILER
 #undef PLATFORM_PREFIX
 #undef LIBRAYLIB_PATH
@@ -22,6 +22,7 @@
 #define BUNDLE_H_PATH BUILD_DIR"bundle.h"
 #define SHIP_DIR "./ship/"
 #define COMMON_H_PATH COMMON_DIR"common.h"
+#define SEARCH_STATS_PATH BUILD_DIR"search_stats"
 
 typedef struct {
     char   *file;
@@ -29,6 +30,11 @@ typedef struct {
     size_t length;
 } Asset;
 
+typedef struct {
+    char *name;
+    char *source;
+} Tool;
+
 char *raylib_modules[] = {
     "rcore",
     "rglfw",
@@ -46,6 +52,31 @@ char *common_files[] = {
     "fen",
     "sockets",
     "movenotation",
+    "zobrist",
+    "platform",
+    "movecache",
+    "eval",
+    "nnue",
+    "tablebase",
+    "book",
+    "protocol",
+    "transposition",
+    "timemanager",
+    "search",
+    "mcts",
+    "analysis",
+};
+
+// command line tools, each one is a single source file linked against common.a
+Tool tools[] = {
+    { .name = "3_man_chess_perft",     .source = SRC_DIR"perft.c" },
+    { .name = "3_man_chess_nnue",      .source = SRC_DIR"nnuetool.c" },
+    { .name = "3_man_chess_tbgen",     .source = SRC_DIR"tbgen.c" },
+    { .name = "3_man_chess_book",      .source = SRC_DIR"booktool.c" },
+    { .name = "3_man_chess_engine",    .source = SRC_DIR"engine.c" },
+    { .name = "3_man_chess_matesolve", .source = SRC_DIR"matesolve.c" },
+    { .name = "3_man_chess_selfplay",  .source = SRC_DIR"selfplay.c" },
+    { .name = "3_man_chess_tune",      .source = SRC_DIR"tuner.c" },
 };
 
 Asset assets[] = {
@@ -58,6 +89,26 @@ Asset assets[] = {
     { .file = "illegal.mp3",   .offset = 0, .length = 0 },
 };
 
+// --stats compiles SEARCH_STATS in, see common.h
+bool search_stats = false;
+
+// the common objects depend on this file, it is only rewritten when --stats
+// changes so that switching it rebuilds them
+bool remember_search_stats()
+{
+    const char *content = search_stats ? "1\n" : "0\n";
+
+    Nob_String_Builder previous = { 0 };
+    if(nob_file_exists(SEARCH_STATS_PATH) == 1 && nob_read_entire_file(SEARCH_STATS_PATH, &previous))
+    {
+        bool same = previous.count == strlen(content) && memcmp(previous.items, content, previous.count) == 0;
+        nob_sb_free(previous);
+        if(same) return true;
+    }
+
+    return nob_write_entire_file(SEARCH_STATS_PATH, content, strlen(content));
+}
+
 #include "build_src/nob_linux.c"
 #include "build_src/nob_mingw.c"
 
@@ -124,61 +175,82 @@ bool bundle_assets()
 int main(int argc, char **argv)
 {
     NOB_GO_REBUILD_URSELF_PLUS(argc, argv, "./build_src/nob_linux.c", "./build_src/nob_mingw.c", "./version.h");
+
+    char *program = nob_shift_args(&argc, &argv);
+    bool ship = false;
+
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--help") == 0)
+        {
+            printf("usage: %s [options]\n", program);
+            printf("options:\n");
+            printf("\t--help: print this message\n");
+            printf("\t--ship: make files ready for shipping\n");
+            printf("\t--stats: build with SEARCH_STATS, to count where the nodes of a search go\n");
+            return 0;
+        }
+        else if(strcmp(option, "--ship") == 0)
+        {
+            ship = true;
+        }
+        else if(strcmp(option, "--stats") == 0)
+        {
+            search_stats = true;
+        }
+        else
+        {
+            nob_log(NOB_ERROR, "unknown option %s, see --help", option);
+            return 1;
+        }
+    }
+
     if(!nob_mkdir_if_not_exists(BUILD_DIR)) return 1;
     if(!nob_mkdir_if_not_exists(RAYLIB_BUILD_DIR)) return 1;
 
     if(!bundle_assets()) return 1;
+    if(!remember_search_stats()) return 1;
 
     if(!build_raylib_linux()) return 1;
     if(!build_common_linux()) return 1;
     if(!build_client_linux()) return 1;
     if(!build_server_linux()) return 1;
+    if(!build_tools_linux())  return 1;
 
     if(!build_raylib_mingw()) return 1;
     if(!build_common_mingw()) return 1;
     if(!build_client_mingw()) return 1;
     if(!build_server_mingw()) return 1;
+    if(!build_tools_mingw())  return 1;
 
-    char *program = nob_shift_args(&argc, &argv);
-
-    if(argc > 0)
+    if(ship)
     {
-        char *option = nob_shift_args(&argc, &argv);
-        if(strcmp(option, "--help") == 0)
-        {
-            printf("usage: %s\n", program);
-            printf("options:\n");
-            printf("\t--help: print this message\n");
-            printf("\t--ship: make files ready for shipping\n");
-        }
-        else if(strcmp(option, "--ship") == 0)
-        {
-            if(!nob_mkdir_if_not_exists(SHIP_DIR)) return 1;
-
-            printf("preparing files for shipping!\n");
-            const char *linux_archive = nob_temp_sprintf(SHIP_DIR"3_man_chess_%d.%d.%d_linux.zip", MAJOR, MINOR, PATCH);
-            const char *windows_archive = nob_temp_sprintf(SHIP_DIR"3_man_chess_%d.%d.%d_windows.zip", MAJOR, MINOR, PATCH);
-
-            const char *linux_client_ship_path   = nob_temp_sprintf("%s/%s_%d.%d.%d",     THREE_MAN_CHESS, CLIENT_NAME, MAJOR, MINOR, PATCH);
-            const char *linux_server_ship_path   = nob_temp_sprintf("%s/%s_%d.%d.%d",     THREE_MAN_CHESS, SERVER_NAME, MAJOR, MINOR, PATCH);
-            const char *windows_client_ship_path = nob_temp_sprintf("%s/%s_%d.%d.%d.exe", THREE_MAN_CHESS, CLIENT_NAME, MAJOR, MINOR, PATCH);
-            const char *windows_server_ship_path = nob_temp_sprintf("%s/%s_%d.%d.%d.exe", THREE_MAN_CHESS, SERVER_NAME, MAJOR, MINOR, PATCH);
-
-            if(!nob_mkdir_if_not_exists(THREE_MAN_CHESS)) return 1;
-            if(!nob_copy_file(CLIENT_OUTPUT_PATH,       linux_client_ship_path))   return 1;
-            if(!nob_copy_file(SERVER_OUTPUT_PATH,       linux_server_ship_path))   return 1;
-            if(!nob_copy_file(CLIENT_OUTPUT_PATH".exe", windows_client_ship_path)) return 1;
-            if(!nob_copy_file(SERVER_OUTPUT_PATH".exe", windows_server_ship_path)) return 1;
-
-            Nob_Cmd cmd = { 0 };
-            nob_cmd_append(&cmd, "zip", "-q", linux_archive);
-            nob_cmd_append(&cmd, linux_client_ship_path, linux_server_ship_path);
-            nob_cmd_run_sync_and_reset(&cmd);
-
-            nob_cmd_append(&cmd, "zip", "-q", windows_archive);
-            nob_cmd_append(&cmd, windows_client_ship_path, windows_server_ship_path);
-            nob_cmd_run_sync_and_reset(&cmd);
-        }
+        if(!nob_mkdir_if_not_exists(SHIP_DIR)) return 1;
+
+        printf("preparing files for shipping!\n");
+        const char *linux_archive = nob_temp_sprintf(SHIP_DIR"3_man_chess_%d.%d.%d_linux.zip", MAJOR, MINOR, PATCH);
+        const char *windows_archive = nob_temp_sprintf(SHIP_DIR"3_man_chess_%d.%d.%d_windows.zip", MAJOR, MINOR, PATCH);
+
+        const char *linux_client_ship_path   = nob_temp_sprintf("%s/%s_%d.%d.%d",     THREE_MAN_CHESS, CLIENT_NAME, MAJOR, MINOR, PATCH);
+        const char *linux_server_ship_path   = nob_temp_sprintf("%s/%s_%d.%d.%d",     THREE_MAN_CHESS, SERVER_NAME, MAJOR, MINOR, PATCH);
+        const char *windows_client_ship_path = nob_temp_sprintf("%s/%s_%d.%d.%d.exe", THREE_MAN_CHESS, CLIENT_NAME, MAJOR, MINOR, PATCH);
+        const char *windows_server_ship_path = nob_temp_sprintf("%s/%s_%d.%d.%d.exe", THREE_MAN_CHESS, SERVER_NAME, MAJOR, MINOR, PATCH);
+
+        if(!nob_mkdir_if_not_exists(THREE_MAN_CHESS)) return 1;
+        if(!nob_copy_file(CLIENT_OUTPUT_PATH,       linux_client_ship_path))   return 1;
+        if(!nob_copy_file(SERVER_OUTPUT_PATH,       linux_server_ship_path))   return 1;
+        if(!nob_copy_file(CLIENT_OUTPUT_PATH".exe", windows_client_ship_path)) return 1;
+        if(!nob_copy_file(SERVER_OUTPUT_PATH".exe", windows_server_ship_path)) return 1;
+
+        Nob_Cmd cmd = { 0 };
+        nob_cmd_append(&cmd, "zip", "-q", linux_archive);
+        nob_cmd_append(&cmd, linux_client_ship_path, linux_server_ship_path);
+        nob_cmd_run_sync_and_reset(&cmd);
+
+        nob_cmd_append(&cmd, "zip", "-q", windows_archive);
+        nob_cmd_append(&cmd, windows_client_ship_path, windows_server_ship_path);
+        nob_cmd_run_sync_and_reset(&cmd);
     }
 
     return 0;
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_PLIES 24
+
+// opening book builder
+//
+// the input has one game per line, moves separated by spaces, either written
+// like GetMoveNotation writes them (WKd3, xGe5, O-O) or as raw start,target,flag
+// triples. move numbers ending in a dot are skipped, lines starting with # are
+// comments and xxx (an eliminated colour's turn) ends the game. every chunk of
+// the input is replayed and sorted on its own thread, then the sorted chunks
+// are merged in pairs until one is left
+
+typedef struct {
+    BookEntry *items;
+    size_t count;
+    size_t capacity;
+} BookEntries;
+
+typedef struct {
+    const char *text;
+    size_t size;
+    int plies;
+    int chunkCount;
+    BookEntries *chunks;
+    uint64_t *games;
+    uint64_t *errors;
+    int mergeStep;
+} Builder;
+
+// sorted entries with the weights of equal moves added up
+static void SortAndMerge(BookEntries *entries)
+{
+    if(entries->count == 0) return;
+    qsort(entries->items, entries->count, sizeof(BookEntry), CompareBookEntries);
+
+    size_t count = 1;
+    for(size_t i = 1; i < entries->count; i++)
+    {
+        BookEntry *last = &entries->items[count-1];
+        if(CompareBookEntries(last, &entries->items[i]) == 0)
+        {
+            uint64_t weight = (uint64_t)last->weight + entries->items[i].weight;
+            last->weight = (weight > UINT32_MAX) ? UINT32_MAX : weight;
+        }
+        else entries->items[count++] = entries->items[i];
+    }
+    entries->count = count;
+}
+
+static void ReplayGame(Builder *builder, int chunk, Board *board, char *line)
+{
+    InitBoard(board, DEFAULT_FEN);
+
+    int ply = 0;
+    char *cursor = line;
+    while(ply < builder->plies)
+    {
+        while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r') cursor++;
+        if(*cursor == '\0') break;
+        char *token = cursor;
+        while(*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r') cursor++;
+        if(*cursor != '\0') *cursor++ = '\0';
+
+        if(token[strlen(token)-1] == '.') continue;
+        // the result some lines end with, like 0-1-0, ends the game
+        if(token[0] >= '0' && token[0] <= '9' && strchr(token, '-') != NULL) break;
+        if(strcmp(token, "xxx") == 0)
+        {
+            // the second one ends the game, only the result can follow
+            if(board->eliminatedColour != NONE) break;
+            EliminateColour(board, board->colourToMove);
+            NextMove(board);
+            continue;
+        }
+
+        Move move;
+        if(!ParseMoveToken(board, token, &move))
+        {
+            builder->errors[chunk]++;
+            break;
+        }
+
+        BookEntry entry = { .key = board->hash, .weight = 1, .start = move.start, .target = move.target, .flag = move.flag };
+        nob_da_append(&builder->chunks[chunk], entry);
+        MakeMove(board, move);
+        ply++;
+    }
+    builder->games[chunk]++;
+}
+
+// lines that start inside a chunk belong to it
+static void ReplayChunk(void *arg, int chunk)
+{
+    Builder *builder = arg;
+    static _Thread_local Board board = { 0 };
+    size_t start = builder->size * chunk / builder->chunkCount;
+    size_t end   = builder->size * (chunk + 1) / builder->chunkCount;
+    if(start > 0) while(start < builder->size && builder->text[start-1] != '\n') start++;
+
+    char line[4096];
+    while(start < end)
+    {
+        size_t length = 0;
+        while(start + length < builder->size && builder->text[start + length] != '\n') length++;
+
+        if(length > 0 && length < sizeof(line) && builder->text[start] != '#')
+        {
+            memcpy(line, &builder->text[start], length);
+            line[length] = '\0';
+            ReplayGame(builder, chunk, &board, line);
+        }
+        else if(length >= sizeof(line)) builder->errors[chunk]++;
+        start += length + 1;
+    }
+
+    SortAndMerge(&builder->chunks[chunk]);
+}
+
+// merges chunk index*2*step with the one step after it, both sorted
+static void MergeChunks(void *arg, int index)
+{
+    Builder *builder = arg;
+    int first  = index * 2 * builder->mergeStep;
+    int second = first + builder->mergeStep;
+    if(second >= builder->chunkCount) return;
+
+    BookEntries *a = &builder->chunks[first];
+    BookEntries *b = &builder->chunks[second];
+    BookEntries merged = { 0 };
+    nob_da_reserve(&merged, a->count + b->count);
+
+    size_t i = 0, j = 0;
+    while(i < a->count || j < b->count)
+    {
+        BookEntry entry;
+        if(j == b->count || (i < a->count && CompareBookEntries(&a->items[i], &b->items[j]) <= 0)) entry = a->items[i++];
+        else entry = b->items[j++];
+
+        BookEntry *last = (merged.count > 0) ? &merged.items[merged.count-1] : NULL;
+        if(last != NULL && CompareBookEntries(last, &entry) == 0)
+        {
+            uint64_t weight = (uint64_t)last->weight + entry.weight;
+            last->weight = (weight > UINT32_MAX) ? UINT32_MAX : weight;
+        }
+        else merged.items[merged.count++] = entry;
+    }
+
+    free(a->items);
+    free(b->items);
+    *a = merged;
+    *b = (BookEntries) { 0 };
+}
+
+static int Build(const char *gamesPath, const char *bookPath, int plies, uint32_t minWeight, int threads)
+{
+    size_t size;
+    void *text = MapFile(gamesPath, &size);
+    if(text == NULL)
+    {
+        fprintf(stderr, "could not read %s\n", gamesPath);
+        return 1;
+    }
+
+    ThreadPool *pool = CreateThreadPool(threads);
+    Builder builder = { .text = text, .size = size, .plies = plies };
+    builder.chunkCount = ThreadPoolSize(pool) * 8;
+    builder.chunks = calloc(builder.chunkCount, sizeof(BookEntries));
+    builder.games  = calloc(builder.chunkCount, sizeof(uint64_t));
+    builder.errors = calloc(builder.chunkCount, sizeof(uint64_t));
+
+    double start = GetMonotonicTime();
+    ParallelFor(pool, builder.chunkCount, ReplayChunk, &builder);
+    double replayTime = GetMonotonicTime() - start;
+
+    for(builder.mergeStep = 1; builder.mergeStep < builder.chunkCount; builder.mergeStep *= 2)
+    {
+        int pairs = (builder.chunkCount + 2 * builder.mergeStep - 1) / (2 * builder.mergeStep);
+        ParallelFor(pool, pairs, MergeChunks, &builder);
+    }
+
+    BookEntries *book = &builder.chunks[0];
+    size_t kept = 0;
+    for(size_t i = 0; i < book->count; i++) if(book->items[i].weight >= minWeight) book->items[kept++] = book->items[i];
+
+    uint64_t games = 0, errors = 0;
+    for(int i = 0; i < builder.chunkCount; i++)
+    {
+        games  += builder.games[i];
+        errors += builder.errors[i];
+    }
+
+    bool ok = WriteOpeningBook(bookPath, book->items, kept);
+    printf("%llu games (%llu with unreadable moves), %llu of %llu moves kept\n",
+           (unsigned long long)games, (unsigned long long)errors, (unsigned long long)kept, (unsigned long long)book->count);
+    printf("replayed in %.2fs, %.2fs total on %d threads -> %s\n",
+           replayTime, GetMonotonicTime() - start, ThreadPoolSize(pool), ok ? bookPath : "write failed");
+
+    for(int i = 0; i < builder.chunkCount; i++) free(builder.chunks[i].items);
+    free(builder.chunks);
+    free(builder.games);
+    free(builder.errors);
+    DestroyThreadPool(pool);
+    UnmapFile(text, size);
+    return ok ? 0 : 1;
+}
+
+// prints the book moves after the given moves
+static int Probe(const char *bookPath, int argc, char **argv)
+{
+    OpeningBook *book = LoadOpeningBook(bookPath);
+    if(book == NULL)
+    {
+        fprintf(stderr, "could not load %s, is it a book of this version?\n", bookPath);
+        return 1;
+    }
+
+    Board board = { 0 };
+    InitBoard(&board, DEFAULT_FEN);
+    while(argc > 0)
+    {
+        char *token = nob_shift_args(&argc, &argv);
+        Move move;
+        if(!ParseMoveToken(&board, token, &move))
+        {
+            fprintf(stderr, "%s is not a legal move here\n", token);
+            FreeOpeningBook(book);
+            return 1;
+        }
+        MakeMove(&board, move);
+    }
+
+    int count;
+    const BookEntry *entries = ProbeOpeningBook(book, &board, &count);
+    uint64_t total = 0;
+    for(int i = 0; i < count; i++) total += entries[i].weight;
+
+    MoveNotations notations = { 0 };
+    for(int i = 0; i < count; i++)
+    {
+        Move move = { .start = entries[i].start, .target = entries[i].target, .flag = entries[i].flag };
+        GetMoveNotation(&board, move, &notations);
+        printf("%-8s %10u %6.2f%%\n", notations.items[i], entries[i].weight, 100.0 * entries[i].weight / total);
+    }
+    if(count == 0) printf("position is not in the book\n");
+
+    // the lookup itself, repeated to get a number that means something
+    int lookups = 1000000;
+    volatile int sink = 0;
+    double start = GetMonotonicTime();
+    for(int i = 0; i < lookups; i++)
+    {
+        ProbeOpeningBook(book, &board, &count);
+        sink += count;
+    }
+    double elapsed = GetMonotonicTime() - start;
+    printf("%llu entries, %.0f lookups/s\n", (unsigned long long)OpeningBookSize(book), lookups / elapsed);
+
+    for(size_t i = 0; i < notations.count; i++) free(notations.items[i]);
+    free(notations.items);
+    FreeOpeningBook(book);
+    return 0;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <command> [options]\n", program);
+    printf("commands:\n");
+    printf("\tbuild <games> <book> [options]: build a book from a file with one game per line\n");
+    printf("\t    --plies <n>:      moves of every game that go in the book (default %d)\n", DEFAULT_PLIES);
+    printf("\t    --min-weight <n>: leave out moves played fewer times (default 1)\n");
+    printf("\t    --threads <n>:    worker threads, 0 for one per core (default 0)\n");
+    printf("\tprobe <book> [moves]:          print the book moves after the given moves\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc < 2)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    GenerateMoveData();
+    char *command = nob_shift_args(&argc, &argv);
+
+    if(strcmp(command, "build") == 0 && argc >= 2)
+    {
+        char *gamesPath = nob_shift_args(&argc, &argv);
+        char *bookPath  = nob_shift_args(&argc, &argv);
+        int plies = DEFAULT_PLIES;
+        uint32_t minWeight = 1;
+        int threads = 0;
+        while(argc > 0)
+        {
+            char *option = nob_shift_args(&argc, &argv);
+            if(strcmp(option, "--plies") == 0 && argc > 0)           plies = atoi(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--min-weight") == 0 && argc > 0) minWeight = strtoul(nob_shift_args(&argc, &argv), NULL, 10);
+            else if(strcmp(option, "--threads") == 0 && argc > 0)    threads = atoi(nob_shift_args(&argc, &argv));
+            else
+            {
+                PrintUsage(program);
+                return 1;
+            }
+        }
+        return Build(gamesPath, bookPath, plies, minWeight, threads);
+    }
+
+    if(strcmp(command, "probe") == 0)
+    {
+        char *bookPath = nob_shift_args(&argc, &argv);
+        return Probe(bookPath, argc, argv);
+    }
+
+    PrintUsage(program);
+    return 1;
+}
@@ -23,6 +23,10 @@
 #define WIDTH 1920
 #define HEIGHT 1080
 
+#define ANALYSIS_HASH_MB    64
+#define ANALYSIS_CACHE_SIZE 256
+#define ANALYSIS_MAX_LINES  5
+
 typedef struct {
     Move move;
     Vector2 position;
@@ -45,6 +49,12 @@ typedef struct {
     bool      toggled;
 } Button;
 
+typedef struct {
+    Move  *items;
+    size_t count;
+    size_t capacity;
+} AnalysisLine;
+
 static const int rankSize = 60;
 static const int pieceSize = 60;
 static const int centerSize = 100;
@@ -64,6 +74,9 @@ static const int gameButtonWidth = MoveListWindow.width / 2 - buttonPadding / 2;
 
 static const float drawFontSize = 30.0f;
 
+static const Rectangle EvalBar = { .x = 1490, .y = 200, .width = 40, .height = 600 };
+static const Rectangle AnalysisWindow = { .x = 1550, .y = 810, .width = 300, .height = 220 };
+
 enum Button {
     BUTTONREMATCH,
     BUTTONEXIT,
@@ -170,6 +183,7 @@ enum GameState {
     CONNECTFAILED,
     CONNECTING,
     GAMEALREADYSTARTED,
+    ANALYSIS,
 };
 
 enum GameState gameState  = NOGAME;
@@ -191,10 +205,25 @@ enum Highlight {
 int selectedSquare = -1;
 enum Highlight highlightedSquares[144];
 
-MoveList moveList = {0};
+MoveCache moveCache = {0};
 Move lastMove = nullMove;
 MoveNotations moveNotations;
 
+OpeningBook *book = NULL;
+bool showBookMoves = false;
+
+// offline analysis, entered with A from the lobby. the board shows the first
+// analysisPly moves of analysisLine played from analysisFEN, a null move in
+// the line is the colour to move being checkmated
+Analysis *analysis = NULL;
+int analysisThreads = 1;
+char analysisFEN[256];
+AnalysisLine analysisLine = {0};
+int analysisPly = 0;
+AnalysisInfo analysisCache[ANALYSIS_CACHE_SIZE]; // the deepest result seen of a position, by hash
+int analysisLineCount = 1; // best moves the engine looks for, changed with up and down
+char analysisLineTexts[MAX_MULTIPV][64]; // the first moves of every line as the move list writes them
+
 Vector2 SquareCenterCoords[144];
 
 const double animationDuration = 0.2f;
@@ -231,6 +260,8 @@ void DrawEndScreen();
 void DrawButton(enum Button buttonIndex);
 void DrawMoveList();
 void DrawDrawUI();
+void DrawBookMoves(Board *board);
+void DrawAnalysis(Board *board);
 void UpdateAnimation(Animation *animation, double deltaTime);
 
 int PollConnection();
@@ -240,8 +271,40 @@ void Send(int fd, Message *msg);
 bool LoadAudio();
 void PlayMoveAudio(Board *board, Move move);
 
-int main()
+void EnterAnalysis(Board *board);
+void LeaveAnalysis(Board *board);
+void SetAnalysisPly(Board *board, int ply);
+void UpdateLineTexts(Board *board);
+void PlayAnalysisMove(Board *board, Move move);
+void UpdateAnalysis(Board *board);
+
+int main(int argc, char **argv)
 {
+    char *program = nob_shift_args(&argc, &argv);
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--book") == 0 && argc > 0)
+        {
+            char *path = nob_shift_args(&argc, &argv);
+            book = LoadOpeningBook(path);
+            if(book == NULL) printf("could not load opening book %s\n", path);
+        }
+        else if(strcmp(option, "--analysis-threads") == 0 && argc > 0)
+        {
+            analysisThreads = atoi(nob_shift_args(&argc, &argv));
+        }
+        else
+        {
+            printf("usage: %s [options]\n", program);
+            printf("options:\n");
+            printf("\t--help:                   print this message\n");
+            printf("\t--book <file>:            show the book moves of the position, toggled with B\n");
+            printf("\t--analysis-threads <n>:   threads the engine analyses with, entered with A (default 1)\n");
+            return strcmp(option, "--help") == 0 ? 0 : 1;
+        }
+    }
+
     if(InitSockets() != 0) return 1;
 
     Board board = {0};
@@ -275,7 +338,8 @@ int main()
     while(!WindowShouldClose())
     {
         double deltaTime = GetFrameTime();
-        UpdateTextBox(&ip[0], &charCount, MAX_CHARS);
+        if(gameState == ANALYSIS) UpdateAnalysis(&board);
+        else UpdateTextBox(&ip[0], &charCount, MAX_CHARS);
         UpdateGame(&board, deltaTime);
 
         buttons[BUTTONREMATCH].active     = gameState == GAMEOVER;
@@ -308,6 +372,14 @@ int main()
             ToggleFullscreen();
         }
 
+        if(IsKeyPressed(KEY_B) && book != NULL) showBookMoves = !showBookMoves;
+
+        if(IsKeyPressed(KEY_A))
+        {
+            if(gameState == ANALYSIS) LeaveAnalysis(&board);
+            else if(sock == NULL) EnterAnalysis(&board);
+        }
+
         if(IsKeyPressed(KEY_ENTER) && charCount > 0)
         {
             if(gameState != CONNECTING && gameState != YESGAME)
@@ -332,6 +404,7 @@ int main()
         {
             DrawClock(&board);
             DrawMoveList();
+            if(showBookMoves) DrawBookMoves(&board);
             DrawButton(BUTTONRESIGN);
             DrawButton(BUTTONDRAW);
 
@@ -345,6 +418,12 @@ int main()
             DrawClock(&board);
             DrawEndScreen();
         }
+        else if(gameState == ANALYSIS)
+        {
+            DrawMoveList();
+            DrawAnalysis(&board);
+            if(showBookMoves) DrawBookMoves(&board);
+        }
         else 
         {
             if(gameState == CONNECTING)
@@ -381,8 +460,10 @@ int main()
         Close(sock);
     }
 
+    if(analysis != NULL) StopAnalysis(analysis);
     CloseAudioDevice();
     CleanupSockets();
+    if(book != NULL) FreeOpeningBook(book);
     UnloadRenderTexture(target);
     CloseWindow();
     return 0;
@@ -489,6 +570,173 @@ void UpdateGame(Board *board, double deltaTime)
     }
 }
 
+void EnterAnalysis(Board *board)
+{
+    analysis = StartAnalysis(ANALYSIS_HASH_MB, analysisThreads);
+    if(analysis == NULL) return;
+    SetAnalysisLines(analysis, analysisLineCount);
+
+    gameState = ANALYSIS;
+    strcpy(analysisFEN, DEFAULT_FEN);
+    analysisLine.count = 0;
+    memset(analysisCache, 0, sizeof(analysisCache));
+    SetAnalysisPly(board, 0);
+}
+
+void LeaveAnalysis(Board *board)
+{
+    StopAnalysis(analysis);
+    analysis = NULL;
+    gameState = NOGAME;
+    selectedSquare = -1;
+    ResetSquares();
+    moveNotations.count = 0;
+    lastMove = nullMove;
+    InitBoard(board, DEFAULT_FEN);
+}
+
+// replays the line up to ply and hands the position to the engine, whatever
+// it found there before is still in analysisCache and its hash table
+void SetAnalysisPly(Board *board, int ply)
+{
+    char FEN[256];
+    strcpy(FEN, analysisFEN);
+    InitBoard(board, FEN);
+    moveNotations.count = 0;
+
+    for(int i = 0; i < ply; i++)
+    {
+        Move move = analysisLine.items[i];
+        GetMoveNotation(board, move, &moveNotations);
+        if(IsNullMove(move))
+        {
+            EliminateColour(board, board->colourToMove);
+            NextMove(board);
+        }
+        else MakeMove(board, move);
+    }
+
+    analysisPly = ply;
+    lastMove = (ply > 0) ? analysisLine.items[ply-1] : nullMove;
+    assignedColour = board->colourToMove;
+    selectedSquare = -1;
+    ResetSquares();
+    BuildMoveCache(&moveCache, board);
+    UpdateLineTexts(board);
+    AnalysePosition(analysis, board);
+}
+
+// the lines of the position as they are written in the move list, done
+// when a result comes in rather than every frame
+void UpdateLineTexts(Board *board)
+{
+    AnalysisInfo *info = &analysisCache[board->hash % ANALYSIS_CACHE_SIZE];
+    if(info->key != board->hash) return;
+
+    MoveNotations notations = {0};
+    for(int line = 0; line < info->result.lineCount; line++)
+    {
+        SearchLine *searchLine = &info->result.lines[line];
+        Board after = *board;
+        notations.count = 0;
+        for(int i = 0; i < searchLine->pvLength && i < 3 && !IsNullMove(searchLine->pv[i]); i++)
+        {
+            GetMoveNotation(&after, searchLine->pv[i], &notations);
+            MakeSearchMove(&after, searchLine->pv[i]);
+        }
+
+        char *text = analysisLineTexts[line];
+        text[0] = '\0';
+        for(size_t i = 0; i < notations.count; i++)
+        {
+            if(i > 0) strcat(text, " ");
+            strcat(text, notations.items[i]);
+            free(notations.items[i]);
+        }
+    }
+    free(notations.items);
+}
+
+// a move made on the board replaces the rest of the line unless it is the
+// next move of it
+void PlayAnalysisMove(Board *board, Move move)
+{
+    PlayMoveAudio(board, move);
+    CreateAnimation(&_animation, board, move);
+
+    Move *next = (analysisPly < analysisLine.count) ? &analysisLine.items[analysisPly] : NULL;
+    if(next == NULL || next->start != move.start || next->target != move.target || next->flag != move.flag)
+    {
+        analysisLine.count = analysisPly;
+        nob_da_append(&analysisLine, move);
+
+        // the first colour without a move is checkmated, the second one ends the game
+        Board after = *board;
+        MakeSearchMove(&after, move);
+        if(!HasLegalMove(&after) && after.eliminatedColour == NONE) nob_da_append(&analysisLine, nullMove);
+    }
+
+    int ply = analysisPly + 1;
+    if(ply < analysisLine.count && IsNullMove(analysisLine.items[ply])) ply++;
+    SetAnalysisPly(board, ply);
+}
+
+// keys and the results of the engine, called once per frame
+void UpdateAnalysis(Board *board)
+{
+    HandleInput(board);
+
+    // more or fewer lines, the position is analysed again from the table
+    int lines = analysisLineCount + IsKeyPressed(KEY_UP) - IsKeyPressed(KEY_DOWN);
+    if(lines >= 1 && lines <= ANALYSIS_MAX_LINES && lines != analysisLineCount)
+    {
+        analysisLineCount = lines;
+        SetAnalysisLines(analysis, lines);
+        analysisCache[board->hash % ANALYSIS_CACHE_SIZE].key = 0;
+        SetAnalysisPly(board, analysisPly);
+    }
+
+    if(IsKeyPressed(KEY_LEFT) && analysisPly > 0) SetAnalysisPly(board, analysisPly - 1);
+    if(IsKeyPressed(KEY_RIGHT) && analysisPly < analysisLine.count)
+    {
+        Move move = analysisLine.items[analysisPly];
+        if(!IsNullMove(move)) CreateAnimation(&_animation, board, move);
+        SetAnalysisPly(board, analysisPly + 1);
+    }
+
+    // a fen from the clipboard, its lines may be joined with |
+    if(IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_V))
+    {
+        const char *clipboard = GetClipboardText();
+        char FEN[256];
+        if(clipboard != NULL && strlen(clipboard) < sizeof(FEN))
+        {
+            strcpy(FEN, clipboard);
+            for(char *c = FEN; *c != '\0'; c++) if(*c == '|') *c = '\n';
+
+            char copy[256];
+            strcpy(copy, FEN);
+            Board test = {0};
+            if(InitBoard(&test, copy) == 0)
+            {
+                strcpy(analysisFEN, FEN);
+                analysisLine.count = 0;
+                SetAnalysisPly(board, 0);
+            }
+            free(test.mapHistory.items);
+        }
+    }
+
+    AnalysisInfo info;
+    while(PollAnalysis(analysis, &info))
+    {
+        AnalysisInfo *cached = &analysisCache[info.key % ANALYSIS_CACHE_SIZE];
+        if(cached->key == info.key && cached->result.depth > info.result.depth) continue;
+        *cached = info;
+        if(info.key == board->hash) UpdateLineTexts(board);
+    }
+}
+
 Vector2 GetMousePositionScaled()
 {
     Vector2 mousePos = GetMousePosition();
@@ -530,19 +778,9 @@ void HandleInput(Board *board)
             bool IsOwnPiece = assignedColour == board->colourToMove && pieceColour == assignedColour;
             enum Highlight highlightType = (IsOwnPiece) ? NORMALHIGHLIGHT : ENEMYHIGHLIGHT;
 
-            if(IsOwnPiece)
-            {
-                GenerateMoves(board, &moveList);
-            }
-            else
-            {
-                if(pieceColour == board->eliminatedColour) return;
-                int colourToMove = board->colourToMove;
-                board->colourToMove = pieceColour;
-                GenerateMoves(board, &moveList);
-                board->colourToMove = colourToMove;
-            }
-            HighlightSquares(selectedSquare, highlightType, &moveList);
+            MoveList pieceMoves = {0};
+            pieceMoves.count = GetCachedMoves(&moveCache, board, pieceColour, selectedSquare, &pieceMoves.moves);
+            HighlightSquares(selectedSquare, highlightType, &pieceMoves);
         }
         else 
         {
@@ -555,20 +793,13 @@ void HandleInput(Board *board)
             if(assignedColour == board->colourToMove)
             {
                 Move chosenMove = {0};
-                GenerateMoves(board, &moveList);
-
-                for(int i = 0; i < moveList.count; i++)
+                if(!FindCachedMove(&moveCache, board, board->colourToMove, start, target, &chosenMove)) return;
+                if(gameState == ANALYSIS)
                 {
-                    Move move = moveList.moves[i];
-                    if(move.start == start && move.target == target) 
-                    {
-                        chosenMove = move;
-                        break;
-                    }
+                    PlayAnalysisMove(board, chosenMove);
+                    return;
                 }
 
-                if(IsNullMove(chosenMove)) return;
-
                 msg.flag = PLAYMOVE;
                 msg.playMove.move = chosenMove;
                 Write(sock, &msg, sizeof(msg));
@@ -873,6 +1104,97 @@ void DrawMoveList()
     }
 }
 
+// an arrow for every book move, thicker the more often it was played
+void DrawBookMoves(Board *board)
+{
+    int count;
+    const BookEntry *entries = ProbeOpeningBook(book, board, &count);
+
+    uint64_t total = 0;
+    for(int i = 0; i < count; i++) total += entries[i].weight;
+
+    for(int i = 0; i < count; i++)
+    {
+        float share = (float)entries[i].weight / total;
+        Vector2 start  = SquareCenterCoords[AdjustForPerspective(entries[i].start)];
+        Vector2 target = SquareCenterCoords[AdjustForPerspective(entries[i].target)];
+        Color colour = ColorAlpha(RL_BLUE, 0.35f + 0.5f * share);
+
+        DrawLineEx(start, target, 3 + 12 * share, colour);
+        DrawCircleV(target, 6 + 10 * share, colour);
+        DrawText(TextFormat("%.0f%%", 100 * share), target.x + 10, target.y - 10, 20, RL_WHITE);
+    }
+}
+
+static const char *FormatScore(int score)
+{
+    // mate scores count plies, three of them make a move
+    if(score >  MATE_SCORE - MAX_PLY) return TextFormat("#%d",  (MATE_SCORE - score + 2) / 3);
+    if(score < -MATE_SCORE + MAX_PLY) return TextFormat("-#%d", (MATE_SCORE + score + 2) / 3);
+    return TextFormat("%+.2f", score / 100.0f);
+}
+
+// the eval bar next to the move list and the best lines below it, straight
+// from analysisCache so a frame never waits
+void DrawAnalysis(Board *board)
+{
+    DrawText("analysis", 50, 50, 40, RL_WHITE);
+    DrawText("click to move, left and right to step through the moves", 50, 100, 20, RL_LIGHTGRAY);
+    DrawText("up and down for more or fewer lines, ctrl+v to paste a fen, A to leave", 50, 125, 20, RL_LIGHTGRAY);
+
+    AnalysisInfo *info = &analysisCache[board->hash % ANALYSIS_CACHE_SIZE];
+    bool known = info->key == board->hash;
+    SearchResult *result = &info->result;
+
+    // every colour gets a part of the bar by how it stands at the end of
+    // the best line, white at the bottom
+    DrawRectangleRec(EvalBar, CLOCKBACKGROUND);
+    if(known && result->lineCount > 0)
+    {
+        static const Color colours[3] = { RL_RAYWHITE, RL_GRAY, RL_BLACK };
+        float shares[3] = {0};
+        float total = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            if(((i + 1) << 3) == board->eliminatedColour) continue;
+            shares[i] = expf((result->lines[0].scores[i] - result->lines[0].scores[0]) / 400.0f);
+            total += shares[i];
+        }
+
+        float bottom = EvalBar.y + EvalBar.height;
+        for(int i = 0; i < 3; i++)
+        {
+            float height = EvalBar.height * shares[i] / total;
+            DrawRectangle(EvalBar.x, bottom - height, EvalBar.width, height, colours[i]);
+            bottom -= height;
+        }
+    }
+    DrawRectangleLinesEx(EvalBar, 2, BOARDBORDER);
+
+    DrawRectangleRounded(AnalysisWindow, 0.1f, 0, CLOCKBACKGROUND);
+    static const float fontSize = 20.0f;
+    int x = AnalysisWindow.x + 10;
+    int y = AnalysisWindow.y + 10;
+    if(!known || (result->depth == 0 && !info->finished))
+    {
+        DrawText("thinking...", x, y, fontSize, RL_WHITE);
+        return;
+    }
+    if(result->depth == 0)
+    {
+        DrawText("no legal moves", x, y, fontSize, RL_WHITE);
+        return;
+    }
+
+    DrawText(TextFormat("depth %d%s, %.0fk nps", result->depth, info->finished ? "" : "...", result->nps / 1000), x, y, fontSize, RL_LIGHTGRAY);
+    for(int i = 0; i < result->lineCount; i++)
+    {
+        int lineY = y + 35 + 32 * i;
+        DrawText(FormatScore(result->lines[i].score), x, lineY, fontSize, RL_WHITE);
+        DrawText(analysisLineTexts[i], x + 70, lineY, fontSize, RL_WHITE);
+    }
+}
+
 void DrawDrawUI()
 {
     static const char *text = "Draw offered!";
@@ -960,6 +1282,7 @@ int HandleServerMessage(Board *board)
             perspective = (assignedColour >> 3) - 1;
             InitBoard(board, msg.gameStart.FEN);
             InitClock(board, msg.gameStart.timeControl);
+            BuildMoveCache(&moveCache, board);
         }; break;
 
         case MOVEPLAYED: {
@@ -979,6 +1302,7 @@ int HandleServerMessage(Board *board)
             PlayMoveAudio(board, move);
             CreateAnimation(&_animation, board, move);
             MakeMove(board, move);
+            BuildMoveCache(&moveCache, board);
             lastMove = move;
         }; break;
 
@@ -991,6 +1315,8 @@ int HandleServerMessage(Board *board)
                 GetMoveNotation(board, nullMove, &moveNotations);
                 NextMove(board);
             }
+            // eliminating a colour bridges moats and frees pinned pieces
+            BuildMoveCache(&moveCache, board);
         }; break;
 
         case ENDOFGAME: {
@@ -0,0 +1,141 @@
+#include "./common.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// background analysis
+//
+// the position to analyse is handed to a job queue with one worker, which
+// searches it without limits until a newer position comes in. every finished
+// iteration goes into a ring that only the worker writes and only the caller
+// of PollAnalysis reads, so a frame loop can pick up the results without
+// ever waiting on the search. the transposition table is kept from one
+// position to the next, going back and forth through a game finds most of
+// the work already done
+
+#define ANALYSIS_QUEUE_SIZE 64 // a power of 2
+
+struct Analysis {
+    Engine *engine;
+    JobQueue *queue;
+    int threads;
+    atomic_int lines; // best moves to find, each with its own line
+    atomic_uint generation; // bumped for every position, a search of an older one stops
+
+    AnalysisInfo results[ANALYSIS_QUEUE_SIZE];
+    atomic_size_t head; // written by the worker only
+    atomic_size_t tail; // written by the reader only
+};
+
+typedef struct {
+    Analysis *analysis;
+    Board board;
+    unsigned generation;
+} AnalysisRequest;
+
+// a full ring means nobody is reading, the result is dropped
+static void PushResult(Analysis *analysis, AnalysisInfo *info)
+{
+    size_t head = atomic_load_explicit(&analysis->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&analysis->tail, memory_order_acquire);
+    if(head - tail == ANALYSIS_QUEUE_SIZE) return;
+
+    analysis->results[head % ANALYSIS_QUEUE_SIZE] = *info;
+    atomic_store_explicit(&analysis->head, head + 1, memory_order_release);
+}
+
+static bool IsCurrent(AnalysisRequest *request)
+{
+    return request->generation == atomic_load(&request->analysis->generation);
+}
+
+static void ReportAnalysis(SearchResult *result, void *arg)
+{
+    AnalysisRequest *request = arg;
+    // a newer position came in before the search cleared its stop flag
+    if(!IsCurrent(request))
+    {
+        StopSearch(request->analysis->engine);
+        return;
+    }
+
+    AnalysisInfo info = { .key = request->board.hash, .result = *result };
+    PushResult(request->analysis, &info);
+}
+
+static void AnalyseJob(void *arg)
+{
+    AnalysisRequest *request = arg;
+    Analysis *analysis = request->analysis;
+    if(IsCurrent(request))
+    {
+        SearchLimits limits = {
+            .algorithm = SEARCH_PARANOID,
+            .threads   = analysis->threads,
+            .multiPV   = atomic_load(&analysis->lines),
+            .report    = ReportAnalysis,
+            .reportArg = request,
+        };
+        SearchResult result = Search(analysis->engine, &request->board, limits);
+
+        // the search ran out of depth or the position has no moves
+        if(IsCurrent(request))
+        {
+            AnalysisInfo info = { .key = request->board.hash, .result = result, .finished = true };
+            PushResult(analysis, &info);
+        }
+    }
+    free(request);
+}
+
+Analysis *StartAnalysis(size_t hashMegabytes, int threads)
+{
+    Engine *engine = CreateEngine(hashMegabytes);
+    if(engine == NULL) return NULL;
+
+    Analysis *analysis = calloc(1, sizeof(Analysis));
+    analysis->engine  = engine;
+    analysis->threads = (threads > 0) ? threads : 1;
+    analysis->queue   = CreateJobQueue(1);
+    analysis->lines   = 1;
+    return analysis;
+}
+
+// takes effect with the next position, the lines share the search and its table
+void SetAnalysisLines(Analysis *analysis, int lines)
+{
+    atomic_store(&analysis->lines, (lines < 1) ? 1 : (lines > MAX_MULTIPV) ? MAX_MULTIPV : lines);
+}
+
+void StopAnalysis(Analysis *analysis)
+{
+    atomic_fetch_add(&analysis->generation, 1);
+    StopSearch(analysis->engine);
+    DestroyJobQueue(analysis->queue);
+    DestroyEngine(analysis->engine);
+    free(analysis);
+}
+
+// stops whatever is being analysed and starts on the board, which is copied
+void AnalysePosition(Analysis *analysis, Board *board)
+{
+    AnalysisRequest *request = malloc(sizeof(AnalysisRequest));
+    request->analysis   = analysis;
+    request->board      = *board;
+    request->board.mapHistory = (BoardMapHistory) { 0 };
+    request->generation = atomic_fetch_add(&analysis->generation, 1) + 1;
+
+    StopSearch(analysis->engine);
+    SubmitJob(analysis->queue, AnalyseJob, request);
+}
+
+// the oldest result not read yet, false when there is none. never blocks
+bool PollAnalysis(Analysis *analysis, AnalysisInfo *info)
+{
+    size_t tail = atomic_load_explicit(&analysis->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&analysis->head, memory_order_acquire);
+    if(tail == head) return false;
+
+    *info = analysis->results[tail % ANALYSIS_QUEUE_SIZE];
+    atomic_store_explicit(&analysis->tail, tail + 1, memory_order_release);
+    return true;
+}
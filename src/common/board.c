@@ -13,6 +13,16 @@
 
 bool IsBackRankVacated(Board *board, uint8_t section);
 
+static inline void SetSquare(Board *board, int square, uint8_t piece)
+{
+    uint8_t previous = board->map[square];
+    board->hash ^= zobristPieces[square][previous] ^ zobristPieces[square][piece];
+    board->pieceScores[previous >> 3] -= pieceSquareTable[previous][square];
+    board->pieceScores[piece >> 3]    += pieceSquareTable[piece][square];
+    board->changes[board->changeCount++] = (SquareChange) { square, previous, piece };
+    board->map[square] = piece;
+}
+
 int InitBoard(Board *board, char *FEN)
 {
     *board = (Board){ .mapHistory = board->mapHistory };
@@ -38,18 +48,84 @@ int InitBoard(Board *board, char *FEN)
             board->bridgedMoats[(i+1)%3] = true;
         }
     }
+
+    board->hash = HashBoard(board);
+    RefreshPieceScores(board);
+    return 0;
 }
 
-void MakeMove(Board *board, Move move)
+// the board looks the same after turning it by one section and handing every
+// colour's pieces to the next colour, rotation counts sections (0, 1 or 2)
+void RotateBoard(Board *dest, Board *src, int rotation)
+{
+    rotation = mod(rotation, 3);
+    Board rotated = { 0 };
+
+    for(int square = 0; square < 144; square++)
+    {
+        uint8_t piece = src->map[square];
+        if(piece == NONE) continue;
+
+        int target = RotateSquare(square, rotation);
+        uint8_t rotatedPiece = GetPieceType(piece) | RotateColour(GetPieceColour(piece), rotation);
+        rotated.map[target] = rotatedPiece;
+        AddPiece(GetPieceList(&rotated, rotatedPiece), target);
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        int index = (i + rotation) % 3;
+        rotated.castleRights[index] = src->castleRights[i];
+        rotated.bridgedMoats[index] = src->bridgedMoats[i];
+        rotated.clock.seconds[index] = src->clock.seconds[i];
+
+        uint8_t enPassantSquare = src->enPassantSquares[i];
+        rotated.enPassantSquares[index] = (enPassantSquare < 144) ? RotateSquare(enPassantSquare, rotation) : enPassantSquare;
+    }
+
+    rotated.colourToMove     = RotateColour(src->colourToMove, rotation);
+    rotated.eliminatedColour = RotateColour(src->eliminatedColour, rotation);
+    rotated.clock.increment  = src->clock.increment;
+    rotated.fiftyMoveClock   = src->fiftyMoveClock;
+    rotated.moveCount        = src->moveCount;
+    rotated.hash             = HashBoard(&rotated);
+    RefreshPieceScores(&rotated);
+
+    // the history stays with the source, a rotated copy starts without one
+    *dest = rotated;
+}
+
+// rotates the board to the orientation with the smallest hash and returns
+// the rotation used, rotate moves back with RotateMove(move, 3 - rotation)
+int CanonicalizeBoard(Board *dest, Board *src)
+{
+    int rotation = 0;
+    uint64_t smallest = src->hash;
+    for(int i = 1; i < 3; i++)
+    {
+        uint64_t hash = HashRotatedBoard(src, i);
+        if(hash >= smallest) continue;
+        smallest = hash;
+        rotation = i;
+    }
+
+    RotateBoard(dest, src, rotation);
+    return rotation;
+}
+
+static void PlayMove(Board *board, Move move, bool recordHistory)
 {
     uint8_t piece = board->map[move.start];
     uint8_t pieceType = GetPieceType(piece);
     uint8_t capturedPiece = board->map[move.target];
     int colourIndex = (board->colourToMove >> 3) - 1;
+
+    board->hash ^= HashBoardState(board);
     board->enPassantSquares[colourIndex] = -1;
+    board->changeCount = 0;
 
-    board->map[move.start] = NONE;
-    board->map[move.target] = piece;
+    SetSquare(board, move.start, NONE);
+    SetSquare(board, move.target, piece);
 
     PieceList *pieceList = GetPieceList(board, piece);
     MovePiece(pieceList, move.start, move.target);
@@ -67,8 +143,8 @@ void MakeMove(Board *board, Move move)
             if(move.target == 1 || move.target == 9 || move.target == 17)
             {
                 uint8_t rook = board->map[move.target-1];
-                board->map[move.target-1] = NONE;
-                board->map[move.target+1] = rook;
+                SetSquare(board, move.target-1, NONE);
+                SetSquare(board, move.target+1, rook);
                 PieceList *list = GetPieceList(board, rook);
                 MovePiece(list, move.target-1, move.target+1);
             }
@@ -77,18 +153,18 @@ void MakeMove(Board *board, Move move)
             if(move.target == 5 || move.target == 13 || move.target == 21)
             {
                 uint8_t rook = board->map[move.target+2];
-                board->map[move.target+2] = NONE;
-                board->map[move.target-1] = rook;
+                SetSquare(board, move.target+2, NONE);
+                SetSquare(board, move.target-1, rook);
                 PieceList *list = GetPieceList(board, rook);
                 MovePiece(list, move.target+2, move.target-1);
             }
             break;
         case PAWNCROSSCENTER:
-            board->map[move.target] = PAWNCC | board->colourToMove;
+            SetSquare(board, move.target, PAWNCC | board->colourToMove);
             break;
         case PROMOTETOQUEEN: 
         {
-            board->map[move.target] = QUEEN | board->colourToMove;
+            SetSquare(board, move.target, QUEEN | board->colourToMove);
             PieceList *list = GetPieceList(board, QUEEN | board->colourToMove);
             RemovePiece(pieceList, move.target);
             AddPiece(list, move.target);
@@ -96,7 +172,7 @@ void MakeMove(Board *board, Move move)
         }
         case PROMOTETOROOK: 
         {
-            board->map[move.target] = ROOK | board->colourToMove;
+            SetSquare(board, move.target, ROOK | board->colourToMove);
             PieceList *list = GetPieceList(board, ROOK | board->colourToMove);
             RemovePiece(pieceList, move.target);
             AddPiece(list, move.target);
@@ -104,7 +180,7 @@ void MakeMove(Board *board, Move move)
         }
         case PROMOTETOBISHOP: 
         {
-            board->map[move.target] = BISHOP | board->colourToMove;
+            SetSquare(board, move.target, BISHOP | board->colourToMove);
             PieceList *list = GetPieceList(board, BISHOP | board->colourToMove);
             RemovePiece(pieceList, move.target);
             AddPiece(list, move.target);
@@ -112,7 +188,7 @@ void MakeMove(Board *board, Move move)
         }
         case PROMOTETOKNIGHT: 
         {
-            board->map[move.target] = KNIGHT | board->colourToMove;
+            SetSquare(board, move.target, KNIGHT | board->colourToMove);
             PieceList *list = GetPieceList(board, KNIGHT | board->colourToMove);
             RemovePiece(pieceList, move.target);
             AddPiece(list, move.target);
@@ -126,7 +202,7 @@ void MakeMove(Board *board, Move move)
             int capturedPieceSquare = move.target + 24;
             capturedPiece = board->map[capturedPieceSquare];
             PieceList *list = GetPieceList(board, capturedPiece);
-            board->map[capturedPieceSquare] = NONE;
+            SetSquare(board, capturedPieceSquare, NONE);
             RemovePiece(list, capturedPieceSquare);
         }
     }
@@ -152,24 +228,38 @@ void MakeMove(Board *board, Move move)
             board->bridgedMoats[(i+1)%3] = true;
         }
     }
+    board->hash ^= HashBoardState(board);
 
     board->moveCount++;
     if(capturedPiece != NONE || pieceType == PAWN || pieceType == PAWNCC)
     {
         board->fiftyMoveClock = 0;
-        board->mapHistory.count = 0;
+        if(recordHistory) board->mapHistory.count = 0;
     }
     else 
     {
         board->fiftyMoveClock++;
-        mapHistoryAppend(&board->mapHistory, board->map);
+        if(recordHistory) mapHistoryAppend(&board->mapHistory, board->map);
     }
 
     NextMove(board);
 }
 
+void MakeMove(Board *board, Move move)
+{
+    PlayMove(board, move, true);
+}
+
+// same as MakeMove but leaves the map history alone, copies of a board share
+// the history buffer so anything that copies boards around must use this one
+void MakeSearchMove(Board *board, Move move)
+{
+    PlayMove(board, move, false);
+}
+
 void NextMove(Board *board)
 {
+    board->hash ^= zobristColourToMove[board->colourToMove >> 3];
     int nextColour = NextColourToPlay(board);
     board->colourToMove = nextColour;
     if(nextColour == board->eliminatedColour) 
@@ -178,6 +268,7 @@ void NextMove(Board *board)
         board->fiftyMoveClock++;
         board->colourToMove = NextColourToPlay(board);
     }
+    board->hash ^= zobristColourToMove[board->colourToMove >> 3];
 }
 
 int NextColourToPlay(Board *board)
@@ -190,11 +281,13 @@ int NextColourToPlay(Board *board)
 
 void EliminateColour(Board *board, uint8_t colour)
 {
+    board->hash ^= HashBoardState(board) ^ zobristEliminated[board->eliminatedColour >> 3];
     board->eliminatedColour = colour;
     int index = (colour >> 3)-1;
     board->bridgedMoats[index] = true;
     board->bridgedMoats[(index+1)%3] = true;
     board->fiftyMoveClock = 0;
+    board->hash ^= HashBoardState(board) ^ zobristEliminated[board->eliminatedColour >> 3];
 }
 
 bool IsBackRankVacated(Board *board, uint8_t section)
@@ -205,4 +298,84 @@ bool IsBackRankVacated(Board *board, uint8_t section)
         if(board->map[index] != NONE) return false; 
     }
     return true;
-}
\ No newline at end of file
+}
+
+// the rules that end the game in a draw, checked at the start of every turn
+bool IsInsufficientMaterial(Board *board)
+{
+    bool allMoatsBridged = true;
+    for(int i = 0; i < 3; i++)
+    {
+        allMoatsBridged = allMoatsBridged && board->bridgedMoats[i];
+    }
+
+    for(int colour = WHITE; colour <= BLACK; colour += 8)
+    {
+        if(colour == board->eliminatedColour) continue;
+
+        // a pawn can promote to a queen or rook
+        // even when all moats are bridged it is still theoretically possible to checkmate with a king and rook/queen
+        PieceList *pawns = GetPieceList(board, colour | PAWN);
+        PieceList *rooks = GetPieceList(board, colour | ROOK);
+        PieceList *queens = GetPieceList(board, colour | QUEEN);
+        if((queens->count + rooks->count + pawns->count) >= 1) return false;
+
+        PieceList *knights = GetPieceList(board, colour | KNIGHT);
+        PieceList *bishops = GetPieceList(board, colour | BISHOP);
+
+        int darkBishopCount = 0;
+        int lightBishopCount = 0;
+        for(int i = 0; i < bishops->count; i++)
+        {
+            int square = bishops->pieces[i];
+            int rank = square / 24;
+            int file = square % 24;
+
+            bool isWhite = (rank+file)%2;
+            if(isWhite) lightBishopCount++;
+            else darkBishopCount++;
+        }
+
+        // when at least one moat is bridged it can be used as a wall just like the edge in normal chess
+        // this allows you to deliver checkmate with 2 knights, 2 bishops, or 1 knight + 1 bishop
+        if(!allMoatsBridged) 
+        {
+            if(knights->count >= 2) return false;
+            if(knights->count >= 1 && bishops->count >= 1) return false;
+            // if you have no knights you need at least 1 bishop on either colour square
+            if(lightBishopCount >= 1 && darkBishopCount >= 1) return false;
+        }
+        else 
+        {
+            // but when all moats are bridged it becomes more complicated
+            // at least 3 knights are sufficient to deliver checkmate
+            if(knights->count >= 3) return false;
+            // if you have at least 3 bishops you need at least 2 bishops on one colour square and 1 on the other
+            if(bishops->count >= 3 && lightBishopCount >= 1 && darkBishopCount >= 1) return false;
+            // if you have only 1 bishop you need at least 2 other knights
+            if(bishops->count == 1 && knights->count >= 2) return false;
+            // if you have only 1 knight you need at least 1 bishop on either colour square
+            if(knights->count == 1 && lightBishopCount >= 1 && darkBishopCount >= 1) return false;
+        }
+    }
+    return true;
+}
+
+bool IsRepetition(Board *board)
+{
+    int duplicateCount = 0;
+
+    for(size_t i = 0; i < board->mapHistory.count; i++)
+    {
+        bool isEqual = true;
+        for(size_t j = 0; j < NOB_ARRAY_LEN(board->map); j++)
+        {
+            BoardMap *map = &board->mapHistory.items[i];
+            isEqual = isEqual && (board->map[j] == (*map)[j]);
+            if(!isEqual) break;
+        }
+        if(isEqual) duplicateCount++;
+    }
+
+    return duplicateCount >= 3;
+}
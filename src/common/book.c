@@ -0,0 +1,140 @@
+#include "./common.h"
+#include <string.h>
+
+// opening books
+//
+// a book is an array of BookEntry sorted by the hash of the position before
+// the move, so all moves of a position sit next to each other and a lookup
+// is one binary search straight over the mapped file
+//
+// file, little endian:
+//  BookHeader
+//  BookEntry entries[count]
+
+#define BOOK_MAGIC   "3MCBOOK"
+#define BOOK_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+} BookHeader;
+
+struct OpeningBook {
+    void *data;
+    size_t size;
+    const BookEntry *entries;
+    uint64_t count;
+};
+
+OpeningBook *LoadOpeningBook(const char *path)
+{
+    OpeningBook *book = calloc(1, sizeof(OpeningBook));
+    book->data = MapFile(path, &book->size);
+    if(book->data == NULL)
+    {
+        free(book);
+        return NULL;
+    }
+
+    const BookHeader *header = book->data;
+    bool valid = book->size >= sizeof(BookHeader)
+              && memcmp(header->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) == 0
+              && header->version == BOOK_VERSION
+              && book->size >= sizeof(BookHeader) + header->count * sizeof(BookEntry);
+    if(!valid)
+    {
+        UnmapFile(book->data, book->size);
+        free(book);
+        return NULL;
+    }
+
+    book->entries = (const BookEntry *)((const uint8_t *)book->data + sizeof(BookHeader));
+    book->count   = header->count;
+    return book;
+}
+
+void FreeOpeningBook(OpeningBook *book)
+{
+    UnmapFile(book->data, book->size);
+    free(book);
+}
+
+uint64_t OpeningBookSize(OpeningBook *book)
+{
+    return book->count;
+}
+
+// orders by key and then by move, equal entries are merged when building
+int CompareBookEntries(const void *a, const void *b)
+{
+    const BookEntry *x = a;
+    const BookEntry *y = b;
+    if(x->key    != y->key)    return (x->key < y->key) ? -1 : 1;
+    if(x->start  != y->start)  return (int)x->start  - (int)y->start;
+    if(x->target != y->target) return (int)x->target - (int)y->target;
+    return (int)x->flag - (int)y->flag;
+}
+
+bool WriteOpeningBook(const char *path, const BookEntry *entries, uint64_t count)
+{
+    BookHeader header = { 0 };
+    memcpy(header.magic, BOOK_MAGIC, sizeof(BOOK_MAGIC));
+    header.version = BOOK_VERSION;
+    header.count   = count;
+
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(entries, sizeof(BookEntry), count, file) == count;
+    fclose(file);
+    return ok;
+}
+
+// the moves of the position, pointing into the mapped file, NULL when the
+// position isn't in the book
+const BookEntry *ProbeOpeningBook(OpeningBook *book, Board *board, int *count)
+{
+    uint64_t low = 0, high = book->count;
+    while(low < high)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if(book->entries[middle].key < board->hash) low = middle + 1;
+        else high = middle;
+    }
+
+    *count = 0;
+    while(low + *count < book->count && book->entries[low + *count].key == board->hash) (*count)++;
+    return (*count > 0) ? &book->entries[low] : NULL;
+}
+
+// picks a book move with a chance proportional to its weight, moves that
+// aren't legal (a hash collision) are skipped
+bool PickBookMove(OpeningBook *book, Board *board, uint64_t random, Move *move)
+{
+    int count;
+    const BookEntry *entries = ProbeOpeningBook(book, board, &count);
+
+    uint64_t total = 0;
+    for(int i = 0; i < count; i++)
+    {
+        Move bookMove = { .start = entries[i].start, .target = entries[i].target, .flag = entries[i].flag };
+        if(IsLegalMove(board, bookMove)) total += entries[i].weight;
+    }
+    if(total == 0) return false;
+
+    uint64_t pick = random % total;
+    for(int i = 0; i < count; i++)
+    {
+        Move bookMove = { .start = entries[i].start, .target = entries[i].target, .flag = entries[i].flag };
+        if(!IsLegalMove(board, bookMove)) continue;
+        if(pick < entries[i].weight)
+        {
+            *move = bookMove;
+            return true;
+        }
+        pick -= entries[i].weight;
+    }
+    return false;
+}
@@ -41,7 +41,7 @@ typedef struct {
 
 typedef struct {
     double seconds[3];
-    int increment;
+    double increment;
 } Clock;
 
 typedef struct {
@@ -57,6 +57,12 @@ typedef struct {
     size_t capacity;
 } BoardMapHistory;
 
+typedef struct {
+    uint8_t square;
+    uint8_t before;
+    uint8_t after;
+} SquareChange;
+
 typedef struct {
     BoardMap map;
     BoardMapHistory mapHistory;
@@ -69,6 +75,10 @@ typedef struct {
     Clock clock;
     int fiftyMoveClock;
     int moveCount;
+    uint64_t hash;
+    int pieceScores[4]; // material and piece-square values per colour, indexed by colour >> 3
+    SquareChange changes[6]; // every square write of the last move, for incremental evaluators
+    uint8_t changeCount;
 } Board;
 
 typedef struct {
@@ -116,6 +126,7 @@ enum EndFlag {
     INSUFFMAT,
     AGREEMENT,
     REPETITION,
+    TABLEBASE,
 };
 
 static const char *EndFlagString[] = {
@@ -129,6 +140,7 @@ static const char *EndFlagString[] = {
     [INSUFFMAT]   = "insufficient material",
     [AGREEMENT]   = "agreement",
     [REPETITION]  = "repetition",
+    [TABLEBASE]   = "tablebase adjudication",
 };
 
 struct GameStart {
@@ -190,7 +202,275 @@ typedef struct {
     size_t capacity;
 } MoveNotations;
 
+// legal moves of every colour for one position grouped by start square,
+// the moves of square s for colour index c start at offset[c][s]
+typedef struct {
+    MoveList moves[3];
+    uint16_t offset[3][144];
+    uint8_t  count[3][144];
+    uint64_t hash;
+    bool valid;
+} MoveCache;
+
+// yields the legal moves of the colour to move one piece at a time,
+// order holds the piece types in the order they are visited
+typedef struct {
+    Board *board;
+    uint8_t order[6];
+    int orderCount;
+    int stage;
+    int pieceIndex;
+    bool done;
+} MoveIterator;
+
+#define NNUE_HIDDEN   256
+#define NNUE_FEATURES (3 * 8 * 144)
+
+typedef struct NNUE NNUE;
+
+// first layer output of every colour's perspective
+typedef struct {
+    int16_t values[3][NNUE_HIDDEN];
+} Accumulator;
+
+#define TB_MAX_PIECES 4
+
+typedef struct Tablebases Tablebases;
+
+// pieces of a tablebase with the eliminated colour turned to BLACK, sorted
+typedef struct {
+    uint8_t pieces[TB_MAX_PIECES];
+    int count;
+} TBMaterial;
+
+typedef struct {
+    int wdl; // 1 win, 0 draw, -1 loss for the colour to move
+    int dtm; // plies to mate
+} TBResult;
+
+// one move of an opening book, the key is the hash of the position before it
+typedef struct {
+    uint64_t key;
+    uint32_t weight;
+    uint8_t  start;
+    uint8_t  target;
+    uint8_t  flag;
+    uint8_t  reserved;
+} BookEntry;
+
+typedef struct OpeningBook OpeningBook;
+
+#define MATE_SCORE 100000
+#define MAX_PLY    128
+#define MAX_MULTIPV 8
+
+// build with ./nob --stats to count where the nodes of a search go and to be
+// able to trace the top of the tree, see SearchStats. without it none of it is
+// compiled in
+
+enum Bound {
+    BOUND_NONE,
+    BOUND_UPPER,
+    BOUND_LOWER,
+    BOUND_EXACT,
+};
+
+// one table can be shared by any number of engines and threads, see transposition.c
+typedef struct TranspositionTable TranspositionTable;
+
+typedef struct {
+    int score;
+    int depth;
+    int bound;
+    Move move;
+} TTProbe;
+
+// what a table went through since it was made, searches add their counts
+// when they finish
+typedef struct {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t sharedHits;   // positions only another owner had stored, they give just a move
+    uint64_t collisions;   // misses in a bucket full of other positions
+    uint64_t stores;
+    uint64_t replacements; // stores that pushed out another position of the same generation
+    uint64_t evalProbes;
+    uint64_t evalHits;
+    size_t megabytes;
+    double usage;          // part of the slots in use, from a sample
+} TTStats;
+
+// the weights of the hand written evaluation, see eval.c
+enum EvalParameter {
+    EVAL_PAWN,
+    EVAL_KNIGHT,
+    EVAL_BISHOP,
+    EVAL_ROOK,
+    EVAL_QUEEN,
+    EVAL_PAWN_ADVANCE,
+    EVAL_PAWN_PROMOTION,
+    EVAL_PAWN_CENTRALITY,
+    EVAL_KNIGHT_CENTRALITY,
+    EVAL_KNIGHT_CENTRE,
+    EVAL_KNIGHT_BACK_RANK,
+    EVAL_BISHOP_CENTRALITY,
+    EVAL_BISHOP_CENTRE,
+    EVAL_ROOK_AWAY,
+    EVAL_ROOK_CENTRALITY,
+    EVAL_QUEEN_CENTRALITY,
+    EVAL_QUEEN_CENTRE,
+    EVAL_KING_BACK_RANK,
+    EVAL_KING_RANK,
+    EVAL_KING_CENTRALITY,
+    EVAL_KING_AWAY,
+    EVAL_MOBILITY,
+    EVAL_KING_ZONE,
+    EVAL_KING_HOLE,
+    EVAL_OPEN_MOAT,
+    EVAL_PARAMETER_COUNT,
+};
+
+// one of the best root moves of a multi-pv search
+typedef struct {
+    int score;     // like SearchResult.score
+    int scores[3]; // evaluation of every colour where the line ends, indexed by colour >> 3 - 1
+    Move pv[MAX_PLY];
+    int pvLength;
+} SearchLine;
+
+#ifdef SEARCH_STATS
+// counters of one search, every thread keeps its own and Search adds them up
+// once the move is found. the per ply ones leave out quiescence
+typedef struct {
+    uint64_t nodes[MAX_PLY];
+    uint64_t expanded[MAX_PLY];     // nodes that got to generating moves
+    uint64_t children[MAX_PLY];     // moves searched from them, children / expanded is the branching factor
+    uint64_t cutoffs[MAX_PLY];
+    uint64_t firstCutoffs[MAX_PLY]; // cutoffs on the first move searched
+    uint64_t quiescenceNodes;
+    uint64_t tableProbes;
+    uint64_t tableHits;
+    uint64_t tableCutoffs;
+    uint64_t eliminations;   // colours without moves eliminated inside the tree
+    uint64_t twoPlayerNodes; // nodes after an elimination, plain alpha-beta from there on
+    uint64_t movegenTicks;   // cycle counter ticks, see StatsTicks in search.c
+    uint64_t evalTicks;
+    uint64_t searchTicks;
+} SearchStats;
+
+// a trace file is a SearchTraceHeader followed by a SearchTraceNode for every
+// node thread 0 searched in the first plies plies, in the order the nodes were
+// finished. ids count up in the order the nodes were entered, so sorting by id
+// gives the tree depth first. every iteration starts a new root
+#define SEARCH_TRACE_MAGIC   "3MCTRACE"
+#define SEARCH_TRACE_VERSION 1
+#define SEARCH_TRACE_NO_PARENT 0xFFFFFFFF
+
+enum SearchTraceFlag {
+    TRACE_QUIESCENCE  = 1 << 0,
+    TRACE_TABLE_HIT   = 1 << 1, // the table had the position
+    TRACE_TABLE_SCORE = 1 << 2, // and its score was used without searching
+    TRACE_CUTOFF      = 1 << 3,
+    TRACE_NO_MOVES    = 1 << 4,
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t plies;
+} SearchTraceHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t parent;   // SEARCH_TRACE_NO_PARENT for the root
+    uint64_t hash;
+    int32_t alpha;     // the window the node was searched with
+    int32_t beta;
+    int32_t score;     // from the point of view of the root colour
+    int16_t depth;     // minus the quiescence ply in quiescence
+    uint8_t ply;
+    uint8_t colour;    // colour to move
+    Move move;         // the move that led here, a null move at the root
+    uint8_t flags;     // SearchTraceFlag
+    uint8_t reserved[4];
+} SearchTraceNode;
+#endif
+
+typedef struct {
+    Move bestMove;
+    int score; // from the point of view of the colour to move at the root
+    int depth;
+    uint64_t nodes;
+    double time;
+    double nps;
+    Move pv[MAX_PLY];
+    int pvLength;
+    SearchLine lines[MAX_MULTIPV]; // best first, lines[0] is the same as bestMove and pv
+    int lineCount;
+#ifdef SEARCH_STATS
+    SearchStats stats;
+#endif
+} SearchResult;
+
+enum SearchAlgorithm {
+    SEARCH_PARANOID,
+    SEARCH_BEST_REPLY,
+};
+
+typedef struct {
+    int algorithm;    // one of SearchAlgorithm
+    double timeLimit; // seconds, 0 means no limit
+    int maxDepth;     // 0 means no limit
+    uint64_t maxNodes; // 0 means no limit
+    int threads;      // 0 means one per core
+    NNUE *network;    // evaluate with this network instead of Evaluate, NULL for the hand written one
+    void (*report)(SearchResult *result, void *arg); // called after every finished iteration
+    void *reportArg;
+    bool useClock;    // budget the time from the clock of the colour to move, timeLimit then only caps it
+    bool ponder;      // ignore the time limits until PonderHit is called
+    int multiPV;      // lines to find, up to MAX_MULTIPV, 0 means 1
+} SearchLimits;
+
+// seconds a move may take, see AllocateTime
+typedef struct {
+    double optimum; // iterative deepening normally stops after this
+    double maximum; // the search is stopped here no matter what
+} TimeBudget;
+
+typedef struct Engine Engine;
+
+typedef struct {
+    double timeLimit;       // seconds, 0 means no limit
+    uint64_t maxPlayouts;   // 0 means no limit
+    int threads;            // 0 means one per core
+    size_t memoryMegabytes; // tree memory shared by all threads, 0 means 256
+    bool useClock;          // think for the optimum of AllocateTime instead of timeLimit
+} MCTSLimits;
+
+typedef struct {
+    Move bestMove;
+    float rewards[3]; // average reward of every colour after bestMove
+    uint32_t visits;
+    uint64_t playouts;
+    double time;
+    double playoutsPerSecond;
+} MCTSResult;
+
+// one finished iteration of the background analysis, see analysis.c
+typedef struct {
+    uint64_t key; // hash of the analysed position
+    SearchResult result;
+    bool finished; // the search has ended, nothing more comes for this position
+} AnalysisInfo;
+
+typedef struct Analysis Analysis;
+
 typedef struct Socket Socket;
+typedef struct Thread Thread;
+typedef struct ThreadPool ThreadPool;
+typedef struct JobQueue JobQueue;
+typedef struct Process Process;
+typedef struct EngineProcess EngineProcess;
 
 typedef enum {
     #ifdef _WIN32
@@ -211,6 +491,19 @@ typedef struct {
 } PollFd;
 
 extern Move moves[144][8][24];
+extern Move knightMoves[144][8];
+
+extern uint64_t zobristPieces[144][32];
+extern uint64_t zobristColourToMove[4];
+extern uint64_t zobristEliminated[4];
+extern uint64_t zobristCastleRights[3][2];
+extern uint64_t zobristEnPassant[144];
+extern uint64_t zobristBridgedMoats[3];
+
+extern const int materialValues[8];
+extern int evalParameters[EVAL_PARAMETER_COUNT];
+extern const char *evalParameterNames[EVAL_PARAMETER_COUNT];
+extern int pieceSquareTable[32][144];
 
 inline uint8_t GetPieceType(uint8_t piece) { return piece & PIECEMASK; }
 inline uint8_t GetPieceColour(uint8_t piece) { return piece & COLOURMASK; }
@@ -222,8 +515,11 @@ inline bool IsQueenOrBishop(uint8_t piece) { return ((piece & PIECEMASK) & BISHO
 int InitBoard(Board *board, char *FEN);
 int LoadFen(Board *board, char *FEN);
 void MakeMove(Board *board, Move move);
+void MakeSearchMove(Board *board, Move move);
 void NextMove(Board *board);
 void EliminateColour(Board *board, uint8_t colour);
+bool IsRepetition(Board *board);
+bool IsInsufficientMaterial(Board *board);
 
 inline void SetClock(Board *board, uint8_t colour, double time)
 {
@@ -341,10 +637,97 @@ inline int DownRight(int square, int distance)
 }
 
 void AddMove(MoveList *list, Move move);
+void GenerateMoveData();
 void GenerateMoves(Board *board, MoveList *moveList);
+void GenerateMovesBatch(Board **boards, int n, MoveList *out);
+void GenerateMovesBatchParallel(ThreadPool *pool, Board **boards, int n, MoveList *out);
+void GeneratePieceMoves(Board *board, int square, MoveList *moveList);
+void InitMoveIterator(MoveIterator *iterator, Board *board, const uint8_t *order, int orderCount);
+bool NextPieceMoves(MoveIterator *iterator, MoveList *moveList);
+bool HasLegalMove(Board *board);
+bool IsLegalMove(Board *board, Move move);
+
+void BuildMoveCache(MoveCache *cache, Board *board);
+int GetCachedMoves(MoveCache *cache, Board *board, uint8_t colour, int square, Move **moves);
+bool FindCachedMove(MoveCache *cache, Board *board, uint8_t colour, int start, int target, Move *move);
 bool InCheck();
 bool ChecksEnemy(Board *board, Move move);
 
+void CalculateThreatMap(Board *board, uint8_t colour, uint8_t threats[144]);
+int AddThreats(Board *board, uint8_t colour, uint8_t threats[144], uint32_t stamps[144], uint32_t stamp);
+int SEE(Board *board, Move move);
+
+void InitEvaluation();
+void RefreshPieceScores(Board *board);
+void Evaluate(Board *board, int scores[3]);
+void EvaluationFeatures(Board *board, int features[3][EVAL_PARAMETER_COUNT]);
+
+NNUE *LoadNNUE(const char *path);
+void FreeNNUE(NNUE *network);
+bool WriteRandomNNUE(const char *path, uint64_t seed);
+const char *SelectNNUEKernels(bool allowSimd);
+void RefreshAccumulator(NNUE *network, Accumulator *accumulator, Board *board);
+void UpdateAccumulator(NNUE *network, Accumulator *parent, Accumulator *child, Board *board);
+void EvaluateNNUE(NNUE *network, Accumulator *accumulator, Board *board, int scores[3]);
+
+bool GetTablebaseMaterial(Board *board, TBMaterial *material, Board *canonical);
+void TablebaseName(TBMaterial *material, char *name, size_t size);
+bool ParseTablebaseName(const char *name, TBMaterial *material);
+uint64_t TablebaseSize(TBMaterial *material);
+uint64_t TablebaseIndex(TBMaterial *material, Board *board);
+bool TablebaseBoard(TBMaterial *material, uint64_t index, Board *board);
+Tablebases *OpenTablebases(const char *directory);
+void CloseTablebases(Tablebases *tablebases);
+bool PreloadTablebase(Tablebases *tablebases, TBMaterial *material);
+bool DecodeTablebaseEntry(uint8_t entry, TBResult *result);
+bool ProbeTablebases(Tablebases *tablebases, Board *board, TBResult *result);
+int FiftyMoveClockAfter(Board *board, int plies);
+bool WriteTablebase(const char *path, TBMaterial *material, const uint8_t *entries);
+
+OpeningBook *LoadOpeningBook(const char *path);
+void FreeOpeningBook(OpeningBook *book);
+int CompareBookEntries(const void *a, const void *b);
+bool WriteOpeningBook(const char *path, const BookEntry *entries, uint64_t count);
+uint64_t OpeningBookSize(OpeningBook *book);
+const BookEntry *ProbeOpeningBook(OpeningBook *book, Board *board, int *count);
+bool PickBookMove(OpeningBook *book, Board *board, uint64_t random, Move *move);
+
+TranspositionTable *CreateTranspositionTable(size_t megabytes, bool hugePages);
+void DestroyTranspositionTable(TranspositionTable *table);
+void ClearTranspositionTable(TranspositionTable *table);
+void NewTranspositionGeneration(TranspositionTable *table);
+bool ProbeTranspositionTable(TranspositionTable *table, uint64_t key, uint8_t owner, TTProbe *probe);
+void StoreTranspositionTable(TranspositionTable *table, uint64_t key, uint8_t owner, int score, int depth, int bound, Move move);
+bool ProbeEvalCache(TranspositionTable *table, uint64_t key, int scores[3]);
+void StoreEvalCache(TranspositionTable *table, uint64_t key, const int scores[3]);
+void FlushTranspositionStats(TranspositionTable *table);
+void GetTranspositionStats(TranspositionTable *table, TTStats *stats);
+
+Engine *CreateEngine(size_t hashMegabytes);
+Engine *CreateSharingEngine(TranspositionTable *table);
+void DestroyEngine(Engine *engine);
+void ClearEngine(Engine *engine);
+void StopSearch(Engine *engine);
+void PonderHit(Engine *engine);
+TimeBudget AllocateTime(Board *board, uint8_t colour);
+
+SearchResult Search(Engine *engine, Board *board, SearchLimits limits);
+int ParseSearchAlgorithm(const char *name);
+#ifdef SEARCH_STATS
+void MergeSearchStats(SearchStats *into, const SearchStats *from);
+void PrintSearchStats(FILE *file, const SearchStats *stats);
+bool SetSearchTrace(const char *path, int plies);
+#endif
+int ParanoidScore(Board *board, uint8_t rootColour, int scores[3]);
+
+MCTSResult SearchMCTS(Board *board, MCTSLimits limits);
+
+Analysis *StartAnalysis(size_t hashMegabytes, int threads);
+void StopAnalysis(Analysis *analysis);
+void SetAnalysisLines(Analysis *analysis, int lines);
+void AnalysePosition(Analysis *analysis, Board *board);
+bool PollAnalysis(Analysis *analysis, AnalysisInfo *info);
+
 int NextColourToPlay(Board *board);
 inline int GetIndex(int rank, int file, int section) { return rank*24+file+section*8; }
 
@@ -377,6 +760,27 @@ inline bool IsNullMove(Move move)
     return move.start == 0 && move.target == 0;
 }
 
+inline int RotateSquare(int square, int rotation)
+{
+    return Left(square, 8*rotation);
+}
+
+inline uint8_t RotateColour(uint8_t colour, int rotation)
+{
+    if(colour == NONE) return NONE;
+    int index = ((colour >> 3) - 1 + rotation) % 3;
+    return (index + 1) << 3;
+}
+
+inline Move RotateMove(Move move, int rotation)
+{
+    if(IsNullMove(move)) return move;
+    return (Move) { .start = RotateSquare(move.start, rotation), .target = RotateSquare(move.target, rotation), .flag = move.flag };
+}
+
+void RotateBoard(Board *dest, Board *src, int rotation);
+int CanonicalizeBoard(Board *dest, Board *src);
+
 inline char *GetColourString(int colour)
 {
     switch(colour)
@@ -389,6 +793,43 @@ inline char *GetColourString(int colour)
 }
 
 void GetMoveNotation(Board *board, Move move, MoveNotations *notations);
+bool ParseMoveNotation(Board *board, const char *notation, Move *move);
+bool ParseMoveToken(Board *board, const char *token, Move *move);
+
+void FormatProtocolMove(Move move, char *text);
+bool ParseProtocolMove(Board *board, const char *text, Move *move);
+void FormatProtocolFen(const char *FEN, char *text, size_t size);
+bool SetupProtocolPosition(Board *board, char *arguments);
+EngineProcess *StartEngine(const char *command);
+void StopEngine(EngineProcess *engine);
+bool SendToEngine(EngineProcess *engine, const char *format, ...);
+int ReadEngineLine(EngineProcess *engine, char *line, int size, int timeout);
+
+void InitZobrist();
+uint64_t HashBoard(Board *board);
+uint64_t HashBoardState(Board *board);
+uint64_t HashRotatedBoard(Board *board, int rotation);
+uint64_t CanonicalHash(Board *board);
+
+double GetMonotonicTime();
+int GetCoreCount();
+Thread *StartThread(void (*function)(void *arg), void *arg);
+void JoinThread(Thread *thread);
+ThreadPool *CreateThreadPool(int threadCount);
+void DestroyThreadPool(ThreadPool *pool);
+int ThreadPoolSize(ThreadPool *pool);
+void ParallelFor(ThreadPool *pool, int count, void (*job)(void *arg, int index), void *arg);
+JobQueue *CreateJobQueue(int threadCount);
+void DestroyJobQueue(JobQueue *queue);
+void SubmitJob(JobQueue *queue, void (*job)(void *arg), void *arg);
+void *MapFile(const char *path, size_t *size);
+void UnmapFile(void *data, size_t size);
+void *AllocateLargeMemory(size_t size, bool hugePages);
+void FreeLargeMemory(void *memory, size_t size);
+Process *StartProcess(const char *command);
+int WriteProcess(Process *process, const void *src, int count);
+int ReadProcess(Process *process, void *dest, int count, int timeout);
+void StopProcess(Process *process);
 
 int InitSockets();
 void CleanupSockets();
@@ -401,6 +842,10 @@ int Poll(PollFd *Ppolls, int count, int timeout);
 int Read(Socket *sock, void *dest, int count);
 int Write(Socket *sock, void *src, int count);
 bool IsValidConnection(Socket *sock);
+int LocalPort(Socket *sock);
+int PeerPort(Socket *sock);
+uint32_t LocalAddress(Socket *sock);
+uint32_t PeerAddress(Socket *sock);
 int SocketFd(Socket *sock);
 int Shutdown(Socket *sock);
 void Close(Socket *sock);
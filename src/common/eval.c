@@ -0,0 +1,321 @@
+#include "./common.h"
+#include <string.h>
+
+// static evaluation, one score per colour in centipawns
+//
+// material and piece-square values are kept in board->pieceScores and updated
+// by MakeMove every time a square changes, the rest (mobility, king safety,
+// bridged moats) depends on attacks and is added in Evaluate from one walk
+// over the attacks of every piece
+
+const int materialValues[8] = {
+    [NONE]   = 0,
+    [KING]   = 0,
+    [PAWN]   = 100,
+    [PAWNCC] = 100,
+    [KNIGHT] = 300,
+    [BISHOP] = 325,
+    [ROOK]   = 500,
+    [QUEEN]  = 900,
+};
+
+// every term is a weight times a count of something on the board, the
+// counts are what EvaluationFeatures hands to the tuner. materialValues above
+// stays fixed for move ordering and the game phase, the material the
+// evaluation sees is tuned with the rest
+int evalParameters[EVAL_PARAMETER_COUNT] = {
+    [EVAL_PAWN]              = 100,
+    [EVAL_KNIGHT]            = 300,
+    [EVAL_BISHOP]            = 325,
+    [EVAL_ROOK]              = 500,
+    [EVAL_QUEEN]             = 900,
+    [EVAL_PAWN_ADVANCE]      = 8,
+    [EVAL_PAWN_PROMOTION]    = 25,
+    [EVAL_PAWN_CENTRALITY]   = 3,
+    [EVAL_KNIGHT_CENTRALITY] = 6,
+    [EVAL_KNIGHT_CENTRE]     = 8,
+    [EVAL_KNIGHT_BACK_RANK]  = -15,
+    [EVAL_BISHOP_CENTRALITY] = 4,
+    [EVAL_BISHOP_CENTRE]     = 6,
+    [EVAL_ROOK_AWAY]         = 12,
+    [EVAL_ROOK_CENTRALITY]   = 2,
+    [EVAL_QUEEN_CENTRALITY]  = 2,
+    [EVAL_QUEEN_CENTRE]      = 3,
+    [EVAL_KING_BACK_RANK]    = 20,
+    [EVAL_KING_RANK]         = -12,
+    [EVAL_KING_CENTRALITY]   = -4,
+    [EVAL_KING_AWAY]         = -80,
+    [EVAL_MOBILITY]          = 3,
+    [EVAL_KING_ZONE]         = -12,
+    [EVAL_KING_HOLE]         = -10,
+    [EVAL_OPEN_MOAT]         = -15,
+};
+
+const char *evalParameterNames[EVAL_PARAMETER_COUNT] = {
+    [EVAL_PAWN]              = "EVAL_PAWN",
+    [EVAL_KNIGHT]            = "EVAL_KNIGHT",
+    [EVAL_BISHOP]            = "EVAL_BISHOP",
+    [EVAL_ROOK]              = "EVAL_ROOK",
+    [EVAL_QUEEN]             = "EVAL_QUEEN",
+    [EVAL_PAWN_ADVANCE]      = "EVAL_PAWN_ADVANCE",
+    [EVAL_PAWN_PROMOTION]    = "EVAL_PAWN_PROMOTION",
+    [EVAL_PAWN_CENTRALITY]   = "EVAL_PAWN_CENTRALITY",
+    [EVAL_KNIGHT_CENTRALITY] = "EVAL_KNIGHT_CENTRALITY",
+    [EVAL_KNIGHT_CENTRE]     = "EVAL_KNIGHT_CENTRE",
+    [EVAL_KNIGHT_BACK_RANK]  = "EVAL_KNIGHT_BACK_RANK",
+    [EVAL_BISHOP_CENTRALITY] = "EVAL_BISHOP_CENTRALITY",
+    [EVAL_BISHOP_CENTRE]     = "EVAL_BISHOP_CENTRE",
+    [EVAL_ROOK_AWAY]         = "EVAL_ROOK_AWAY",
+    [EVAL_ROOK_CENTRALITY]   = "EVAL_ROOK_CENTRALITY",
+    [EVAL_QUEEN_CENTRALITY]  = "EVAL_QUEEN_CENTRALITY",
+    [EVAL_QUEEN_CENTRE]      = "EVAL_QUEEN_CENTRE",
+    [EVAL_KING_BACK_RANK]    = "EVAL_KING_BACK_RANK",
+    [EVAL_KING_RANK]         = "EVAL_KING_RANK",
+    [EVAL_KING_CENTRALITY]   = "EVAL_KING_CENTRALITY",
+    [EVAL_KING_AWAY]         = "EVAL_KING_AWAY",
+    [EVAL_MOBILITY]          = "EVAL_MOBILITY",
+    [EVAL_KING_ZONE]         = "EVAL_KING_ZONE",
+    [EVAL_KING_HOLE]         = "EVAL_KING_HOLE",
+    [EVAL_OPEN_MOAT]         = "EVAL_OPEN_MOAT",
+};
+
+int pieceSquareTable[32][144];
+bool evaluationGenerated = false;
+
+// how far a square is from the back rank of colour, 0-5 in the colour's own
+// section and 6-11 past the centre, where rank 0 of another section is the
+// promotion rank
+static int Advancement(uint8_t colour, int square)
+{
+    int rank    = square / 24;
+    int section = (square % 24) / 8;
+    if(section == (colour >> 3) - 1) return rank;
+    return 6 + (5 - rank);
+}
+
+// 0 on the edge files of a section, 3 on the two middle files
+static int FileCentrality(int square)
+{
+    int file = square % 8;
+    return (file < 4) ? file : 7 - file;
+}
+
+// adds the counts behind the value of a piece on a square
+static void AddPieceSquareFeatures(uint8_t type, uint8_t colour, int square, int features[EVAL_PARAMETER_COUNT])
+{
+    int advancement = Advancement(colour, square);
+    int centrality  = FileCentrality(square);
+    int rank        = square / 24;
+    bool home       = advancement < 6;
+    // the ranks next to the centre are the middle of the board
+    int centre      = (rank >= 4) ? 2 : (rank >= 2) ? 1 : 0;
+
+    switch(type)
+    {
+        case PAWN:
+        case PAWNCC:
+            features[EVAL_PAWN]++;
+            features[EVAL_PAWN_ADVANCE]    += advancement;
+            features[EVAL_PAWN_PROMOTION]  += (advancement >= 9) ? advancement - 8 : 0;
+            features[EVAL_PAWN_CENTRALITY] += centre ? centrality : 0;
+            break;
+        case KNIGHT:
+            features[EVAL_KNIGHT]++;
+            features[EVAL_KNIGHT_CENTRALITY] += centrality;
+            features[EVAL_KNIGHT_CENTRE]     += centre;
+            features[EVAL_KNIGHT_BACK_RANK]  += rank == 0;
+            break;
+        case BISHOP:
+            features[EVAL_BISHOP]++;
+            features[EVAL_BISHOP_CENTRALITY] += centrality;
+            features[EVAL_BISHOP_CENTRE]     += centre;
+            break;
+        case ROOK:
+            features[EVAL_ROOK]++;
+            features[EVAL_ROOK_AWAY]       += !home;
+            features[EVAL_ROOK_CENTRALITY] += centrality;
+            break;
+        case QUEEN:
+            features[EVAL_QUEEN]++;
+            features[EVAL_QUEEN_CENTRALITY] += centrality;
+            features[EVAL_QUEEN_CENTRE]     += centre;
+            break;
+        case KING:
+            // the king belongs behind its pawns until the board empties out
+            features[EVAL_KING_BACK_RANK]  += home && rank == 0;
+            features[EVAL_KING_RANK]       += home ? rank : 0;
+            features[EVAL_KING_CENTRALITY] += home ? centrality : 0;
+            features[EVAL_KING_AWAY]       += !home;
+            break;
+    }
+}
+
+void InitEvaluation()
+{
+    for(int piece = 0; piece < 32; piece++)
+    {
+        uint8_t type   = GetPieceType(piece);
+        uint8_t colour = GetPieceColour(piece);
+        for(int square = 0; square < 144; square++)
+        {
+            if(colour == NONE || type == NONE)
+            {
+                pieceSquareTable[piece][square] = 0;
+                continue;
+            }
+            int features[EVAL_PARAMETER_COUNT] = { 0 };
+            AddPieceSquareFeatures(type, colour, square, features);
+
+            int value = 0;
+            for(int i = 0; i < EVAL_PARAMETER_COUNT; i++) value += features[i] * evalParameters[i];
+            pieceSquareTable[piece][square] = value;
+        }
+    }
+    evaluationGenerated = true;
+}
+
+// the full rescan, only needed when a board is built from scratch
+void RefreshPieceScores(Board *board)
+{
+    if(!evaluationGenerated) InitEvaluation();
+
+    for(int i = 0; i < 4; i++) board->pieceScores[i] = 0;
+    for(int square = 0; square < 144; square++)
+    {
+        uint8_t piece = board->map[square];
+        board->pieceScores[piece >> 3] += pieceSquareTable[piece][square];
+    }
+}
+
+// attack counts of every colour. they are only cleared around the kings,
+// the one place they are read, and mobility comes from the stamps, so an
+// evaluation never touches all 144 squares
+static _Thread_local uint8_t  threats[3][144];
+static _Thread_local uint32_t threatStamps[3][144];
+static _Thread_local uint32_t threatStamp = 0;
+
+static void CalculateAttacks(Board *board, int mobility[3])
+{
+    if(++threatStamp == 0)
+    {
+        memset(threatStamps, 0, sizeof(threatStamps));
+        threatStamp = 1;
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        PieceList *king = GetPieceList(board, ((i+1) << 3) | KING);
+        if(king->count == 0) continue;
+
+        int kingSquare = king->pieces[0];
+        for(int c = 0; c < 3; c++) threats[c][kingSquare] = 0;
+        for(int dir = 0; dir < 8; dir++)
+        {
+            Move move = moves[kingSquare][dir][0];
+            if(IsNullMove(move)) continue;
+            for(int c = 0; c < 3; c++) threats[c][move.target] = 0;
+        }
+    }
+
+    for(int i = 0; i < 3; i++) mobility[i] = AddThreats(board, (i+1) << 3, threats[i], threatStamps[i], threatStamp);
+}
+
+static void AddKingSafetyFeatures(Board *board, int colourIndex, int features[EVAL_PARAMETER_COUNT])
+{
+    uint8_t colour = (colourIndex+1) << 3;
+    PieceList *king = GetPieceList(board, colour | KING);
+    if(king->count == 0) return;
+
+    int kingSquare = king->pieces[0];
+    int attacks = 0;
+    int exposed = 0;
+    for(int dir = 0; dir < 8; dir++)
+    {
+        Move move = moves[kingSquare][dir][0];
+        if(IsNullMove(move)) continue;
+        for(int i = 1; i <= 2; i++) attacks += threats[(colourIndex+i)%3][move.target];
+        // an empty square next to the king that no own piece covers is a hole
+        if(board->map[move.target] == NONE && threats[colourIndex][move.target] == 0) exposed++;
+    }
+    for(int i = 1; i <= 2; i++) attacks += 2 * threats[(colourIndex+i)%3][kingSquare];
+
+    features[EVAL_KING_ZONE] += attacks;
+    features[EVAL_KING_HOLE] += exposed;
+}
+
+// moat indices follow bridgedMoats: moat s and s+1 border section s
+static void AddMoatFeatures(Board *board, int colourIndex, int features[EVAL_PARAMETER_COUNT])
+{
+    for(int i = 0; i < 2; i++)
+    {
+        int moat = (colourIndex + i) % 3;
+        if(!board->bridgedMoats[moat]) continue;
+
+        // the colour on the other side of the moat can now walk in with its heavy pieces
+        int neighbour = (i == 0) ? (colourIndex+2)%3 : (colourIndex+1)%3;
+        uint8_t neighbourColour = (neighbour+1) << 3;
+        if(neighbourColour == board->eliminatedColour) continue;
+
+        features[EVAL_OPEN_MOAT] += GetPieceList(board, neighbourColour | ROOK)->count + GetPieceList(board, neighbourColour | QUEEN)->count;
+    }
+}
+
+// the counts of the terms that depend on attacks, after CalculateAttacks
+static void AddDynamicFeatures(Board *board, int colourIndex, int mobility[3], int features[EVAL_PARAMETER_COUNT])
+{
+    features[EVAL_MOBILITY] += mobility[colourIndex];
+    AddKingSafetyFeatures(board, colourIndex, features);
+    AddMoatFeatures(board, colourIndex, features);
+}
+
+void Evaluate(Board *board, int scores[3])
+{
+    int mobility[3];
+    CalculateAttacks(board, mobility);
+
+    for(int i = 0; i < 3; i++)
+    {
+        uint8_t colour = (i+1) << 3;
+        if(colour == board->eliminatedColour)
+        {
+            scores[i] = 0;
+            continue;
+        }
+
+        int features[EVAL_PARAMETER_COUNT] = { 0 };
+        AddDynamicFeatures(board, i, mobility, features);
+        scores[i] = board->pieceScores[colour >> 3]
+                  + features[EVAL_MOBILITY]  * evalParameters[EVAL_MOBILITY]
+                  + features[EVAL_KING_ZONE] * evalParameters[EVAL_KING_ZONE]
+                  + features[EVAL_KING_HOLE] * evalParameters[EVAL_KING_HOLE]
+                  + features[EVAL_OPEN_MOAT] * evalParameters[EVAL_OPEN_MOAT];
+    }
+}
+
+// the counts every parameter is multiplied with, scores[i] of Evaluate is
+// the sum of features[i][k] * evalParameters[k]. an eliminated colour has none
+void EvaluationFeatures(Board *board, int features[3][EVAL_PARAMETER_COUNT])
+{
+    int mobility[3];
+    CalculateAttacks(board, mobility);
+
+    memset(features, 0, sizeof(int) * 3 * EVAL_PARAMETER_COUNT);
+    for(int i = 0; i < 3; i++)
+    {
+        uint8_t colour = (i+1) << 3;
+        if(colour == board->eliminatedColour) continue;
+
+        // the pawn list holds the pawns that crossed the centre too
+        for(int type = KING; type <= QUEEN; type++)
+        {
+            if(type == PAWNCC) continue;
+            PieceList *list = GetPieceList(board, colour | type);
+            for(int p = 0; p < list->count; p++)
+            {
+                int square = list->pieces[p];
+                AddPieceSquareFeatures(GetPieceType(board->map[square]), colour, square, features[i]);
+            }
+        }
+        AddDynamicFeatures(board, i, mobility, features[i]);
+    }
+}
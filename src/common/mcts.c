@@ -0,0 +1,307 @@
+#include "./common.h"
+#include <math.h>
+#include <stdatomic.h>
+
+// monte-carlo tree search with max-n rewards: every node keeps a reward per
+// colour and each colour picks the child that is best for itself, there are
+// no coalitions built in like in the paranoid search
+//
+// every thread grows its own tree from a copy of the root (root parallel),
+// the visit counts of the root children are summed up at the end
+
+#define UCT_EXPLORATION 1.0f
+#define PLAYOUT_MAX_PLY 48
+#define TIME_CHECK_INTERVAL 64
+
+typedef struct {
+    Move move;
+    uint8_t mover; // colour that played move
+    bool expanded;
+    uint16_t childCount;
+    uint32_t firstChild;
+    uint32_t visits;
+    float rewards[3];
+} MCTSNode;
+
+typedef struct {
+    Board root;
+    MCTSLimits limits;
+    atomic_bool *stop;
+    double deadline;
+    atomic_uint_fast64_t *playouts;
+
+    MCTSNode *nodes;
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    uint64_t random;
+    uint64_t simulations;
+
+    MoveList moveList;
+} MCTSThread;
+
+static inline uint64_t NextRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static inline int RandomBelow(uint64_t *state, int n)
+{
+    return (int)(((NextRandom(state) >> 32) * (uint64_t)n) >> 32);
+}
+
+// leaves the board at a position where the colour to move has moves, or
+// fills rewards and returns false when the game is over; moveList ends up
+// holding the moves of the colour to move
+static bool ResolvePosition(Board *board, MoveList *moveList, float rewards[3])
+{
+    while(true)
+    {
+        if((board->fiftyMoveClock / 3) >= 50) break;
+
+        GenerateMoves(board, moveList);
+        if(moveList->count > 0) return true;
+
+        if(board->eliminatedColour == NONE)
+        {
+            // the first colour without moves drops out whether it is in check or not
+            EliminateColour(board, board->colourToMove);
+            NextMove(board);
+            continue;
+        }
+
+        if(InCheck())
+        {
+            // checkmate, the one colour that is neither mated nor eliminated wins
+            for(int i = 0; i < 3; i++)
+            {
+                uint8_t colour = (i+1) << 3;
+                rewards[i] = (colour != board->colourToMove && colour != board->eliminatedColour) ? 1.0f : 0.0f;
+            }
+            return false;
+        }
+        break;
+    }
+
+    // a draw is split between the colours still playing
+    for(int i = 0; i < 3; i++) rewards[i] = ((i+1) << 3) == board->eliminatedColour ? 0.0f : 0.5f;
+    return false;
+}
+
+// share of the evaluation of every colour, used when a playout is cut short
+static void EvaluateRewards(Board *board, float rewards[3])
+{
+    int scores[3];
+    Evaluate(board, scores);
+
+    int total = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        if(scores[i] < 0) scores[i] = 0;
+        total += scores[i];
+    }
+    for(int i = 0; i < 3; i++) rewards[i] = (total > 0) ? (float)scores[i] / total : 0.0f;
+}
+
+// random moves, but out of two random candidates a capture wins so the
+// playouts don't just leave pieces hanging
+static Move PlayoutMove(MCTSThread *thread, Board *board, MoveList *moveList)
+{
+    Move first  = moveList->moves[RandomBelow(&thread->random, moveList->count)];
+    Move second = moveList->moves[RandomBelow(&thread->random, moveList->count)];
+    if(board->map[second.target] != NONE && board->map[first.target] == NONE) return second;
+    return first;
+}
+
+static void Playout(MCTSThread *thread, Board *board, float rewards[3])
+{
+    MoveList *moveList = &thread->moveList;
+    for(int ply = 0; ply < PLAYOUT_MAX_PLY; ply++)
+    {
+        if(!ResolvePosition(board, moveList, rewards)) return;
+        MakeSearchMove(board, PlayoutMove(thread, board, moveList));
+    }
+    EvaluateRewards(board, rewards);
+}
+
+static bool ExpandNode(MCTSThread *thread, MCTSNode *node, Board *board, MoveList *moveList)
+{
+    if(thread->nodeCount + moveList->count > thread->nodeCapacity) return false;
+
+    node->firstChild = thread->nodeCount;
+    node->childCount = moveList->count;
+    node->expanded   = true;
+    for(int i = 0; i < moveList->count; i++)
+    {
+        thread->nodes[thread->nodeCount++] = (MCTSNode) {
+            .move  = moveList->moves[i],
+            .mover = board->colourToMove,
+        };
+    }
+    return true;
+}
+
+static MCTSNode *SelectChild(MCTSThread *thread, MCTSNode *node)
+{
+    MCTSNode *children = &thread->nodes[node->firstChild];
+    float logVisits = logf((float)node->visits + 1.0f);
+
+    MCTSNode *best = NULL;
+    float bestValue = -1.0f;
+    for(int i = 0; i < node->childCount; i++)
+    {
+        MCTSNode *child = &children[i];
+        if(child->visits == 0) return child;
+
+        int index = (child->mover >> 3) - 1;
+        float mean  = child->rewards[index] / child->visits;
+        float value = mean + UCT_EXPLORATION * sqrtf(logVisits / child->visits);
+        if(value > bestValue)
+        {
+            bestValue = value;
+            best = child;
+        }
+    }
+    return best;
+}
+
+static void Simulate(MCTSThread *thread)
+{
+    MCTSNode *path[MAX_PLY];
+    int pathLength = 0;
+
+    Board board = thread->root;
+    MCTSNode *node = &thread->nodes[0];
+    path[pathLength++] = node;
+
+    float rewards[3];
+    bool playing = true;
+    while(true)
+    {
+        playing = ResolvePosition(&board, &thread->moveList, rewards);
+        if(!playing) break;
+
+        if(!node->expanded)
+        {
+            // a leaf is only expanded the second time it is reached
+            if(node->visits == 0 && node != &thread->nodes[0]) break;
+            if(!ExpandNode(thread, node, &board, &thread->moveList)) break;
+        }
+
+        node = SelectChild(thread, node);
+        MakeSearchMove(&board, node->move);
+        path[pathLength++] = node;
+        if(pathLength >= MAX_PLY) break;
+    }
+
+    if(playing) Playout(thread, &board, rewards);
+
+    for(int i = 0; i < pathLength; i++)
+    {
+        path[i]->visits++;
+        for(int c = 0; c < 3; c++) path[i]->rewards[c] += rewards[c];
+    }
+}
+
+static void RunThread(void *arg)
+{
+    MCTSThread *thread = arg;
+    thread->nodes[0] = (MCTSNode) { 0 };
+    thread->nodeCount = 1;
+
+    while(!atomic_load_explicit(thread->stop, memory_order_relaxed))
+    {
+        Simulate(thread);
+        thread->simulations++;
+
+        if((thread->simulations % TIME_CHECK_INTERVAL) != 0) continue;
+        uint64_t total = atomic_fetch_add(thread->playouts, TIME_CHECK_INTERVAL) + TIME_CHECK_INTERVAL;
+        if(thread->limits.maxPlayouts != 0 && total >= thread->limits.maxPlayouts) atomic_store(thread->stop, true);
+        if(thread->deadline != 0 && GetMonotonicTime() >= thread->deadline) atomic_store(thread->stop, true);
+    }
+}
+
+MCTSResult SearchMCTS(Board *board, MCTSLimits limits)
+{
+    double start = GetMonotonicTime();
+    int threadCount = (limits.threads > 0) ? limits.threads : GetCoreCount();
+    size_t megabytes = (limits.memoryMegabytes > 0) ? limits.memoryMegabytes : 256;
+    // playouts don't get better the way iterations do, so there is no reason to go past the optimum
+    if(limits.useClock) limits.timeLimit = AllocateTime(board, board->colourToMove).optimum;
+    if(limits.timeLimit <= 0 && limits.maxPlayouts == 0) limits.maxPlayouts = 100000;
+
+    atomic_bool stop = false;
+    atomic_uint_fast64_t playouts = 0;
+
+    MCTSResult result = { 0 };
+    MoveList rootMoves = { 0 };
+    GenerateMoves(board, &rootMoves);
+    if(rootMoves.count == 0)
+    {
+        free(rootMoves.moves);
+        return result;
+    }
+
+    // all node memory is allocated up front, a simulation never touches the heap
+    MCTSThread *threads = calloc(threadCount, sizeof(MCTSThread));
+    Thread **handles = calloc(threadCount, sizeof(Thread *));
+    for(int i = 0; i < threadCount; i++)
+    {
+        MCTSThread *thread = &threads[i];
+        thread->root = *board;
+        thread->root.mapHistory = (BoardMapHistory) { 0 };
+        thread->limits   = limits;
+        thread->stop     = &stop;
+        thread->playouts = &playouts;
+        thread->deadline = (limits.timeLimit > 0) ? start + limits.timeLimit : 0;
+        thread->random   = 0x9E3779B97F4A7C15ULL * (i + 1);
+        thread->nodeCapacity = megabytes * 1024 * 1024 / sizeof(MCTSNode) / threadCount;
+        thread->nodes = malloc(thread->nodeCapacity * sizeof(MCTSNode));
+        thread->moveList = (MoveList) { .moves = malloc(256 * sizeof(Move)), .capacity = 256 };
+    }
+
+    for(int i = 1; i < threadCount; i++) handles[i] = StartThread(RunThread, &threads[i]);
+    RunThread(&threads[0]);
+    for(int i = 1; i < threadCount; i++) if(handles[i] != NULL) JoinThread(handles[i]);
+
+    // every tree expands the root with the same move order, so the children line up
+    uint32_t bestVisits = 0;
+    for(int m = 0; m < rootMoves.count; m++)
+    {
+        uint32_t visits = 0;
+        float rewards[3] = { 0 };
+        for(int i = 0; i < threadCount; i++)
+        {
+            MCTSNode *root = &threads[i].nodes[0];
+            if(!root->expanded) continue;
+            MCTSNode *child = &threads[i].nodes[root->firstChild + m];
+            visits += child->visits;
+            for(int c = 0; c < 3; c++) rewards[c] += child->rewards[c];
+        }
+
+        if(visits > bestVisits || m == 0)
+        {
+            bestVisits = visits;
+            result.bestMove = rootMoves.moves[m];
+            for(int c = 0; c < 3; c++) result.rewards[c] = (visits > 0) ? rewards[c] / visits : 0.0f;
+        }
+    }
+    result.visits = bestVisits;
+
+    for(int i = 0; i < threadCount; i++)
+    {
+        result.playouts += threads[i].simulations;
+        free(threads[i].nodes);
+        free(threads[i].moveList.moves);
+    }
+    free(threads);
+    free(handles);
+    free(rootMoves.moves);
+
+    result.time = GetMonotonicTime() - start;
+    result.playoutsPerSecond = (result.time > 0) ? result.playouts / result.time : 0;
+    return result;
+}
@@ -0,0 +1,59 @@
+#include "./common.h"
+
+// fills the cache with the legal moves of every colour still in the game,
+// the moves of one piece end up next to each other so a lookup is a slice
+void BuildMoveCache(MoveCache *cache, Board *board)
+{
+    static _Thread_local MoveList pieceMoves = { 0 };
+    cache->hash = board->hash;
+
+    for(int colourIndex = 0; colourIndex < 3; colourIndex++)
+    {
+        uint8_t colour = (colourIndex+1) << 3;
+        MoveList *list = &cache->moves[colourIndex];
+        list->count = 0;
+        for(int square = 0; square < 144; square++) cache->count[colourIndex][square] = 0;
+
+        if(colour == board->eliminatedColour) continue;
+
+        // moves of the colours that aren't to move are what they could play
+        // if it were their turn, the client shows these when clicking an enemy piece
+        Board _board = *board;
+        _board.colourToMove = colour;
+
+        MoveIterator iterator;
+        InitMoveIterator(&iterator, &_board, NULL, 0);
+        while(NextPieceMoves(&iterator, &pieceMoves))
+        {
+            int start = pieceMoves.moves[0].start;
+            cache->offset[colourIndex][start] = list->count;
+            cache->count[colourIndex][start]  = pieceMoves.count;
+            for(int i = 0; i < pieceMoves.count; i++) AddMove(list, pieceMoves.moves[i]);
+        }
+    }
+
+    cache->valid = true;
+}
+
+// returns the number of cached moves of the piece on square and points moves at them,
+// nothing when the cache was built for another position
+int GetCachedMoves(MoveCache *cache, Board *board, uint8_t colour, int square, Move **moves)
+{
+    if(!cache->valid || cache->hash != board->hash || colour == NONE) return 0;
+    int colourIndex = (colour >> 3) - 1;
+    *moves = &cache->moves[colourIndex].moves[cache->offset[colourIndex][square]];
+    return cache->count[colourIndex][square];
+}
+
+bool FindCachedMove(MoveCache *cache, Board *board, uint8_t colour, int start, int target, Move *move)
+{
+    Move *moves;
+    int count = GetCachedMoves(cache, board, colour, start, &moves);
+    for(int i = 0; i < count; i++)
+    {
+        if(moves[i].target != target) continue;
+        *move = moves[i];
+        return true;
+    }
+    return false;
+}
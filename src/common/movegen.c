@@ -1,4 +1,5 @@
 #include "./common.h"
+#include "../../nob.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -19,6 +20,10 @@ void GenerateKingMoves(Board *board, MoveList *moveList);
 void GenerateSlidingMoves(Board *board, MoveList *moveList);
 void GeneratePawnMoves(Board *board, MoveList *moveList);
 void GenerateKnightMoves(Board *board, MoveList *moveList);
+void GeneratePawnMovesFrom(Board *board, int square, MoveList *moveList);
+void GenerateKnightMovesFrom(Board *board, int square, MoveList *moveList);
+void GenerateRookMovesFrom(Board *board, int square, MoveList *moveList);
+void GenerateBishopMovesFrom(Board *board, int square, MoveList *moveList);
 void CalculateAttackData(Board *board);
 bool CrossesMoat(Move move, int dir, int distance);
 bool KnightCrossesMoat(Move move);
@@ -35,16 +40,30 @@ bool dataGenerated = false;
 Move moves[144][8][24] = {0};
 Move knightMoves[144][8] = {0};
 int  squareDirections[144][144] = {0};
+// a bit per direction in which a ray from the first square reaches the second
+static uint8_t rayDirections[144][144] = {0};
+// how many squares a slider can capture on along a ray before it ends or crosses a moat
+static uint8_t captureRayLength[144][8] = {0};
+// which pieces on the first square could capture on the second, see CAPTURE_*
+static uint8_t captureReach[144][144] = {0};
 
-static int friendIndex;
-static int friendKingSquare;
-static bool attackMap[144];
-static bool checkBlockMap[144];
-static bool checkingPiecesMap[144];
-static int checkingPieces;
-static int checks;
-static bool pinMap[144];
-static int pinDirection[144];
+enum {
+    CAPTURE_KNIGHT = 1,
+    CAPTURE_PAWN   = 2, // a pawn that has not crossed the centre
+    CAPTURE_PAWNCC = 4,
+};
+
+// the state of the last GenerateMoves call, kept per thread so several
+// threads can generate moves at the same time
+static _Thread_local int friendIndex;
+static _Thread_local int friendKingSquare;
+static _Thread_local bool attackMap[144];
+static _Thread_local bool checkBlockMap[144];
+static _Thread_local bool checkingPiecesMap[144];
+static _Thread_local int checkingPieces;
+static _Thread_local int checks;
+static _Thread_local bool pinMap[144];
+static _Thread_local int pinDirection[144];
 
 void AddMove(MoveList *list, Move move)
 {
@@ -69,6 +88,7 @@ void GenerateMoveData()
             if(target == -1) break;
             moves[i][NO][j] = (Move) { .start = i, .target = target, .flag = 0 };
             squareDirections[i][target] = NO;
+            rayDirections[i][target] |= 1 << NO;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -76,6 +96,7 @@ void GenerateMoveData()
             if(target == -1) break;
             moves[i][SO][j] = (Move) { .start = i, .target = target, .flag = 0 };
             squareDirections[i][target] = SO;
+            rayDirections[i][target] |= 1 << SO;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -83,6 +104,7 @@ void GenerateMoveData()
             if(target == i) break;
             moves[i][WE][j] = (Move) { .start = i, .target = target, .flag = 0 };
             squareDirections[i][target] = WE;
+            rayDirections[i][target] |= 1 << WE;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -90,6 +112,7 @@ void GenerateMoveData()
             if(target == i) break;
             moves[i][EA][j] = (Move) { .start = i, .target = target, .flag = 0};
             squareDirections[i][target] = EA;
+            rayDirections[i][target] |= 1 << EA;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -97,6 +120,7 @@ void GenerateMoveData()
             if(target == -1 || target == i) break;
             moves[i][NW][j] = (Move) { .start = i, .target = target, .flag = 0};
             squareDirections[i][target] = NW;
+            rayDirections[i][target] |= 1 << NW;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -104,6 +128,7 @@ void GenerateMoveData()
             if(target == -1 || target == i) break;
             moves[i][NE][j] = (Move) { .start = i, .target = target, .flag = 0};
             squareDirections[i][target] = NE;
+            rayDirections[i][target] |= 1 << NE;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -111,6 +136,7 @@ void GenerateMoveData()
             if(target == -1 || target == i) break;
             moves[i][SE][j] = (Move) { .start = i, .target = target, .flag = 0};
             squareDirections[i][target] = SE;
+            rayDirections[i][target] |= 1 << SE;
         }
         for(int j = 0; j < 24; j++)
         {
@@ -118,6 +144,7 @@ void GenerateMoveData()
             if(target == -1 || target == i) break;
             moves[i][SW][j] = (Move) { .start = i, .target = target, .flag = 0};
             squareDirections[i][target] = SW;
+            rayDirections[i][target] |= 1 << SW;
         }
 
         knightMoves[i][0] = (Move) { .start = i, .target = Right(Up(i, 2), 1), .flag = 0 };
@@ -128,15 +155,35 @@ void GenerateMoveData()
         if(rank != 0) knightMoves[i][5] = (Move) { .start = i, .target = Left (Down(i, 1), 2), .flag = 0 };
         if(rank  > 1) knightMoves[i][6] = (Move) { .start = i, .target = Right(Down(i, 2), 1), .flag = 0 };
         if(rank  > 1) knightMoves[i][7] = (Move) { .start = i, .target = Left (Down(i, 2), 1), .flag = 0 };
+
+        for(int dir = 0; dir < 8; dir++)
+        {
+            int length = 0;
+            while(length < 24 && !IsNullMove(moves[i][dir][length]) && !CrossesMoat(moves[i][dir][length], dir, length)) length++;
+            captureRayLength[i][dir] = length;
+        }
+        for(int j = 0; j < 8; j++)
+        {
+            Move move = knightMoves[i][j];
+            if(!IsNullMove(move) && !KnightCrossesMoat(move)) captureReach[i][move.target] |= CAPTURE_KNIGHT;
+        }
+        for(int dir = NW; dir <= SW; dir++)
+        {
+            Move move = moves[i][dir][0];
+            if(IsNullMove(move) || CrossesMoat(move, dir, 0)) continue;
+            if(dir >= SE) captureReach[i][move.target] |= CAPTURE_PAWNCC;
+            else if(!CrossesCreek(move)) captureReach[i][move.target] |= CAPTURE_PAWN;
+        }
     }
     dataGenerated = true;
 }
 
 bool InCheck() { return checks > 0; }
 
-void GenerateMoves(Board *board, MoveList *moveList)
+// computes the attack, check and pin data every generator below relies on,
+// returns false when the colour to move has no king and therefore no moves
+static bool PrepareMoveGeneration(Board *board)
 {
-    moveList->count = 0;
     if(!dataGenerated) GenerateMoveData();
     for(int i = 0; i < 144; i++) 
     {
@@ -145,16 +192,24 @@ void GenerateMoves(Board *board, MoveList *moveList)
         checkingPiecesMap[i] = false;
         pinMap[i] = false;
     }
+    checkingPieces = 0;
+    checks = 0;
 
     PieceList *king = GetPieceList(board, board->colourToMove | KING);
-    if(king->count == 0) return;
+    if(king->count == 0) return false;
 
     friendIndex = (board->colourToMove >> 3) - 1;
     friendKingSquare = king->pieces[0];
-    checkingPieces = 0;
-    checks = 0;
 
     CalculateAttackData(board);
+    return true;
+}
+
+void GenerateMoves(Board *board, MoveList *moveList)
+{
+    moveList->count = 0;
+    if(!PrepareMoveGeneration(board)) return;
+
     GenerateKingMoves(board, moveList);
     if(checkingPieces > 1) return;
 
@@ -163,6 +218,458 @@ void GenerateMoves(Board *board, MoveList *moveList)
     GenerateSlidingMoves(board, moveList);
 }
 
+// generates the moves of the piece on the given square, PrepareMoveGeneration
+// must have been called for the board and the piece must be the colour to move
+static void GenerateMovesFromSquare(Board *board, int square, MoveList *moveList)
+{
+    uint8_t pieceType = GetPieceType(board->map[square]);
+    if(pieceType == KING)
+    {
+        GenerateKingMoves(board, moveList);
+        return;
+    }
+    if(checkingPieces > 1) return;
+
+    switch(pieceType)
+    {
+        case PAWN:
+        case PAWNCC: GeneratePawnMovesFrom(board, square, moveList);   break;
+        case KNIGHT: GenerateKnightMovesFrom(board, square, moveList); break;
+        case ROOK:   GenerateRookMovesFrom(board, square, moveList);   break;
+        case BISHOP: GenerateBishopMovesFrom(board, square, moveList); break;
+        case QUEEN:
+            GenerateRookMovesFrom(board, square, moveList);
+            GenerateBishopMovesFrom(board, square, moveList);
+            break;
+    }
+}
+
+static const uint8_t defaultIteratorOrder[] = { KING, PAWN, KNIGHT, ROOK, BISHOP, QUEEN };
+
+// the iterator shares the per thread state of GenerateMoves, calling any other
+// move generation function on the same thread invalidates it
+void InitMoveIterator(MoveIterator *iterator, Board *board, const uint8_t *order, int orderCount)
+{
+    if(order == NULL)
+    {
+        order = defaultIteratorOrder;
+        orderCount = NOB_ARRAY_LEN(defaultIteratorOrder);
+    }
+
+    *iterator = (MoveIterator) { .board = board, .orderCount = orderCount };
+    for(int i = 0; i < orderCount && i < 6; i++) iterator->order[i] = order[i];
+
+    iterator->done = !PrepareMoveGeneration(board);
+    // in double check only the king can move
+    if(checkingPieces > 1)
+    {
+        iterator->order[0]   = KING;
+        iterator->orderCount = 1;
+    }
+}
+
+// fills the list with the moves of the next piece that can move,
+// returns false once every piece in the order has been visited
+bool NextPieceMoves(MoveIterator *iterator, MoveList *moveList)
+{
+    Board *board = iterator->board;
+    moveList->count = 0;
+
+    while(!iterator->done && iterator->stage < iterator->orderCount)
+    {
+        PieceList *list = GetPieceList(board, board->colourToMove | iterator->order[iterator->stage]);
+        if(iterator->pieceIndex >= list->count)
+        {
+            iterator->stage++;
+            iterator->pieceIndex = 0;
+            continue;
+        }
+
+        int square = list->pieces[iterator->pieceIndex++];
+        GenerateMovesFromSquare(board, square, moveList);
+        if(moveList->count > 0) return true;
+    }
+
+    iterator->done = true;
+    return false;
+}
+
+void GeneratePieceMoves(Board *board, int square, MoveList *moveList)
+{
+    moveList->count = 0;
+    if(!IsColour(board->map[square], board->colourToMove)) return;
+    if(!PrepareMoveGeneration(board)) return;
+    GenerateMovesFromSquare(board, square, moveList);
+}
+
+bool HasLegalMove(Board *board)
+{
+    static _Thread_local MoveList list = { 0 };
+    MoveIterator iterator;
+    InitMoveIterator(&iterator, board, NULL, 0);
+    return NextPieceMoves(&iterator, &list);
+}
+
+bool IsLegalMove(Board *board, Move move)
+{
+    static _Thread_local MoveList list = { 0 };
+    GeneratePieceMoves(board, move.start, &list);
+
+    for(int i = 0; i < list.count; i++)
+    {
+        Move legalMove = list.moves[i];
+        if(legalMove.start  != move.start)  continue;
+        if(legalMove.target != move.target) continue;
+        if(legalMove.flag   != move.flag)   continue;
+        return true;
+    }
+    return false;
+}
+
+// counts for every square how many pieces of colour attack it, pins and checks
+// are ignored and sliders stop at the first piece, like in CalculateAttackData
+// counts one more attack on target. with stamps, a square colour reaches for
+// the first time gets stamp and adds to reached when none of its pieces is there
+static inline void MarkThreat(Board *board, uint8_t colour, int target, uint8_t threats[144], uint32_t *stamps, uint32_t stamp, int *reached)
+{
+    threats[target]++;
+    if(stamps == NULL || stamps[target] == stamp) return;
+    stamps[target] = stamp;
+    if(!IsColour(board->map[target], colour)) (*reached)++;
+}
+
+// the attacks of every piece of colour, stamps is NULL for a plain threat map
+static inline int WalkThreats(Board *board, uint8_t colour, uint8_t threats[144], uint32_t *stamps, uint32_t stamp)
+{
+    int reached = 0;
+    for(int type = KING; type <= QUEEN; type++)
+    {
+        if(type == PAWNCC) continue;
+        PieceList *list = GetPieceList(board, colour | type);
+        for(int pieceIndex = 0; pieceIndex < list->count; pieceIndex++)
+        {
+            int square = list->pieces[pieceIndex];
+            if(type == KNIGHT)
+            {
+                for(int i = 0; i < 8; i++)
+                {
+                    Move move = knightMoves[square][i];
+                    if(IsNullMove(move) || !(captureReach[square][move.target] & CAPTURE_KNIGHT)) continue;
+                    MarkThreat(board, colour, move.target, threats, stamps, stamp, &reached);
+                }
+                continue;
+            }
+
+            if(type == PAWN)
+            {
+                bool crossedCenter = IsType(board->map[square], PAWNCC);
+                int startDir = (crossedCenter) ? SE : NW;
+                int endDir   = (crossedCenter) ? SW : NE;
+                for(int dir = startDir; dir <= endDir; dir++)
+                {
+                    if(captureRayLength[square][dir] == 0) continue;
+                    Move move = moves[square][dir][0];
+                    if(!crossedCenter && CrossesCreek(move)) continue;
+                    MarkThreat(board, colour, move.target, threats, stamps, stamp, &reached);
+                }
+                continue;
+            }
+
+            int startDir = (type == BISHOP) ? 4 : 0;
+            int endDir   = (type == ROOK)   ? 4 : 8;
+            for(int dir = startDir; dir < endDir; dir++)
+            {
+                // the rays stop at the moats, see GenerateMoveData
+                int length = captureRayLength[square][dir];
+                if(type == KING && length > 1) length = 1;
+                for(int i = 0; i < length; i++)
+                {
+                    int target = moves[square][dir][i].target;
+                    MarkThreat(board, colour, target, threats, stamps, stamp, &reached);
+                    if(board->map[target] != NONE) break;
+                }
+            }
+        }
+    }
+    return reached;
+}
+
+void CalculateThreatMap(Board *board, uint8_t colour, uint8_t threats[144])
+{
+    for(int square = 0; square < 144; square++) threats[square] = 0;
+    if(colour == board->eliminatedColour) return;
+    WalkThreats(board, colour, threats, NULL, 0);
+}
+
+// adds the attacks of colour to threats without clearing it first and
+// returns how many squares without a piece of colour it reaches that didn't
+// have stamp yet. a caller that only reads some squares clears just those
+// and uses a new stamp every time
+int AddThreats(Board *board, uint8_t colour, uint8_t threats[144], uint32_t stamps[144], uint32_t stamp)
+{
+    if(colour == board->eliminatedColour) return 0;
+    return WalkThreats(board, colour, threats, stamps, stamp);
+}
+
+// the largest exchange SEE follows, pieces beyond that are left out
+#define SEE_MAX_ATTACKERS 32
+#define SEE_MAX_BLOCKERS  4
+#define SEE_MAX_DEPTH     32
+#define SEE_MAX_NODES     512
+
+typedef struct {
+    uint8_t square;
+    uint8_t colour; // colour index
+    uint8_t type;
+    uint8_t blockerCount;
+    uint8_t blockers[SEE_MAX_BLOCKERS]; // squares that have to empty before a slider can join
+    bool used;
+} SeeAttacker;
+
+typedef struct {
+    SeeAttacker attackers[SEE_MAX_ATTACKERS];
+    int count;
+    int target;
+    int eliminated; // colour index or -1
+    bool promotes;
+    int nodes;
+} SeeExchange;
+
+static void AddSeeAttacker(SeeExchange *exchange, int square, uint8_t piece)
+{
+    if(exchange->count == SEE_MAX_ATTACKERS) return;
+    exchange->attackers[exchange->count++] = (SeeAttacker) {
+        .square = square,
+        .colour = (GetPieceColour(piece) >> 3) - 1,
+        .type   = (GetPieceType(piece) == PAWNCC) ? PAWN : GetPieceType(piece),
+    };
+}
+
+// the pieces that could capture on target if nothing moved, sliders also when
+// only other attackers stand in the way. captures never cross a moat, bridged
+// or not, and a pawn only captures across a creek once it crossed the centre
+static void CollectSeeAttackers(SeeExchange *exchange, Board *board, int start)
+{
+    int target = exchange->target;
+    for(int colourIndex = 0; colourIndex < 3; colourIndex++)
+    {
+        uint8_t colour = (colourIndex+1) << 3;
+        if(colour == board->eliminatedColour) continue;
+
+        for(int type = KING; type <= QUEEN; type++)
+        {
+            if(type == PAWNCC) continue;
+            PieceList *list = GetPieceList(board, colour | type);
+            for(int pieceIndex = 0; pieceIndex < list->count; pieceIndex++)
+            {
+                int square = list->pieces[pieceIndex];
+                uint8_t piece = board->map[square];
+                if(type == KNIGHT || type == PAWN)
+                {
+                    uint8_t reach = (type == KNIGHT) ? CAPTURE_KNIGHT : IsType(piece, PAWNCC) ? CAPTURE_PAWNCC : CAPTURE_PAWN;
+                    if(captureReach[square][target] & reach) AddSeeAttacker(exchange, square, piece);
+                    continue;
+                }
+
+                uint8_t directions = rayDirections[square][target];
+                if(type == ROOK)   directions &= 0x0f;
+                if(type == BISHOP) directions &= 0xf0;
+                for(int dir = 0; dir < 8 && directions != 0; dir++)
+                {
+                    if(!(directions & (1 << dir))) continue;
+
+                    // the ray can pass the centre, the move data already bends it into the next section
+                    SeeAttacker attacker = { .square = square, .colour = colourIndex, .type = type };
+                    bool reaches = false;
+                    int length = captureRayLength[square][dir];
+                    if(type == KING && length > 1) length = 1;
+                    for(int i = 0; i < length; i++)
+                    {
+                        Move move = moves[square][dir][i];
+                        if(move.target == target)
+                        {
+                            reaches = true;
+                            break;
+                        }
+                        if(board->map[move.target] == NONE || move.target == start) continue;
+                        if(attacker.blockerCount == SEE_MAX_BLOCKERS) break;
+                        attacker.blockers[attacker.blockerCount++] = move.target;
+                    }
+                    if(!reaches || exchange->count == SEE_MAX_ATTACKERS) continue;
+                    exchange->attackers[exchange->count++] = attacker;
+                    break;
+                }
+            }
+        }
+    }
+
+    // a slider behind something that never captures on target stays blocked,
+    // dropping one can strand the sliders behind it so repeat until nothing changes
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(int i = 0; i < exchange->count; i++)
+        {
+            SeeAttacker *attacker = &exchange->attackers[i];
+            for(int j = 0; j < attacker->blockerCount; j++)
+            {
+                bool attacks = false;
+                for(int k = 0; k < exchange->count && !attacks; k++) attacks = exchange->attackers[k].square == attacker->blockers[j];
+                if(attacks) continue;
+
+                exchange->attackers[i] = exchange->attackers[--exchange->count];
+                changed = true;
+                i--;
+                break;
+            }
+        }
+    }
+}
+
+static bool SeeAttackerReady(SeeExchange *exchange, SeeAttacker *attacker)
+{
+    if(attacker->used) return false;
+    for(int i = 0; i < attacker->blockerCount; i++)
+    {
+        for(int k = 0; k < exchange->count; k++)
+        {
+            if(exchange->attackers[k].square == attacker->blockers[i] && !exchange->attackers[k].used) return false;
+        }
+    }
+    return true;
+}
+
+// the cheapest piece colour can capture with, the king only when no other
+// colour could take it back
+static int LeastValuableAttacker(SeeExchange *exchange, int colour)
+{
+    int best = -1;
+    for(int i = 0; i < exchange->count; i++)
+    {
+        SeeAttacker *attacker = &exchange->attackers[i];
+        if(attacker->colour != colour || !SeeAttackerReady(exchange, attacker)) continue;
+        if(best == -1 || exchange->attackers[best].type == KING || (attacker->type != KING && materialValues[attacker->type] < materialValues[exchange->attackers[best].type])) best = i;
+    }
+    if(best == -1 || exchange->attackers[best].type != KING) return best;
+
+    for(int i = 0; i < exchange->count; i++)
+    {
+        SeeAttacker *attacker = &exchange->attackers[i];
+        if(attacker->colour != colour && SeeAttackerReady(exchange, attacker)) return -1;
+    }
+    return best;
+}
+
+// gains gets the material every colour wins from here on when each colour in
+// turn either captures with its cheapest piece or lets the others go on,
+// whichever leaves it with more
+static void ResolveExchange(SeeExchange *exchange, int value, int owner, int colour, int passes, int depth, int gains[3])
+{
+    for(int i = 0; i < 3; i++) gains[i] = 0;
+    if(passes == 3 || depth == SEE_MAX_DEPTH || exchange->nodes++ == SEE_MAX_NODES) return;
+
+    int next = (colour + 1) % 3;
+    ResolveExchange(exchange, value, owner, next, passes + 1, depth + 1, gains);
+    if(colour == owner || colour == exchange->eliminated) return;
+
+    int index = LeastValuableAttacker(exchange, colour);
+    if(index == -1) return;
+
+    SeeAttacker *attacker = &exchange->attackers[index];
+    bool promotes = exchange->promotes && attacker->type == PAWN;
+    int capturerValue = materialValues[promotes ? QUEEN : attacker->type];
+
+    int captured[3];
+    attacker->used = true;
+    ResolveExchange(exchange, capturerValue, colour, next, 0, depth + 1, captured);
+    attacker->used = false;
+
+    captured[colour] += value + (promotes ? materialValues[QUEEN] - materialValues[PAWN] : 0);
+    captured[owner]  -= value;
+    if(captured[colour] > gains[colour]) for(int i = 0; i < 3; i++) gains[i] = captured[i];
+}
+
+// the material the colour making move wins or loses on its target square once
+// the other two colours, in turn order, are done capturing there. pins and
+// checks are ignored, pieces of the third colour can join on either side
+int SEE(Board *board, Move move)
+{
+    uint8_t piece = board->map[move.start];
+    if(piece == NONE || move.flag == CASTLE) return 0;
+
+    SeeExchange exchange = {
+        .target     = move.target,
+        .eliminated = (board->eliminatedColour == NONE) ? -1 : (board->eliminatedColour >> 3) - 1,
+        .promotes   = move.target / 24 == 0,
+    };
+
+    int colour = (GetPieceColour(piece) >> 3) - 1;
+    uint8_t captured = board->map[move.target];
+    int value = (move.flag == ENPASSANT) ? materialValues[PAWN] : materialValues[GetPieceType(captured)];
+
+    int moverValue = materialValues[GetPieceType(piece)];
+    int gain = value;
+    switch(move.flag)
+    {
+        case PROMOTETOQUEEN:  moverValue = materialValues[QUEEN];  break;
+        case PROMOTETOROOK:   moverValue = materialValues[ROOK];   break;
+        case PROMOTETOBISHOP: moverValue = materialValues[BISHOP]; break;
+        case PROMOTETOKNIGHT: moverValue = materialValues[KNIGHT]; break;
+    }
+    gain += moverValue - materialValues[GetPieceType(piece)];
+
+    // the moving piece leaves start, which opens the rays of whatever stood behind it
+    CollectSeeAttackers(&exchange, board, move.start);
+    for(int i = 0; i < exchange.count; i++) if(exchange.attackers[i].square == move.start) exchange.attackers[i].used = true;
+
+    int gains[3];
+    ResolveExchange(&exchange, moverValue, colour, (colour + 1) % 3, 0, 0, gains);
+    return gain + gains[colour];
+}
+
+// positions are handed out in contiguous chunks so every thread writes to its
+// own stretch of the output array instead of sharing cache lines with others
+#define BATCH_CHUNK 64
+
+typedef struct {
+    Board **boards;
+    MoveList *out;
+    int count;
+} MoveBatch;
+
+// the positions are generated in the order they come in. positions from the
+// same game one after another already reuse the tables best, sorting them by
+// address, by king square or by piece layout first didn't pay for the sort
+void GenerateMovesBatch(Board **boards, int n, MoveList *out)
+{
+    if(!dataGenerated) GenerateMoveData();
+    for(int i = 0; i < n; i++)
+    {
+        if(i+1 < n) __builtin_prefetch(boards[i+1]->map);
+        GenerateMoves(boards[i], &out[i]);
+    }
+}
+
+static void GenerateMovesBatchChunk(void *arg, int chunk)
+{
+    MoveBatch *batch = arg;
+    int start = chunk * BATCH_CHUNK;
+    int end   = start + BATCH_CHUNK;
+    if(end > batch->count) end = batch->count;
+    GenerateMovesBatch(&batch->boards[start], end - start, &batch->out[start]);
+}
+
+void GenerateMovesBatchParallel(ThreadPool *pool, Board **boards, int n, MoveList *out)
+{
+    // the tables have to exist before the workers race to generate them
+    if(!dataGenerated) GenerateMoveData();
+
+    MoveBatch batch = { .boards = boards, .out = out, .count = n };
+    int chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    ParallelFor(pool, chunks, GenerateMovesBatchChunk, &batch);
+}
+
 void GenerateKingMoves(Board *board, MoveList *moveList)
 {
     PieceList *list = GetPieceList(board, board->colourToMove | KING);
@@ -205,115 +712,154 @@ void GenerateKingMoves(Board *board, MoveList *moveList)
     }
 }
 
-void GeneratePawnMoves(Board *board, MoveList *moveList)
+void GeneratePawnMovesFrom(Board *board, int square, MoveList *moveList)
 {
-    PieceList *pawns = GetPieceList(board, board->colourToMove | PAWN);
-    for(int pieceIndex = 0; pieceIndex < pawns->count; pieceIndex++)
-    {
-        int square = pawns->pieces[pieceIndex];
-        int rank = square / 24;
-        int file = square % 24;
-        int section = file / 8;
+    int rank = square / 24;
 
-        bool crossedCenter = (GetPieceType(board->map[square]) == PAWNCC);
-        int dir = (crossedCenter) ? SO : NO;
+    bool crossedCenter = (GetPieceType(board->map[square]) == PAWNCC);
+    int dir = (crossedCenter) ? SO : NO;
 
-        Move firstMove = moves[square][dir][0]; 
-        if(board->map[firstMove.target] == NONE)
+    Move firstMove = moves[square][dir][0]; 
+    if(board->map[firstMove.target] == NONE)
+    {
+        if(pinMap[square] && !MovingAlongRay(square, dir)) goto skipForward;
+        int targetRank = firstMove.target / 24;
+        uint8_t flag = NOFLAG;
+        if(rank == 5 && targetRank == 5) flag = PAWNCROSSCENTER; 
+        if(blocksCheck(firstMove)) 
         {
-            if(pinMap[square] && !MovingAlongRay(square, dir)) goto skipForward;
-            int targetRank = firstMove.target / 24;
-            uint8_t flag = NOFLAG;
-            if(rank == 5 && targetRank == 5) flag = PAWNCROSSCENTER; 
-            if(blocksCheck(firstMove)) 
+            if(targetRank == 0)
             {
-                if(targetRank == 0)
-                {
-                    AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOQUEEN  });
-                    AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOROOK   });
-                    AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOBISHOP });
-                    AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOKNIGHT });
-                }
-                else AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = flag });
+                AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOQUEEN  });
+                AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOROOK   });
+                AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOBISHOP });
+                AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = PROMOTETOKNIGHT });
             }
+            else AddMove(moveList, (Move) { .start  = firstMove.start, .target = firstMove.target, .flag = flag });
+        }
 
-            if (rank == 1 && !crossedCenter)
+        if (rank == 1 && !crossedCenter)
+        {
+            Move secondMove = moves[square][dir][1];
+            if(board->map[secondMove.target] == NONE)
             {
-                Move secondMove = moves[square][dir][1];
-                if(board->map[secondMove.target] == NONE)
-                {
-                    secondMove.flag = PAWNTWOFORWARD;
-                    if(blocksCheck(secondMove)) AddMove(moveList, secondMove);
-                } 
-            }
+                secondMove.flag = PAWNTWOFORWARD;
+                if(blocksCheck(secondMove)) AddMove(moveList, secondMove);
+            } 
         }
-        skipForward:
+    }
+    skipForward:
+
+    int startDir = (crossedCenter) ? SE : NW;
+    int endDir   = (crossedCenter) ? SW : NE;
+    for(int dir = startDir; dir <= endDir; dir++)
+    {
+        if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
 
-        int startDir = (crossedCenter) ? SE : NW;
-        int endDir   = (crossedCenter) ? SW : NE;
-        for(int dir = startDir; dir <= endDir; dir++)
+        Move move = moves[square][dir][0];
+        if(CrossesCreek(move) && !crossedCenter) continue;
+        if(CrossesMoat(move, dir, 0))
         {
-            if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
+            if(!CanCrossMoat(board, move, dir, 0)) continue;
+            if(board->map[move.target] != NONE) continue;
+        }
+        if(!blocksCheck(move)) continue;
+        int targetRank = move.target / 24;
 
-            Move move = moves[square][dir][0];
-            if(CrossesCreek(move) && !crossedCenter) continue;
-            if(CrossesMoat(move, dir, 0))
-            {
-                if(!CanCrossMoat(board, move, dir, 0)) continue;
-                if(board->map[move.target] != NONE) continue;
-            }
-            if(!blocksCheck(move)) continue;
-            int targetRank = move.target / 24;
+        int piece = board->map[move.target];
+        uint8_t flag = NOFLAG;
+        if(rank == 5 && targetRank == 5) flag = PAWNCROSSCENTER; 
+        else if(IsEnPassant(board, move))
+        {
+            if(IsEnPassantCheck(board, move)) continue;
+            flag = ENPASSANT;
+        } 
 
-            int piece = board->map[move.target];
-            uint8_t flag = NOFLAG;
-            if(rank == 5 && targetRank == 5) flag = PAWNCROSSCENTER; 
-            else if(IsEnPassant(board, move))
+        if((piece != NONE && !IsColour(piece, board->colourToMove)) || flag == ENPASSANT)
+        {
+            if(targetRank == 0)
             {
-                if(IsEnPassantCheck(board, move)) continue;
-                flag = ENPASSANT;
+                AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOQUEEN  });
+                AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOROOK   });
+                AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOBISHOP });
+                AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOKNIGHT });
             } 
+            else AddMove(moveList, (Move) { .start = move.start, .target = move.target, .flag = flag});
+        }
+    }
+}
 
-            if((piece != NONE && !IsColour(piece, board->colourToMove)) || flag == ENPASSANT)
-            {
-                if(targetRank == 0)
-                {
-                    AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOQUEEN  });
-                    AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOROOK   });
-                    AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOBISHOP });
-                    AddMove(moveList, (Move) { .start  = move.start, .target = move.target, .flag = PROMOTETOKNIGHT });
-                } 
-                else AddMove(moveList, (Move) { .start = move.start, .target = move.target, .flag = flag});
-            }
+void GeneratePawnMoves(Board *board, MoveList *moveList)
+{
+    PieceList *pawns = GetPieceList(board, board->colourToMove | PAWN);
+    for(int pieceIndex = 0; pieceIndex < pawns->count; pieceIndex++)
+    {
+        GeneratePawnMovesFrom(board, pawns->pieces[pieceIndex], moveList);
+    }
+}
+
+void GenerateKnightMovesFrom(Board *board, int square, MoveList *moveList)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        Move move = knightMoves[square][i];
+        if(IsNullMove(move)) continue;
+        if(pinMap[square] && !KnightMovingAlongRay(square, move, i)) continue;
+
+        if(KnightCrossesMoat(move)) 
+        {
+            if(!CanCrossMoat(board, move, i, 0)) continue;
+            if(board->map[move.target] != NONE) continue;
+            if(ChecksEnemy(board, move)) continue;
         }
+        if(!blocksCheck(move)) continue;
+
+        uint8_t piece = board->map[move.target];
+        if(IsColour(piece, board->colourToMove)) continue;
+        AddMove(moveList, move);
     }
 }
 
 void GenerateKnightMoves(Board *board, MoveList *moveList)
 {
     PieceList *knights = GetPieceList(board, board->colourToMove | KNIGHT);
-
     for(int pieceIndex = 0; pieceIndex < knights->count; pieceIndex++)
     {
-        int square = knights->pieces[pieceIndex];
-        for(int i = 0; i < 8; i++)
+        GenerateKnightMovesFrom(board, knights->pieces[pieceIndex], moveList);
+    }
+}
+
+void GenerateRookMovesFrom(Board *board, int square, MoveList *moveList)
+{
+    for(int dir = 0; dir < 4; dir++)
+    {
+        bool crossesBridgedMoat = false;
+        if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
+
+        for(int i = 0; i < 24; i++)
         {
-            Move move = knightMoves[square][i];
-            if(IsNullMove(move)) continue;
-            if(pinMap[square] && !KnightMovingAlongRay(square, move, i)) continue;
+            Move move = moves[square][dir][i];
+            if(IsNullMove(move)) break;
 
-            if(KnightCrossesMoat(move)) 
+            uint8_t piece = board->map[move.target];
+            if(IsColour(piece, board->colourToMove)) break;
+            if(CrossesMoat(move, dir, i))
             {
-                if(!CanCrossMoat(board, move, i, 0)) continue;
-                if(board->map[move.target] != NONE) continue;
+                if(!CanCrossMoat(board, move, dir, i)) break;
+                crossesBridgedMoat = true;
+            }   
+
+            if(crossesBridgedMoat)
+            {
+                if(piece != NONE) break;
                 if(ChecksEnemy(board, move)) continue;
             }
+
             if(!blocksCheck(move)) continue;
 
-            uint8_t piece = board->map[move.target];
-            if(IsColour(piece, board->colourToMove)) continue;
             AddMove(moveList, move);
-        }
+            if(piece != NONE) break;
+        }   
     }
 }
 
@@ -321,37 +867,40 @@ void GenerateRookMoves(Board *board, MoveList *moveList, PieceList *pieceList)
 {
     for(int pieceIndex = 0; pieceIndex < pieceList->count; pieceIndex++)
     {
-        int square = pieceList->pieces[pieceIndex];
-        for(int dir = 0; dir < 4; dir++)
+        GenerateRookMovesFrom(board, pieceList->pieces[pieceIndex], moveList);
+    }
+}
+
+void GenerateBishopMovesFrom(Board *board, int square, MoveList *moveList)
+{
+    for(int dir = 4; dir < 8; dir++)
+    {
+        bool crossesBridgedMoat = false;
+        if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
+        for(int i = 0; i < 24; i++)
         {
-            bool crossesBridgedMoat = false;
-            if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
+            Move move = moves[square][dir][i];
+            if(IsNullMove(move)) break;
 
-            for(int i = 0; i < 24; i++)
+            uint8_t piece = board->map[move.target];
+            if(IsColour(piece, board->colourToMove)) break;
+            if(CrossesMoat(move, dir, i))
             {
-                Move move = moves[square][dir][i];
-                if(IsNullMove(move)) break;
-
-                uint8_t piece = board->map[move.target];
-                if(IsColour(piece, board->colourToMove)) break;
-                if(CrossesMoat(move, dir, i))
-                {
-                    if(!CanCrossMoat(board, move, dir, i)) break;
-                    crossesBridgedMoat = true;
-                }   
+                if(!CanCrossMoat(board, move, dir, i)) break;
+                crossesBridgedMoat = true;
+            }
 
-                if(crossesBridgedMoat)
-                {
-                    if(piece != NONE) break;
-                    if(ChecksEnemy(board, move)) continue;
-                }
+            if(crossesBridgedMoat)
+            {
+                if(piece != NONE) break;
+                if(ChecksEnemy(board, move)) continue;
+            }
 
-                if(!blocksCheck(move)) continue;
+            if(!blocksCheck(move)) continue;
 
-                AddMove(moveList, move);
-                if(piece != NONE) break;
-            }   
-        }
+            AddMove(moveList, move);
+            if(piece != NONE) break;
+        }   
     }
 }
 
@@ -359,36 +908,7 @@ void GenerateBishopMoves(Board *board, MoveList *moveList, PieceList *pieceList)
 {
     for(int pieceIndex = 0; pieceIndex < pieceList->count; pieceIndex++)
     {
-        int square = pieceList->pieces[pieceIndex];
-        for(int dir = 4; dir < 8; dir++)
-        {
-            bool crossesBridgedMoat = false;
-            if(pinMap[square] && !MovingAlongRay(square, dir)) continue;
-            for(int i = 0; i < 24; i++)
-            {
-                Move move = moves[square][dir][i];
-                if(IsNullMove(move)) break;
-
-                uint8_t piece = board->map[move.target];
-                if(IsColour(piece, board->colourToMove)) break;
-                if(CrossesMoat(move, dir, i))
-                {
-                    if(!CanCrossMoat(board, move, dir, i)) break;
-                    crossesBridgedMoat = true;
-                }
-
-                if(crossesBridgedMoat)
-                {
-                    if(piece != NONE) break;
-                    if(ChecksEnemy(board, move)) continue;
-                }
-
-                if(!blocksCheck(move)) continue;
-
-                AddMove(moveList, move);
-                if(piece != NONE) break;
-            }   
-        }
+        GenerateBishopMovesFrom(board, pieceList->pieces[pieceIndex], moveList);
     }
 }
 
@@ -693,6 +1213,7 @@ bool CanCrossMoat(Board *board, Move move, int dir, int distance)
         case 1:
             if(targetSection == 0) moat = 1;
             else if(targetSection == 2) moat = 2;
+            break;
         case 2:
             if(targetSection == 1) moat = 2;
             else if(targetSection == 0) moat = 0;
@@ -744,6 +1265,7 @@ bool ChecksEnemy(Board *board, Move move)
             for(int i = 0; i < 24; i++)
             {
                 Move m = moves[move.target][dir][i];
+                if(IsNullMove(m)) break;
                 if(CrossesMoat(m, dir, i)) break;
                 int piece = board->map[m.target];
                 int pieceType = GetPieceType(piece);
@@ -758,6 +1280,7 @@ bool ChecksEnemy(Board *board, Move move)
         for(int i = 0; i < 8; i++)
         {
             Move m = knightMoves[move.target][i];
+            if(IsNullMove(m)) continue;
             int piece = board->map[m.target];
             int pieceType = GetPieceType(piece);
             int pieceColour = GetPieceColour(piece);
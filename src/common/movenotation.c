@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "common.h"
@@ -18,6 +19,45 @@ inline char GetPieceNotation(int pieceType)
     }
 }
 
+// writes square as its section, file and rank, always three characters
+static void WriteSquare(char *text, int square)
+{
+    int file = square % 24;
+    text[0] = sectionNames[file / 8];
+    text[1] = 'a' + 7 - file % 8;
+    text[2] = '1' + square / 24;
+}
+
+// the square of three characters like WriteSquare writes them, -1 if it isn't one
+static int ParseSquare(const char *text)
+{
+    const char *section = memchr(sectionNames, text[0], 3);
+    if(section == NULL || text[1] < 'a' || text[1] > 'h' || text[2] < '1' || text[2] > '6') return -1;
+    return (text[2] - '1') * 24 + (section - sectionNames) * 8 + 7 - (text[1] - 'a');
+}
+
+static inline int NotationType(Board *board, int square)
+{
+    int type = GetPieceType(board->map[square]);
+    return (type == PAWNCC) ? PAWN : type;
+}
+
+// true when another piece of the same type can move to the target of move,
+// the notation needs the start square then
+static bool NeedsStartSquare(Board *board, Move move)
+{
+    static _Thread_local MoveList moveList = { 0 };
+    GenerateMoves(board, &moveList);
+
+    int type = NotationType(board, move.start);
+    for(int i = 0; i < moveList.count; i++)
+    {
+        Move other = moveList.moves[i];
+        if(other.target == move.target && other.start != move.start && NotationType(board, other.start) == type) return true;
+    }
+    return false;
+}
+
 void GetMoveNotation(Board *board, Move move, MoveNotations *notations)
 {
     if(IsNullMove(move))
@@ -26,12 +66,10 @@ void GetMoveNotation(Board *board, Move move, MoveNotations *notations)
         return;
     }
 
-    char *moveNotation = malloc(8);
-    
-    int targetRank    = move.target / 24;
-    int targetFile    = move.target % 24;
-    int targetSection = targetFile / 8;
-    targetFile %= 8; // make the file relative to the section
+    // piece, start square, capture, target, promotion, check
+    char *moveNotation = malloc(16);
+
+    int targetFile = (move.target % 24) % 8; // relative to the section
 
     int index = 0;
     if(move.flag == CASTLE)
@@ -50,14 +88,18 @@ void GetMoveNotation(Board *board, Move move, MoveNotations *notations)
 
         char pieceNotation = GetPieceNotation(pieceType);
         if(pieceNotation != 0) moveNotation[index++] = pieceNotation;
+        if(NeedsStartSquare(board, move))
+        {
+            WriteSquare(&moveNotation[index], move.start);
+            index += 3;
+        }
         if(isCapture || move.flag == ENPASSANT)
         {
             moveNotation[index++] = 'x';
         }
 
-        moveNotation[index++] = sectionNames[targetSection];
-        moveNotation[index++] = 'a' + 7 - targetFile;
-        moveNotation[index++] = '1' + targetRank;
+        WriteSquare(&moveNotation[index], move.target);
+        index += 3;
         if(pieceType == PAWNCC)
         {
             switch(move.flag)
@@ -71,16 +113,110 @@ void GetMoveNotation(Board *board, Move move, MoveNotations *notations)
         }   
     }
 
+    // mate is decided on the position after the move
     Board _board = *board;
-    static MoveList list = { 0 };
-    list.count = 0;
-
-    GenerateMoves(&_board, &list);
-    if(list.count == 0 && InCheck())
+    MakeSearchMove(&_board, move);
+    if(!HasLegalMove(&_board) && InCheck())
     {
         moveNotation[index++] = '#';
     }
     else if(ChecksEnemy(board, move)) moveNotation[index++] = '+';
     moveNotation[index++] = '\00';
     nob_da_append(notations, moveNotation);
-}
\ No newline at end of file
+}
+
+// finds the legal move GetMoveNotation would write as notation. a notation
+// without a start square that more than one piece fits can't be read and
+// false is returned like for any other bad notation
+bool ParseMoveNotation(Board *board, const char *notation, Move *move)
+{
+    static _Thread_local MoveList moveList = { 0 };
+    GenerateMoves(board, &moveList);
+
+    int length = strlen(notation);
+    while(length > 0 && (notation[length-1] == '+' || notation[length-1] == '#')) length--;
+
+    if(length >= 3 && strncmp(notation, "O-O", 3) == 0)
+    {
+        bool queenSide = (length == 5 && strncmp(notation, "O-O-O", 5) == 0);
+        for(int i = 0; i < moveList.count; i++)
+        {
+            Move legalMove = moveList.moves[i];
+            if(legalMove.flag != CASTLE) continue;
+            if(((legalMove.target % 8) == 5) != queenSide) continue;
+            *move = legalMove;
+            return true;
+        }
+        return false;
+    }
+
+    int promotion = NOFLAG;
+    if(length >= 2 && notation[length-2] == '=')
+    {
+        switch(notation[length-1])
+        {
+            case 'N': promotion = PROMOTETOKNIGHT; break;
+            case 'B': promotion = PROMOTETOBISHOP; break;
+            case 'R': promotion = PROMOTETOROOK;   break;
+            case 'Q': promotion = PROMOTETOQUEEN;  break;
+            default: return false;
+        }
+        length -= 2;
+    }
+
+    // the target is always the last three characters. before it may come a
+    // piece letter, the start square and a capture mark, in that order
+    if(length < 3 || length > 8) return false;
+    int targetSquare = ParseSquare(&notation[length-3]);
+    if(targetSquare < 0) return false;
+
+    int prefix = length - 3;
+    if(prefix > 0 && notation[prefix-1] == 'x') prefix--;
+
+    int pieceType = PAWN;
+    if(prefix == 1 || prefix == 4)
+    {
+        pieceType = NONE;
+        for(int type = KING; type <= QUEEN; type++) if(GetPieceNotation(type) == notation[0]) pieceType = type;
+        if(pieceType == NONE) return false;
+    }
+
+    int startSquare = -1;
+    if(prefix == 3 || prefix == 4)
+    {
+        startSquare = ParseSquare(&notation[prefix-3]);
+        if(startSquare < 0) return false;
+    }
+    else if(prefix != 0 && prefix != 1) return false;
+
+    int matches = 0;
+    for(int i = 0; i < moveList.count; i++)
+    {
+        Move legalMove = moveList.moves[i];
+        if(legalMove.target != targetSquare) continue;
+        if(startSquare >= 0 && legalMove.start != startSquare) continue;
+        if(NotationType(board, legalMove.start) != pieceType) continue;
+
+        bool promotes = legalMove.flag >= PROMOTETOQUEEN && legalMove.flag <= PROMOTETOKNIGHT;
+        if(promotes ? legalMove.flag != promotion : promotion != NOFLAG) continue;
+
+        // rays through the centre can list the same move twice
+        if(matches > 0 && legalMove.start == move->start && legalMove.flag == move->flag) continue;
+        *move = legalMove;
+        matches++;
+    }
+    return matches == 1;
+}
+
+// a move of a game file, either start,target,flag or the notation
+bool ParseMoveToken(Board *board, const char *token, Move *move)
+{
+    int start, target, flag;
+    char end;
+    if(sscanf(token, "%d,%d,%d%c", &start, &target, &flag, &end) == 3)
+    {
+        *move = (Move) { .start = start, .target = target, .flag = flag };
+        return start >= 0 && start < 144 && target >= 0 && target < 144 && IsLegalMove(board, *move);
+    }
+    return ParseMoveNotation(board, token, move);
+}
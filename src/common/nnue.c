@@ -0,0 +1,279 @@
+#include "./common.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NNUE_X86
+#endif
+
+// efficiently updatable neural network evaluation
+//
+// every colour looks at the board from its own side: a feature is a piece
+// (relative colour, type) on a square turned so the perspective's home
+// section is section 0. each perspective has an accumulator holding the
+// first layer output, a move only adds and removes the rows of the squares
+// it changed (Board.changes). the output for a colour is a dot product of
+// the clipped accumulators in the order own, next colour, previous colour
+//
+// weights file, little endian, every block starts on a 32 byte boundary:
+//  NNUEHeader
+//  int16 featureWeights[NNUE_FEATURES][NNUE_HIDDEN]
+//  int16 featureBias[NNUE_HIDDEN]
+//  int16 outputWeights[3*NNUE_HIDDEN]
+//  int32 outputBias (padded to 32 bytes)
+
+#define NNUE_MAGIC   "3MCNNUE"
+#define NNUE_VERSION 1
+#define NNUE_QA      255 // activations are clipped to [0, QA]
+#define NNUE_QB      64  // output weights are scaled by QB, the output bias by QA * QB
+#define NNUE_SCALE   400 // network output to centipawns
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t features;
+    uint32_t hidden;
+    uint32_t reserved[3];
+} NNUEHeader;
+
+struct NNUE {
+    void *data;
+    size_t size;
+    bool mapped;
+
+    const int16_t *featureWeights;
+    const int16_t *featureBias;
+    const int16_t *outputWeights;
+    int32_t outputBias;
+};
+
+static inline size_t AlignUp(size_t size)
+{
+    return (size + 31) & ~(size_t)31;
+}
+
+static size_t NNUEFileSize()
+{
+    return AlignUp(sizeof(NNUEHeader))
+         + AlignUp(sizeof(int16_t) * NNUE_FEATURES * NNUE_HIDDEN)
+         + AlignUp(sizeof(int16_t) * NNUE_HIDDEN)
+         + AlignUp(sizeof(int16_t) * 3 * NNUE_HIDDEN)
+         + AlignUp(sizeof(int32_t));
+}
+
+static bool SetupNetwork(NNUE *network)
+{
+    const NNUEHeader *header = network->data;
+    if(network->size < NNUEFileSize()) return false;
+    if(memcmp(header->magic, NNUE_MAGIC, sizeof(NNUE_MAGIC)) != 0) return false;
+    if(header->version != NNUE_VERSION || header->features != NNUE_FEATURES || header->hidden != NNUE_HIDDEN) return false;
+
+    const uint8_t *data = network->data;
+    size_t offset = AlignUp(sizeof(NNUEHeader));
+    network->featureWeights = (const int16_t *)(data + offset);
+    offset += AlignUp(sizeof(int16_t) * NNUE_FEATURES * NNUE_HIDDEN);
+    network->featureBias = (const int16_t *)(data + offset);
+    offset += AlignUp(sizeof(int16_t) * NNUE_HIDDEN);
+    network->outputWeights = (const int16_t *)(data + offset);
+    offset += AlignUp(sizeof(int16_t) * 3 * NNUE_HIDDEN);
+    memcpy(&network->outputBias, data + offset, sizeof(int32_t));
+    return true;
+}
+
+NNUE *LoadNNUE(const char *path)
+{
+    NNUE *network = calloc(1, sizeof(NNUE));
+    network->data = MapFile(path, &network->size);
+    network->mapped = true;
+    if(network->data == NULL || !SetupNetwork(network))
+    {
+        if(network->data != NULL) UnmapFile(network->data, network->size);
+        free(network);
+        return NULL;
+    }
+    return network;
+}
+
+void FreeNNUE(NNUE *network)
+{
+    if(network->mapped) UnmapFile(network->data, network->size);
+    else free(network->data);
+    free(network);
+}
+
+static int16_t RandomWeight(uint64_t *state, int range)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (int16_t)((int)((*state >> 40) % (uint64_t)(2*range + 1)) - range);
+}
+
+// writes a network with small random weights, a starting point for training
+// and enough to benchmark the inference
+bool WriteRandomNNUE(const char *path, uint64_t seed)
+{
+    size_t size = NNUEFileSize();
+    uint8_t *data = calloc(1, size);
+    if(data == NULL) return false;
+
+    NNUEHeader *header = (NNUEHeader *)data;
+    memcpy(header->magic, NNUE_MAGIC, sizeof(NNUE_MAGIC));
+    header->version  = NNUE_VERSION;
+    header->features = NNUE_FEATURES;
+    header->hidden   = NNUE_HIDDEN;
+
+    NNUE network = { .data = data, .size = size };
+    SetupNetwork(&network);
+
+    uint64_t state = seed ? seed : 0x2545F4914F6CDD1DULL;
+    for(int i = 0; i < NNUE_FEATURES * NNUE_HIDDEN; i++) ((int16_t *)network.featureWeights)[i] = RandomWeight(&state, 16);
+    for(int i = 0; i < NNUE_HIDDEN; i++)                 ((int16_t *)network.featureBias)[i]    = RandomWeight(&state, 16);
+    for(int i = 0; i < 3 * NNUE_HIDDEN; i++)             ((int16_t *)network.outputWeights)[i]  = RandomWeight(&state, NNUE_QB);
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, size, file) == size;
+    if(file != NULL) fclose(file);
+    free(data);
+    return ok;
+}
+
+// the feature of piece on square as seen by perspective (a colour index)
+static inline int FeatureIndex(int perspective, uint8_t piece, int square)
+{
+    int colourIndex = (GetPieceColour(piece) >> 3) - 1;
+    int relativeColour = mod(colourIndex - perspective, 3);
+    int relativeSquare = RotateSquare(square, 3 - perspective);
+    return (relativeColour * 8 + GetPieceType(piece)) * 144 + relativeSquare;
+}
+
+#ifdef NNUE_X86
+__attribute__((target("avx2")))
+static void AddRowAVX2(int16_t *accumulator, const int16_t *row, bool add)
+{
+    for(int i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&accumulator[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&row[i]);
+        a = add ? _mm256_add_epi16(a, w) : _mm256_sub_epi16(a, w);
+        _mm256_storeu_si256((__m256i *)&accumulator[i], a);
+    }
+}
+
+__attribute__((target("avx2")))
+static int32_t OutputAVX2(const int16_t *accumulator, const int16_t *weights)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i high = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum  = _mm256_setzero_si256();
+    for(int i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&accumulator[i]);
+        __m256i w = _mm256_loadu_si256((const __m256i *)&weights[i]);
+        a = _mm256_min_epi16(_mm256_max_epi16(a, zero), high);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+static void AddRowScalar(int16_t *accumulator, const int16_t *row, bool add)
+{
+    if(add) for(int i = 0; i < NNUE_HIDDEN; i++) accumulator[i] += row[i];
+    else    for(int i = 0; i < NNUE_HIDDEN; i++) accumulator[i] -= row[i];
+}
+
+static int32_t OutputScalar(const int16_t *accumulator, const int16_t *weights)
+{
+    int32_t sum = 0;
+    for(int i = 0; i < NNUE_HIDDEN; i++)
+    {
+        int32_t value = accumulator[i];
+        if(value < 0) value = 0;
+        if(value > NNUE_QA) value = NNUE_QA;
+        sum += value * weights[i];
+    }
+    return sum;
+}
+
+static void (*AddRow)(int16_t *accumulator, const int16_t *row, bool add) = NULL;
+static int32_t (*Output)(const int16_t *accumulator, const int16_t *weights) = NULL;
+
+// picks the avx2 kernels when the cpu has them, returns the name of the ones in use
+const char *SelectNNUEKernels(bool allowSimd)
+{
+    AddRow = AddRowScalar;
+    Output = OutputScalar;
+#ifdef NNUE_X86
+    if(allowSimd && __builtin_cpu_supports("avx2"))
+    {
+        AddRow = AddRowAVX2;
+        Output = OutputAVX2;
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+// builds all three accumulators from scratch
+void RefreshAccumulator(NNUE *network, Accumulator *accumulator, Board *board)
+{
+    if(AddRow == NULL) SelectNNUEKernels(true);
+
+    for(int perspective = 0; perspective < 3; perspective++)
+    {
+        int16_t *values = accumulator->values[perspective];
+        memcpy(values, network->featureBias, sizeof(int16_t) * NNUE_HIDDEN);
+
+        for(int square = 0; square < 144; square++)
+        {
+            uint8_t piece = board->map[square];
+            if(piece == NONE) continue;
+            AddRow(values, &network->featureWeights[FeatureIndex(perspective, piece, square) * NNUE_HIDDEN], true);
+        }
+    }
+}
+
+// child is parent after one MakeMove, only the squares the move changed are applied
+void UpdateAccumulator(NNUE *network, Accumulator *parent, Accumulator *child, Board *board)
+{
+    if(AddRow == NULL) SelectNNUEKernels(true);
+    if(child != parent) memcpy(child, parent, sizeof(Accumulator));
+
+    for(int i = 0; i < board->changeCount; i++)
+    {
+        SquareChange change = board->changes[i];
+        for(int perspective = 0; perspective < 3; perspective++)
+        {
+            int16_t *values = child->values[perspective];
+            if(change.before != NONE) AddRow(values, &network->featureWeights[FeatureIndex(perspective, change.before, change.square) * NNUE_HIDDEN], false);
+            if(change.after  != NONE) AddRow(values, &network->featureWeights[FeatureIndex(perspective, change.after,  change.square) * NNUE_HIDDEN], true);
+        }
+    }
+}
+
+// one score per colour in centipawns, from that colour's own perspective
+void EvaluateNNUE(NNUE *network, Accumulator *accumulator, Board *board, int scores[3])
+{
+    if(Output == NULL) SelectNNUEKernels(true);
+
+    for(int perspective = 0; perspective < 3; perspective++)
+    {
+        if(((perspective+1) << 3) == board->eliminatedColour)
+        {
+            scores[perspective] = 0;
+            continue;
+        }
+
+        int32_t sum = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            const int16_t *values = accumulator->values[(perspective + i) % 3];
+            sum += Output(values, &network->outputWeights[i * NNUE_HIDDEN]);
+        }
+        scores[perspective] = (int)(((int64_t)sum + network->outputBias) * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+    }
+}
@@ -0,0 +1,649 @@
+#include "./common.h"
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <string.h>
+
+typedef CRITICAL_SECTION   Mutex;
+typedef CONDITION_VARIABLE Condition;
+
+struct Thread {
+    HANDLE handle;
+    void (*function)(void *arg);
+    void *arg;
+};
+
+double GetMonotonicTime()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+int GetCoreCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+static DWORD WINAPI ThreadEntry(LPVOID arg)
+{
+    Thread *thread = arg;
+    thread->function(thread->arg);
+    return 0;
+}
+
+Thread *StartThread(void (*function)(void *arg), void *arg)
+{
+    Thread *thread = malloc(sizeof(Thread));
+    thread->function = function;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, ThreadEntry, thread, 0, NULL);
+    if(thread->handle == NULL)
+    {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void JoinThread(Thread *thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+// maps a whole file read-only, returns NULL if it can't be opened
+void *MapFile(const char *path, size_t *size)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(mapping == NULL) return NULL;
+
+    // the view keeps the mapping alive after the handle is closed
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(data == NULL) return NULL;
+
+    *size = fileSize.QuadPart;
+    return data;
+}
+
+void UnmapFile(void *data, size_t size)
+{
+    (void)size;
+    UnmapViewOfFile(data);
+}
+
+// zeroed memory for big tables. large pages need a privilege most accounts
+// don't have, so hugePages is only a hint nobody follows here
+void *AllocateLargeMemory(size_t size, bool hugePages)
+{
+    (void)hugePages;
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void FreeLargeMemory(void *memory, size_t size)
+{
+    (void)size;
+    if(memory != NULL) VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+struct Process {
+    HANDLE handle;
+    HANDLE input;  // the child's stdin
+    HANDLE output; // the child's stdout, opened for overlapped reads
+    HANDLE readDone;
+};
+
+// runs a command line with its stdin and stdout connected to pipes. anonymous
+// pipes can't be read with a timeout, so the child's stdout is a named pipe
+// only this process knows the name of
+Process *StartProcess(const char *command)
+{
+    static atomic_int pipeCount = 0;
+    char pipeName[64];
+    snprintf(pipeName, sizeof(pipeName), "\\\\.\\pipe\\3_man_chess_%lu_%d", GetCurrentProcessId(), atomic_fetch_add(&pipeCount, 1));
+
+    SECURITY_ATTRIBUTES attributes = { .nLength = sizeof(attributes), .bInheritHandle = TRUE };
+    HANDLE childInput, parentInput;
+    if(!CreatePipe(&childInput, &parentInput, &attributes, 0)) return NULL;
+    SetHandleInformation(parentInput, HANDLE_FLAG_INHERIT, 0);
+
+    HANDLE parentOutput = CreateNamedPipeA(pipeName, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                           PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 4096, 4096, 0, NULL);
+    HANDLE childOutput = INVALID_HANDLE_VALUE;
+    if(parentOutput != INVALID_HANDLE_VALUE)
+    {
+        childOutput = CreateFileA(pipeName, GENERIC_WRITE, 0, &attributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+    HANDLE readDone = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if(childOutput == INVALID_HANDLE_VALUE || readDone == NULL)
+    {
+        if(parentOutput != INVALID_HANDLE_VALUE) CloseHandle(parentOutput);
+        if(childOutput  != INVALID_HANDLE_VALUE) CloseHandle(childOutput);
+        if(readDone != NULL) CloseHandle(readDone);
+        CloseHandle(childInput);
+        CloseHandle(parentInput);
+        return NULL;
+    }
+
+    STARTUPINFOA startup = { .cb = sizeof(startup), .dwFlags = STARTF_USESTDHANDLES };
+    startup.hStdInput  = childInput;
+    startup.hStdOutput = childOutput;
+    startup.hStdError  = GetStdHandle(STD_ERROR_HANDLE);
+
+    PROCESS_INFORMATION info;
+    char *commandLine = _strdup(command);
+    BOOL started = CreateProcessA(NULL, commandLine, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info);
+    free(commandLine);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+    if(!started)
+    {
+        CloseHandle(parentInput);
+        CloseHandle(parentOutput);
+        CloseHandle(readDone);
+        return NULL;
+    }
+    CloseHandle(info.hThread);
+
+    Process *process = malloc(sizeof(Process));
+    process->handle   = info.hProcess;
+    process->input    = parentInput;
+    process->output   = parentOutput;
+    process->readDone = readDone;
+    return process;
+}
+
+int WriteProcess(Process *process, const void *src, int count)
+{
+    DWORD written;
+    if(!WriteFile(process->input, src, count, &written, NULL)) return -1;
+    return written;
+}
+
+// waits up to timeout milliseconds for output, returns 0 when there is none
+// and -1 once the process closed its stdout. the read wakes up as soon as
+// output arrives, a read that timed out is cancelled but may still have
+// finished in the meantime
+int ReadProcess(Process *process, void *dest, int count, int timeout)
+{
+    OVERLAPPED overlapped = { .hEvent = process->readDone };
+    DWORD read;
+    if(ReadFile(process->output, dest, count, &read, &overlapped)) return read;
+    if(GetLastError() != ERROR_IO_PENDING) return -1;
+
+    if(WaitForSingleObject(process->readDone, timeout) != WAIT_OBJECT_0) CancelIoEx(process->output, &overlapped);
+    if(GetOverlappedResult(process->output, &overlapped, &read, TRUE)) return read;
+    return (GetLastError() == ERROR_OPERATION_ABORTED) ? 0 : -1;
+}
+
+// closes the child's stdin, which asks it to quit, and kills it if it is
+// still running a second later
+void StopProcess(Process *process)
+{
+    CloseHandle(process->input);
+    if(WaitForSingleObject(process->handle, 1000) != WAIT_OBJECT_0) TerminateProcess(process->handle, 1);
+    CloseHandle(process->output);
+    CloseHandle(process->readDone);
+    CloseHandle(process->handle);
+    free(process);
+}
+
+static void InitMutex(Mutex *mutex)             { InitializeCriticalSection(mutex); }
+static void DestroyMutex(Mutex *mutex)          { DeleteCriticalSection(mutex); }
+static void LockMutex(Mutex *mutex)             { EnterCriticalSection(mutex); }
+static void UnlockMutex(Mutex *mutex)           { LeaveCriticalSection(mutex); }
+static void InitCondition(Condition *condition) { InitializeConditionVariable(condition); }
+static void DestroyCondition(Condition *condition) { (void)condition; }
+static void WaitCondition(Condition *condition, Mutex *mutex) { SleepConditionVariableCS(condition, mutex, INFINITE); }
+static void BroadcastCondition(Condition *condition) { WakeAllConditionVariable(condition); }
+
+#elif __GNUC__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t  Condition;
+
+struct Thread {
+    pthread_t handle;
+    void (*function)(void *arg);
+    void *arg;
+};
+
+double GetMonotonicTime()
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+int GetCoreCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? count : 1;
+}
+
+static void *ThreadEntry(void *arg)
+{
+    Thread *thread = arg;
+    thread->function(thread->arg);
+    return NULL;
+}
+
+Thread *StartThread(void (*function)(void *arg), void *arg)
+{
+    Thread *thread = malloc(sizeof(Thread));
+    thread->function = function;
+    thread->arg = arg;
+    if(pthread_create(&thread->handle, NULL, ThreadEntry, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void JoinThread(Thread *thread)
+{
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+// maps a whole file read-only, returns NULL if it can't be opened
+void *MapFile(const char *path, size_t *size)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+
+    *size = st.st_size;
+    return data;
+}
+
+void UnmapFile(void *data, size_t size)
+{
+    munmap(data, size);
+}
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// zeroed memory for big tables. with hugePages the mapping is aligned to a
+// huge page and the kernel is asked to back it with them, which saves most
+// of the tlb misses of random probes. it is only advice, without
+// transparent huge pages this is ordinary memory
+void *AllocateLargeMemory(size_t size, bool hugePages)
+{
+    if(!hugePages || size < HUGE_PAGE_SIZE)
+    {
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (memory == MAP_FAILED) ? NULL : memory;
+    }
+
+    // map a huge page more than needed and give back what's before and after the aligned part
+    size_t mapped = size + HUGE_PAGE_SIZE;
+    uint8_t *base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) return NULL;
+    uint8_t *memory = (uint8_t *)(((uintptr_t)base + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if(memory > base) munmap(base, memory - base);
+    if(base + mapped > memory + size) munmap(memory + size, base + mapped - (memory + size));
+#ifdef MADV_HUGEPAGE
+    madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    return memory;
+}
+
+void FreeLargeMemory(void *memory, size_t size)
+{
+    if(memory != NULL) munmap(memory, size);
+}
+
+struct Process {
+    pid_t pid;
+    int input;  // the child's stdin
+    int output; // the child's stdout
+};
+
+// runs a command with /bin/sh, its stdin and stdout connected to pipes
+Process *StartProcess(const char *command)
+{
+    int input[2], output[2];
+    if(pipe(input) != 0) return NULL;
+    if(pipe(output) != 0)
+    {
+        close(input[0]);
+        close(input[1]);
+        return NULL;
+    }
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(input[0]);
+        close(input[1]);
+        close(output[0]);
+        close(output[1]);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+
+    close(input[0]);
+    close(output[1]);
+    if(pid < 0)
+    {
+        close(input[1]);
+        close(output[0]);
+        return NULL;
+    }
+
+    // later children must not hold on to this one's pipes
+    fcntl(input[1],  F_SETFD, FD_CLOEXEC);
+    fcntl(output[0], F_SETFD, FD_CLOEXEC);
+
+    Process *process = malloc(sizeof(Process));
+    process->pid    = pid;
+    process->input  = input[1];
+    process->output = output[0];
+    return process;
+}
+
+int WriteProcess(Process *process, const void *src, int count)
+{
+    int written = 0;
+    while(written < count)
+    {
+        ssize_t result = write(process->input, (const char *)src + written, count - written);
+        if(result < 0 && errno == EINTR) continue;
+        if(result <= 0) return -1;
+        written += result;
+    }
+    return written;
+}
+
+// waits up to timeout milliseconds for output, returns 0 when there is none
+// and -1 once the process closed its stdout
+int ReadProcess(Process *process, void *dest, int count, int timeout)
+{
+    struct pollfd poller = { .fd = process->output, .events = POLLIN };
+    int ready = poll(&poller, 1, timeout);
+    if(ready < 0) return (errno == EINTR) ? 0 : -1;
+    if(ready == 0) return 0;
+
+    ssize_t result = read(process->output, dest, count);
+    if(result < 0) return (errno == EINTR) ? 0 : -1;
+    return (result == 0) ? -1 : result;
+}
+
+// closes the child's stdin, which asks it to quit, and kills it if it is
+// still running a second later
+void StopProcess(Process *process)
+{
+    close(process->input);
+    bool exited = false;
+    for(int i = 0; i < 100 && !exited; i++)
+    {
+        exited = waitpid(process->pid, NULL, WNOHANG) == process->pid;
+        if(!exited) usleep(10000);
+    }
+    if(!exited)
+    {
+        kill(process->pid, SIGKILL);
+        waitpid(process->pid, NULL, 0);
+    }
+    close(process->output);
+    free(process);
+}
+
+static void InitMutex(Mutex *mutex)             { pthread_mutex_init(mutex, NULL); }
+static void DestroyMutex(Mutex *mutex)          { pthread_mutex_destroy(mutex); }
+static void LockMutex(Mutex *mutex)             { pthread_mutex_lock(mutex); }
+static void UnlockMutex(Mutex *mutex)           { pthread_mutex_unlock(mutex); }
+static void InitCondition(Condition *condition) { pthread_cond_init(condition, NULL); }
+static void DestroyCondition(Condition *condition) { pthread_cond_destroy(condition); }
+static void WaitCondition(Condition *condition, Mutex *mutex) { pthread_cond_wait(condition, mutex); }
+static void BroadcastCondition(Condition *condition) { pthread_cond_broadcast(condition); }
+
+#endif
+
+// a fixed set of workers that sleep until ParallelFor hands them a job,
+// the calling thread works along so a pool of size n uses n threads total
+struct ThreadPool {
+    Thread **workers;
+    int workerCount;
+
+    Mutex mutex;
+    Condition wake;
+    Condition done;
+    uint64_t generation;
+    bool quit;
+
+    void (*job)(void *arg, int index);
+    void *arg;
+    int count;
+    atomic_int next;
+    int busyWorkers;
+};
+
+static void RunJobs(ThreadPool *pool)
+{
+    while(true)
+    {
+        int index = atomic_fetch_add(&pool->next, 1);
+        if(index >= pool->count) break;
+        pool->job(pool->arg, index);
+    }
+}
+
+static void WorkerLoop(void *arg)
+{
+    ThreadPool *pool = arg;
+    uint64_t seenGeneration = 0;
+
+    while(true)
+    {
+        LockMutex(&pool->mutex);
+        while(pool->generation == seenGeneration && !pool->quit) WaitCondition(&pool->wake, &pool->mutex);
+        if(pool->quit)
+        {
+            UnlockMutex(&pool->mutex);
+            return;
+        }
+        seenGeneration = pool->generation;
+        UnlockMutex(&pool->mutex);
+
+        RunJobs(pool);
+
+        LockMutex(&pool->mutex);
+        pool->busyWorkers--;
+        if(pool->busyWorkers == 0) BroadcastCondition(&pool->done);
+        UnlockMutex(&pool->mutex);
+    }
+}
+
+ThreadPool *CreateThreadPool(int threadCount)
+{
+    if(threadCount <= 0) threadCount = GetCoreCount();
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    InitMutex(&pool->mutex);
+    InitCondition(&pool->wake);
+    InitCondition(&pool->done);
+
+    pool->workers = calloc(threadCount, sizeof(Thread *));
+    for(int i = 0; i < threadCount - 1; i++)
+    {
+        Thread *thread = StartThread(WorkerLoop, pool);
+        if(thread == NULL) break;
+        pool->workers[pool->workerCount++] = thread;
+    }
+    return pool;
+}
+
+void DestroyThreadPool(ThreadPool *pool)
+{
+    LockMutex(&pool->mutex);
+    pool->quit = true;
+    BroadcastCondition(&pool->wake);
+    UnlockMutex(&pool->mutex);
+
+    for(int i = 0; i < pool->workerCount; i++) JoinThread(pool->workers[i]);
+
+    DestroyCondition(&pool->wake);
+    DestroyCondition(&pool->done);
+    DestroyMutex(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+}
+
+int ThreadPoolSize(ThreadPool *pool)
+{
+    return pool->workerCount + 1;
+}
+
+// calls job(arg, i) for every i in [0, count) spread over the pool, returns once all calls are done
+void ParallelFor(ThreadPool *pool, int count, void (*job)(void *arg, int index), void *arg)
+{
+    if(count <= 0) return;
+
+    LockMutex(&pool->mutex);
+    pool->job   = job;
+    pool->arg   = arg;
+    pool->count = count;
+    atomic_store(&pool->next, 0);
+    pool->busyWorkers = pool->workerCount;
+    pool->generation++;
+    BroadcastCondition(&pool->wake);
+    UnlockMutex(&pool->mutex);
+
+    RunJobs(pool);
+
+    LockMutex(&pool->mutex);
+    while(pool->busyWorkers > 0) WaitCondition(&pool->done, &pool->mutex);
+    UnlockMutex(&pool->mutex);
+}
+
+// workers that take jobs off a queue one at a time, for work whoever hands
+// it out can't wait for. unlike ParallelFor the caller doesn't work along
+typedef struct QueuedJob {
+    void (*job)(void *arg);
+    void *arg;
+    struct QueuedJob *next;
+} QueuedJob;
+
+struct JobQueue {
+    Thread **workers;
+    int workerCount;
+
+    Mutex mutex;
+    Condition wake;
+    QueuedJob *first;
+    QueuedJob *last;
+    bool quit;
+};
+
+static void QueueWorkerLoop(void *arg)
+{
+    JobQueue *queue = arg;
+    while(true)
+    {
+        LockMutex(&queue->mutex);
+        while(queue->first == NULL && !queue->quit) WaitCondition(&queue->wake, &queue->mutex);
+        QueuedJob *job = queue->first;
+        if(job == NULL)
+        {
+            UnlockMutex(&queue->mutex);
+            return;
+        }
+        queue->first = job->next;
+        if(queue->first == NULL) queue->last = NULL;
+        UnlockMutex(&queue->mutex);
+
+        job->job(job->arg);
+        free(job);
+    }
+}
+
+JobQueue *CreateJobQueue(int threadCount)
+{
+    if(threadCount <= 0) threadCount = GetCoreCount();
+
+    JobQueue *queue = calloc(1, sizeof(JobQueue));
+    InitMutex(&queue->mutex);
+    InitCondition(&queue->wake);
+
+    queue->workers = calloc(threadCount, sizeof(Thread *));
+    for(int i = 0; i < threadCount; i++)
+    {
+        Thread *thread = StartThread(QueueWorkerLoop, queue);
+        if(thread == NULL) break;
+        queue->workers[queue->workerCount++] = thread;
+    }
+    return queue;
+}
+
+// runs the jobs still queued and stops the workers
+void DestroyJobQueue(JobQueue *queue)
+{
+    LockMutex(&queue->mutex);
+    queue->quit = true;
+    BroadcastCondition(&queue->wake);
+    UnlockMutex(&queue->mutex);
+
+    for(int i = 0; i < queue->workerCount; i++) JoinThread(queue->workers[i]);
+
+    DestroyCondition(&queue->wake);
+    DestroyMutex(&queue->mutex);
+    free(queue->workers);
+    free(queue);
+}
+
+void SubmitJob(JobQueue *queue, void (*job)(void *arg), void *arg)
+{
+    QueuedJob *queued = malloc(sizeof(QueuedJob));
+    *queued = (QueuedJob) { .job = job, .arg = arg };
+
+    LockMutex(&queue->mutex);
+    if(queue->last != NULL) queue->last->next = queued;
+    else queue->first = queued;
+    queue->last = queued;
+    BroadcastCondition(&queue->wake);
+    UnlockMutex(&queue->mutex);
+}
@@ -0,0 +1,271 @@
+#include <stdarg.h>
+#include <string.h>
+#include "./common.h"
+
+// engine protocol
+//
+// engines that don't link against common.a talk to the server (or anything
+// else) with lines of text over their stdin and stdout. to the engine:
+//
+//  protocol                           answered with id lines and protocolok
+//  isready                            answered with readyok, also while searching
+//  setoption <name> <value>           hash in MB, threads, multipv (lines to find, 1 to 8),
+//                                     algorithm (paranoid or best-reply), book (a file
+//                                     made by booktool, or none)
+//  newgame                            forget everything about the last game
+//  position startpos [moves ...]
+//  position fen <fen> [moves ...]     the lines of the fen joined with |
+//  go [wtime ms] [gtime ms] [btime ms] [inc ms] [movetime ms] [depth n] [nodes n] [infinite] [ponder]
+//  ponderhit                          the ponder moves were played, the search goes on with its limits
+//  stop                               answered with bestmove
+//  quit
+//
+// from the engine:
+//
+//  id name <name>
+//  protocolok
+//  readyok
+//  info depth <n> multipv <n> score <centipawns> scores <white> <gray> <black> nodes <n> nps <n> time <ms> pv <moves>
+//  bestmove <move> [ponder <moves>]  the ponder moves are the predicted replies up to the engine's next turn
+//
+// go ponder searches the position after the ponder moves while the
+// opponents think, without limits until ponderhit. an infinite or ponder
+// search never answers before ponderhit or stop. any other go answers with
+// a book move at once when there is a book and the position is in it
+//
+// every finished iteration sends one info line per multipv line, best
+// first. score is what the search saw for the colour to move, scores is the
+// evaluation of every colour where the line ends
+//
+// a move is its start and target square, with q, r, b or n added when it
+// promotes, like Wc2Wc4 or Wb5Gb6q. castling is written as the king's move.
+// xW, xG and xB in a move list mean that colour was eliminated there, by
+// checkmate, timeout or resignation
+
+static const char sectionLetters[] = { 'W', 'G', 'B' };
+
+static void FormatSquare(int square, char *text)
+{
+    int rank = square / 24;
+    int file = square % 24;
+    text[0] = sectionLetters[file / 8];
+    text[1] = 'a' + 7 - file % 8;
+    text[2] = '1' + rank;
+}
+
+static int ParseSquare(const char *text)
+{
+    const char *section = memchr(sectionLetters, text[0], 3);
+    if(section == NULL || text[1] < 'a' || text[1] > 'h' || text[2] < '1' || text[2] > '6') return -1;
+    return (text[2] - '1') * 24 + (section - sectionLetters) * 8 + 7 - (text[1] - 'a');
+}
+
+// writes at most 7 characters and a terminator
+void FormatProtocolMove(Move move, char *text)
+{
+    if(IsNullMove(move))
+    {
+        strcpy(text, "0000");
+        return;
+    }
+
+    FormatSquare(move.start, &text[0]);
+    FormatSquare(move.target, &text[3]);
+    int length = 6;
+    switch(move.flag)
+    {
+        case PROMOTETOQUEEN:  text[length++] = 'q'; break;
+        case PROMOTETOROOK:   text[length++] = 'r'; break;
+        case PROMOTETOBISHOP: text[length++] = 'b'; break;
+        case PROMOTETOKNIGHT: text[length++] = 'n'; break;
+    }
+    text[length] = '\0';
+}
+
+// finds the legal move the text stands for
+bool ParseProtocolMove(Board *board, const char *text, Move *move)
+{
+    int length = strlen(text);
+    if(length != 6 && length != 7) return false;
+
+    int start  = ParseSquare(&text[0]);
+    int target = ParseSquare(&text[3]);
+    if(start < 0 || target < 0) return false;
+
+    int promotion = NOFLAG;
+    if(length == 7)
+    {
+        switch(text[6])
+        {
+            case 'q': promotion = PROMOTETOQUEEN;  break;
+            case 'r': promotion = PROMOTETOROOK;   break;
+            case 'b': promotion = PROMOTETOBISHOP; break;
+            case 'n': promotion = PROMOTETOKNIGHT; break;
+            default: return false;
+        }
+    }
+
+    static _Thread_local MoveList list = { 0 };
+    GeneratePieceMoves(board, start, &list);
+    for(int i = 0; i < list.count; i++)
+    {
+        Move legalMove = list.moves[i];
+        if(legalMove.target != target) continue;
+        bool promotes = legalMove.flag >= PROMOTETOQUEEN && legalMove.flag <= PROMOTETOKNIGHT;
+        if(promotes ? legalMove.flag != promotion : promotion != NOFLAG) continue;
+        *move = legalMove;
+        return true;
+    }
+    return false;
+}
+
+// the fen with its lines joined by |, so it fits on one line
+void FormatProtocolFen(const char *FEN, char *text, size_t size)
+{
+    size_t i = 0;
+    for(; FEN[i] != '\0' && i + 1 < size; i++) text[i] = (FEN[i] == '\n') ? '|' : FEN[i];
+    text[i] = '\0';
+}
+
+// sets up the board from what follows "position ", the move history is kept
+// so repetitions are seen
+bool SetupProtocolPosition(Board *board, char *arguments)
+{
+    char *moves = strstr(arguments, "moves");
+    if(moves != NULL)
+    {
+        moves[-1] = '\0';
+        moves += strlen("moves");
+    }
+
+    if(strncmp(arguments, "startpos", 8) == 0)
+    {
+        if(InitBoard(board, DEFAULT_FEN) != 0) return false;
+    }
+    else if(strncmp(arguments, "fen ", 4) == 0)
+    {
+        char FEN[256];
+        snprintf(FEN, sizeof(FEN), "%s", arguments + 4);
+        for(char *c = FEN; *c != '\0'; c++) if(*c == '|') *c = '\n';
+        if(InitBoard(board, FEN) != 0) return false;
+    }
+    else return false;
+
+    char *token = moves;
+    while(token != NULL && *token != '\0')
+    {
+        while(*token == ' ') token++;
+        if(*token == '\0' || *token == '\n' || *token == '\r') break;
+        char *end = token;
+        while(*end != '\0' && *end != ' ' && *end != '\n' && *end != '\r') end++;
+        char saved = *end;
+        *end = '\0';
+
+        const char *eliminated = (token[0] == 'x' && token[2] == '\0') ? memchr(sectionLetters, token[1], 3) : NULL;
+        if(eliminated != NULL)
+        {
+            uint8_t colour = ((eliminated - sectionLetters) + 1) << 3;
+            EliminateColour(board, colour);
+            if(board->colourToMove == colour) NextMove(board);
+        }
+        else
+        {
+            Move move;
+            if(!ParseProtocolMove(board, token, &move)) return false;
+            MakeMove(board, move);
+        }
+
+        *end = saved;
+        token = end;
+    }
+    return true;
+}
+
+struct EngineProcess {
+    Process *process;
+    char buffer[4096];
+    int length;
+};
+
+EngineProcess *StartEngine(const char *command)
+{
+    Process *process = StartProcess(command);
+    if(process == NULL) return NULL;
+
+    EngineProcess *engine = calloc(1, sizeof(EngineProcess));
+    engine->process = process;
+    return engine;
+}
+
+void StopEngine(EngineProcess *engine)
+{
+    SendToEngine(engine, "quit");
+    StopProcess(engine->process);
+    free(engine);
+}
+
+// sends one line, the newline is added here. a position late in a game
+// doesn't fit a small buffer, those lines are allocated
+bool SendToEngine(EngineProcess *engine, const char *format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer) - 1, format, args);
+    va_end(args);
+    if(length < 0) return false;
+
+    char *line = buffer;
+    if(length >= (int)sizeof(buffer) - 1)
+    {
+        line = malloc(length + 2);
+        va_start(args, format);
+        vsnprintf(line, length + 1, format, args);
+        va_end(args);
+    }
+
+    line[length++] = '\n';
+    bool sent = WriteProcess(engine->process, line, length) == length;
+    if(line != buffer) free(line);
+    return sent;
+}
+
+// returns 1 with the next line in line, 0 when no full line came within
+// timeout milliseconds and -1 when the engine is gone
+int ReadEngineLine(EngineProcess *engine, char *line, int size, int timeout)
+{
+    double deadline = GetMonotonicTime() + timeout / 1000.0;
+    while(true)
+    {
+        char *newline = memchr(engine->buffer, '\n', engine->length);
+        if(newline != NULL)
+        {
+            int length = newline - engine->buffer;
+            int copied = (length < size - 1) ? length : size - 1;
+            memcpy(line, engine->buffer, copied);
+            line[copied] = '\0';
+            if(copied > 0 && line[copied-1] == '\r') line[copied-1] = '\0';
+
+            engine->length -= length + 1;
+            memmove(engine->buffer, newline + 1, engine->length);
+            return 1;
+        }
+
+        // a line that doesn't fit is cut in two
+        if(engine->length == sizeof(engine->buffer))
+        {
+            int copied = (engine->length < size - 1) ? engine->length : size - 1;
+            memcpy(line, engine->buffer, copied);
+            line[copied] = '\0';
+            engine->length = 0;
+            return 1;
+        }
+
+        int left = (int)((deadline - GetMonotonicTime()) * 1000.0);
+        if(left < 0) left = 0;
+        int count = ReadProcess(engine->process, engine->buffer + engine->length, sizeof(engine->buffer) - engine->length, left);
+        if(count < 0) return -1;
+        if(count == 0 && left == 0) return 0;
+        engine->length += count;
+    }
+}
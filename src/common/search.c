@@ -0,0 +1,937 @@
+#include "./common.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// paranoid search: the colour to move at the root maximizes its own score
+// while both opponents are assumed to work together to minimize it, which
+// turns the three player game into a two player one alpha-beta can handle
+//
+// best-reply search goes one step further: an opponent layer holds the moves
+// of both opponents and only the strongest of them is played before the root
+// colour moves again, so the root colour gets twice as many moves in the same
+// depth. once a colour is eliminated both are plain two player alpha-beta
+
+#define INFINITE_SCORE (MATE_SCORE + 1)
+#define MAX_QUIESCENCE_PLY 8
+#define TIME_CHECK_INTERVAL 2048
+#define MAX_MOVES 512
+
+// STATS(...) is only compiled in with SEARCH_STATS, see common.h
+#ifdef SEARCH_STATS
+#define STATS(...) __VA_ARGS__
+#else
+#define STATS(...)
+#endif
+
+struct Engine {
+    TranspositionTable *table;
+    bool sharedTable; // belongs to whoever made the engine, see CreateSharingEngine
+    atomic_bool stop;
+    double startTime;
+    _Atomic double deadline;          // changed by PonderHit while the search runs
+    _Atomic double optimumTime;       // soft limit from the clock budget, 0 without one
+    _Atomic double ponderDeadline;    // the limits a ponder search gets once PonderHit is called
+    _Atomic double ponderOptimumTime;
+    uint64_t maxNodes;
+    atomic_uint_fast64_t nodes;
+};
+
+typedef struct {
+    Engine *engine;
+    Board root;
+    int id;
+    uint8_t rootColour;
+    uint8_t tableOwner;
+    uint64_t nodes;
+    int maxDepth;
+
+    MoveList moveLists[MAX_PLY];
+    int moveScores[MAX_PLY][MAX_MOVES];
+    Move killers[MAX_PLY][2];
+    int history[144][144];
+    uint64_t pathHashes[MAX_PLY];
+
+    // accumulators[ply] belongs to the board searched at ply when a network is used
+    Accumulator accumulators[MAX_PLY+1];
+
+    Move pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+
+    // root moves that already have a line in this iteration of a multi-pv search
+    Move excluded[MAX_MULTIPV];
+    int excludedCount;
+
+    // how the last iterations went, for the time management
+    Move previousBest;
+    int previousScore;
+    int stableIterations;
+    double previousIterationTime;
+    double iterationGrowth;
+
+    SearchLimits limits;
+    SearchResult result;
+
+#ifdef SEARCH_STATS
+    SearchStats stats;
+    uint32_t traceIds[MAX_PLY+1];
+    uint8_t traceFlags[MAX_PLY+1];
+    Move traceMoves[MAX_PLY+1]; // the move that led to the node at ply
+#endif
+} SearchThread;
+
+#ifdef SEARCH_STATS
+static FILE *traceFile = NULL;
+static int tracePlies = 0;
+static atomic_uint traceNextId = 0;
+
+// a cheap clock for timing small parts of the search, the cycle counter where there is one
+static inline uint64_t StatsTicks()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)(GetMonotonicTime() * 1e9);
+#endif
+}
+
+void MergeSearchStats(SearchStats *into, const SearchStats *from)
+{
+    // nothing but counters in there
+    uint64_t *a = (uint64_t *)into;
+    const uint64_t *b = (const uint64_t *)from;
+    for(size_t i = 0; i < sizeof(SearchStats) / sizeof(uint64_t); i++) a[i] += b[i];
+}
+
+void PrintSearchStats(FILE *file, const SearchStats *stats)
+{
+    uint64_t nodes = stats->quiescenceNodes;
+    for(int ply = 0; ply < MAX_PLY; ply++) nodes += stats->nodes[ply];
+    double percent = (nodes > 0) ? 100.0 / nodes : 0;
+
+    fprintf(file, "ply        nodes   branching   cutoffs  first move\n");
+    for(int ply = 0; ply < MAX_PLY; ply++)
+    {
+        if(stats->nodes[ply] == 0) continue;
+        fprintf(file, "%3d %12llu %11.2f %8.1f%% %10.1f%%\n", ply, (unsigned long long)stats->nodes[ply],
+                (stats->expanded[ply] > 0) ? (double)stats->children[ply] / stats->expanded[ply] : 0.0,
+                (stats->expanded[ply] > 0) ? 100.0 * stats->cutoffs[ply] / stats->expanded[ply] : 0.0,
+                (stats->cutoffs[ply] > 0) ? 100.0 * stats->firstCutoffs[ply] / stats->cutoffs[ply] : 0.0);
+    }
+    fprintf(file, "quiescence:   %llu nodes, %.1f%% of all\n", (unsigned long long)stats->quiescenceNodes, stats->quiescenceNodes * percent);
+    fprintf(file, "table:        %llu probes, %.1f%% hits, %.1f%% cut off\n", (unsigned long long)stats->tableProbes,
+            (stats->tableProbes > 0) ? 100.0 * stats->tableHits / stats->tableProbes : 0.0,
+            (stats->tableProbes > 0) ? 100.0 * stats->tableCutoffs / stats->tableProbes : 0.0);
+    fprintf(file, "eliminations: %llu, %.1f%% of the nodes after one\n", (unsigned long long)stats->eliminations, stats->twoPlayerNodes * percent);
+    fprintf(file, "time:         %.1f%% generating moves, %.1f%% evaluating\n",
+            (stats->searchTicks > 0) ? 100.0 * stats->movegenTicks / stats->searchTicks : 0.0,
+            (stats->searchTicks > 0) ? 100.0 * stats->evalTicks / stats->searchTicks : 0.0);
+}
+
+// every search from now on writes the nodes thread 0 visits in the first
+// plies to path, NULL stops tracing
+bool SetSearchTrace(const char *path, int plies)
+{
+    if(traceFile != NULL) fclose(traceFile);
+    traceFile = NULL;
+    if(path == NULL) return true;
+
+    traceFile = fopen(path, "wb");
+    if(traceFile == NULL) return false;
+    tracePlies = (plies < MAX_PLY) ? plies : MAX_PLY;
+    SearchTraceHeader header = { .magic = SEARCH_TRACE_MAGIC, .version = SEARCH_TRACE_VERSION, .plies = tracePlies };
+    return fwrite(&header, sizeof(header), 1, traceFile) == 1;
+}
+
+static inline bool IsTraced(SearchThread *thread, int ply)
+{
+    return traceFile != NULL && thread->id == 0 && ply < tracePlies;
+}
+
+static void TraceEnter(SearchThread *thread, int ply)
+{
+    thread->traceIds[ply] = atomic_fetch_add(&traceNextId, 1);
+    thread->traceFlags[ply] = 0;
+    if(ply == 0) thread->traceMoves[0] = nullMove;
+}
+
+static void TraceExit(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta, int score)
+{
+    SearchTraceNode node = {
+        .id     = thread->traceIds[ply],
+        .parent = (ply > 0) ? thread->traceIds[ply-1] : SEARCH_TRACE_NO_PARENT,
+        .hash   = board->hash,
+        .alpha  = alpha,
+        .beta   = beta,
+        .score  = score,
+        .depth  = depth,
+        .ply    = ply,
+        .colour = board->colourToMove,
+        .move   = thread->traceMoves[ply],
+        .flags  = thread->traceFlags[ply],
+    };
+    fwrite(&node, sizeof(node), 1, traceFile);
+}
+#endif
+
+// the scores of the table are from the root colour's point of view and
+// depend on the algorithm, entries of other owners only lend their moves
+static inline uint8_t TableOwner(uint8_t rootColour, int algorithm)
+{
+    return (rootColour >> 3) - 1 + 3 * algorithm;
+}
+
+static inline bool IsBestReplyLayer(SearchThread *thread, Board *board)
+{
+    return thread->limits.algorithm == SEARCH_BEST_REPLY && board->colourToMove != thread->rootColour;
+}
+
+static inline void SetColourToMove(Board *board, uint8_t colour)
+{
+    board->hash ^= zobristColourToMove[board->colourToMove >> 3] ^ zobristColourToMove[colour >> 3];
+    board->colourToMove = colour;
+}
+
+// the moves searched at a node, for a best-reply opponent layer that is the
+// moves of both opponents, the piece on the start square tells who plays it.
+// with one opponent left only its moves are generated, so InCheck() is still
+// about the colour to move when the list comes back empty. returns the
+// opponent that has no moves while the other one is still in, NONE otherwise
+static uint8_t GenerateNodeMoves(SearchThread *thread, Board *board, MoveList *list)
+{
+    if(!IsBestReplyLayer(thread, board))
+    {
+        GenerateMoves(board, list);
+        return NONE;
+    }
+
+    static _Thread_local MoveList opponentMoves = { 0 };
+    list->count = 0;
+    uint8_t stuck = NONE;
+    uint8_t colour = board->colourToMove;
+    for(int i = 0; i < 2; i++)
+    {
+        if(colour != board->eliminatedColour)
+        {
+            Board _board = *board;
+            SetColourToMove(&_board, colour);
+            GenerateMoves(&_board, &opponentMoves);
+            for(int m = 0; m < opponentMoves.count; m++) AddMove(list, opponentMoves.moves[m]);
+            if(opponentMoves.count == 0 && stuck == NONE && board->eliminatedColour == NONE) stuck = colour;
+        }
+        colour = NextColourToPlay(&(Board) { .colourToMove = colour });
+    }
+    return stuck;
+}
+
+static void PlayNodeMove(SearchThread *thread, Board *board, Move move)
+{
+    if(!IsBestReplyLayer(thread, board))
+    {
+        MakeSearchMove(board, move);
+        return;
+    }
+
+    SetColourToMove(board, GetPieceColour(board->map[move.start]));
+    MakeSearchMove(board, move);
+    SetColourToMove(board, thread->rootColour);
+}
+
+static inline int ScoreToTable(int score, int ply)
+{
+    if(score >  MATE_SCORE - MAX_PLY) return score + ply;
+    if(score < -MATE_SCORE + MAX_PLY) return score - ply;
+    return score;
+}
+
+static inline int ScoreFromTable(int score, int ply)
+{
+    if(score >  MATE_SCORE - MAX_PLY) return score - ply;
+    if(score < -MATE_SCORE + MAX_PLY) return score + ply;
+    return score;
+}
+
+// collapses the score vector to the point of view of the root colour,
+// the opponents that are still in the game count as one coalition
+int ParanoidScore(Board *board, uint8_t rootColour, int scores[3])
+{
+    int rootIndex = (rootColour >> 3) - 1;
+    int opponentScore = 0;
+    int opponents = 0;
+    for(int i = 1; i <= 2; i++)
+    {
+        int index = (rootIndex + i) % 3;
+        if(((index+1) << 3) == board->eliminatedColour) continue;
+        opponentScore += scores[index];
+        opponents++;
+    }
+    if(opponents == 0) return scores[rootIndex];
+    return scores[rootIndex] - opponentScore / opponents;
+}
+
+static int EvaluateForRoot(SearchThread *thread, Board *board, int ply)
+{
+    STATS(uint64_t ticks = StatsTicks());
+    int scores[3];
+    if(thread->limits.network != NULL) EvaluateNNUE(thread->limits.network, &thread->accumulators[ply], board, scores);
+    else if(!ProbeEvalCache(thread->engine->table, board->hash, scores))
+    {
+        Evaluate(board, scores);
+        StoreEvalCache(thread->engine->table, board->hash, scores);
+    }
+    STATS(thread->stats.evalTicks += StatsTicks() - ticks);
+    return ParanoidScore(board, thread->rootColour, scores);
+}
+
+static inline bool IsCapture(Board *board, Move move)
+{
+    return board->map[move.target] != NONE || move.flag == ENPASSANT;
+}
+
+static inline bool IsPromotion(Move move)
+{
+    return move.flag >= PROMOTETOQUEEN && move.flag <= PROMOTETOKNIGHT;
+}
+
+static inline bool SameMove(Move a, Move b)
+{
+    return a.start == b.start && a.target == b.target && a.flag == b.flag;
+}
+
+static void ScoreMoves(SearchThread *thread, Board *board, MoveList *list, int *scores, Move tableMove, int ply)
+{
+    for(int i = 0; i < list->count; i++)
+    {
+        Move move = list->moves[i];
+        int score = 0;
+        if(SameMove(move, tableMove)) score = 1 << 30;
+        else if(IsCapture(board, move))
+        {
+            int victim   = materialValues[GetPieceType(board->map[move.target])];
+            int attacker = materialValues[GetPieceType(board->map[move.start])];
+            if(move.flag == ENPASSANT) victim = materialValues[PAWN];
+            score = (1 << 24) + victim * 16 - attacker / 16;
+        }
+        else if(move.flag == PROMOTETOQUEEN) score = (1 << 24);
+        else if(ply < MAX_PLY && SameMove(move, thread->killers[ply][0])) score = (1 << 23);
+        else if(ply < MAX_PLY && SameMove(move, thread->killers[ply][1])) score = (1 << 22);
+        else score = thread->history[move.start][move.target];
+        scores[i] = score;
+    }
+}
+
+// selection sort one step at a time, most nodes cut off after a few moves
+static Move PickMove(MoveList *list, int *scores, int index)
+{
+    int best = index;
+    for(int i = index+1; i < list->count; i++)
+    {
+        if(scores[i] > scores[best]) best = i;
+    }
+
+    Move move = list->moves[best];
+    list->moves[best] = list->moves[index];
+    list->moves[index] = move;
+
+    int score = scores[best];
+    scores[best] = scores[index];
+    scores[index] = score;
+    return move;
+}
+
+static bool ShouldStop(SearchThread *thread)
+{
+    Engine *engine = thread->engine;
+    if(atomic_load_explicit(&engine->stop, memory_order_relaxed)) return true;
+    if((thread->nodes % TIME_CHECK_INTERVAL) != 0) return false;
+
+    uint64_t total = atomic_fetch_add_explicit(&engine->nodes, TIME_CHECK_INTERVAL, memory_order_relaxed) + TIME_CHECK_INTERVAL;
+    if(engine->maxNodes != 0 && total >= engine->maxNodes) atomic_store(&engine->stop, true);
+    if(engine->deadline != 0 && GetMonotonicTime() >= engine->deadline) atomic_store(&engine->stop, true);
+    return atomic_load_explicit(&engine->stop, memory_order_relaxed);
+}
+
+static bool IsRepetitionInSearch(SearchThread *thread, Board *board, int ply)
+{
+    // the hash includes the colour to move, so any ply can be compared
+    int limit = (board->fiftyMoveClock < ply) ? board->fiftyMoveClock : ply;
+    for(int i = 2; i <= limit; i++)
+    {
+        if(thread->pathHashes[ply - i] == board->hash) return true;
+    }
+    return false;
+}
+
+// scores a position where the colour to move has no legal moves
+static int ScoreNoMoves(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta, bool inCheck);
+static int EliminateStuckOpponent(SearchThread *thread, Board *board, uint8_t colour, int depth, int ply, int alpha, int beta);
+static int SearchNode(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta);
+static int Quiescence(SearchThread *thread, Board *board, int ply, int qply, int alpha, int beta);
+
+// with SEARCH_STATS SearchNode and Quiescence trace the node around the real
+// search, which is the Untraced version. without it they are the same function
+#ifdef SEARCH_STATS
+static int SearchNodeUntraced(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta);
+static int QuiescenceUntraced(SearchThread *thread, Board *board, int ply, int qply, int alpha, int beta);
+
+static int SearchNode(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta)
+{
+    // a node without depth left is traced as a quiescence node
+    if(depth <= 0 || !IsTraced(thread, ply)) return SearchNodeUntraced(thread, board, depth, ply, alpha, beta);
+    TraceEnter(thread, ply);
+    int score = SearchNodeUntraced(thread, board, depth, ply, alpha, beta);
+    TraceExit(thread, board, depth, ply, alpha, beta, score);
+    return score;
+}
+
+static int Quiescence(SearchThread *thread, Board *board, int ply, int qply, int alpha, int beta)
+{
+    if(!IsTraced(thread, ply)) return QuiescenceUntraced(thread, board, ply, qply, alpha, beta);
+    TraceEnter(thread, ply);
+    thread->traceFlags[ply] |= TRACE_QUIESCENCE;
+    int score = QuiescenceUntraced(thread, board, ply, qply, alpha, beta);
+    TraceExit(thread, board, -qply, ply, alpha, beta, score);
+    return score;
+}
+#else
+#define SearchNodeUntraced SearchNode
+#define QuiescenceUntraced Quiescence
+#endif
+
+static int QuiescenceUntraced(SearchThread *thread, Board *board, int ply, int qply, int alpha, int beta)
+{
+    thread->nodes++;
+    STATS(thread->stats.quiescenceNodes++);
+    STATS(if(board->eliminatedColour != NONE) thread->stats.twoPlayerNodes++);
+    thread->pvLength[ply] = 0;
+    if(ShouldStop(thread)) return 0;
+
+    bool maximizing = board->colourToMove == thread->rootColour;
+    int standPat = EvaluateForRoot(thread, board, ply);
+    if(qply >= MAX_QUIESCENCE_PLY || ply >= MAX_PLY-1) return standPat;
+
+    if(maximizing)
+    {
+        if(standPat >= beta) return standPat;
+        if(standPat > alpha) alpha = standPat;
+    }
+    else
+    {
+        if(standPat <= alpha) return standPat;
+        if(standPat < beta) beta = standPat;
+    }
+
+    MoveList *list = &thread->moveLists[ply];
+    STATS(uint64_t ticks = StatsTicks());
+    uint8_t stuck = GenerateNodeMoves(thread, board, list);
+    STATS(thread->stats.movegenTicks += StatsTicks() - ticks);
+    if(stuck != NONE) return EliminateStuckOpponent(thread, board, stuck, 0, ply, alpha, beta);
+    if(list->count == 0)
+    {
+        STATS(thread->traceFlags[ply] |= TRACE_NO_MOVES);
+        return ScoreNoMoves(thread, board, 0, ply, alpha, beta, InCheck());
+    }
+
+    // only captures and queen promotions are searched, the rest is dropped here
+    int count = 0;
+    for(int i = 0; i < list->count; i++)
+    {
+        Move move = list->moves[i];
+        if(IsCapture(board, move) || move.flag == PROMOTETOQUEEN) list->moves[count++] = move;
+    }
+    list->count = count;
+
+    int *scores = thread->moveScores[ply];
+    if(list->count > MAX_MOVES) list->count = MAX_MOVES;
+    ScoreMoves(thread, board, list, scores, nullMove, MAX_PLY);
+
+    int best = standPat;
+    for(int i = 0; i < list->count; i++)
+    {
+        Move move = PickMove(list, scores, i);
+        STATS(thread->traceMoves[ply+1] = move);
+        Board child = *board;
+        PlayNodeMove(thread, &child, move);
+        if(thread->limits.network != NULL) UpdateAccumulator(thread->limits.network, &thread->accumulators[ply], &thread->accumulators[ply+1], &child);
+        int score = Quiescence(thread, &child, ply+1, qply+1, alpha, beta);
+        if(atomic_load_explicit(&thread->engine->stop, memory_order_relaxed)) return 0;
+
+        if(maximizing)
+        {
+            if(score > best) best = score;
+            if(best > alpha) alpha = best;
+        }
+        else
+        {
+            if(score < best) best = score;
+            if(best < beta) beta = best;
+        }
+        if(alpha >= beta)
+        {
+            STATS(thread->traceFlags[ply] |= TRACE_CUTOFF);
+            break;
+        }
+    }
+    return best;
+}
+
+// in a best-reply layer an opponent without moves would otherwise hide
+// behind the moves of the other one, it is eliminated like on its own turn
+static int EliminateStuckOpponent(SearchThread *thread, Board *board, uint8_t colour, int depth, int ply, int alpha, int beta)
+{
+    STATS(thread->stats.eliminations++);
+    Board child = *board;
+    EliminateColour(&child, colour);
+    if(child.colourToMove == colour) NextMove(&child);
+    if(depth <= 0) return Quiescence(thread, &child, ply, MAX_QUIESCENCE_PLY-1, alpha, beta);
+    return SearchNode(thread, &child, depth, ply, alpha, beta);
+}
+
+static int ScoreNoMoves(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta, bool inCheck)
+{
+    uint8_t colour = board->colourToMove;
+
+    // the first colour without moves is eliminated whether it is in check or not
+    if(board->eliminatedColour == NONE)
+    {
+        if(colour == thread->rootColour) return -MATE_SCORE + ply;
+
+        STATS(thread->stats.eliminations++);
+        Board child = *board;
+        EliminateColour(&child, colour);
+        NextMove(&child);
+        if(depth <= 0) return Quiescence(thread, &child, ply, MAX_QUIESCENCE_PLY-1, alpha, beta);
+        return SearchNode(thread, &child, depth, ply, alpha, beta);
+    }
+
+    // with one colour gone a checkmate ends the game and a stalemate draws it
+    if(!inCheck) return 0;
+    if(colour == thread->rootColour) return -MATE_SCORE + ply;
+    return MATE_SCORE - ply;
+}
+
+static void UpdatePv(SearchThread *thread, int ply, Move move)
+{
+    thread->pv[ply][0] = move;
+    int length = (ply+1 < MAX_PLY) ? thread->pvLength[ply+1] : 0;
+    for(int i = 0; i < length; i++) thread->pv[ply][i+1] = thread->pv[ply+1][i];
+    thread->pvLength[ply] = length + 1;
+}
+
+static bool IsExcluded(SearchThread *thread, Move move)
+{
+    for(int i = 0; i < thread->excludedCount; i++)
+    {
+        if(SameMove(thread->excluded[i], move)) return true;
+    }
+    return false;
+}
+
+static int SearchNodeUntraced(SearchThread *thread, Board *board, int depth, int ply, int alpha, int beta)
+{
+    if(depth <= 0) return Quiescence(thread, board, ply, 0, alpha, beta);
+
+    thread->nodes++;
+    STATS(thread->stats.nodes[ply]++);
+    STATS(if(board->eliminatedColour != NONE) thread->stats.twoPlayerNodes++);
+    thread->pvLength[ply] = 0;
+    if(ShouldStop(thread)) return 0;
+    if(ply >= MAX_PLY-1) return EvaluateForRoot(thread, board, ply);
+
+    thread->pathHashes[ply] = board->hash;
+    if(ply > 0)
+    {
+        if((board->fiftyMoveClock / 3) >= 50) return 0;
+        if(IsRepetitionInSearch(thread, board, ply)) return 0;
+    }
+
+    bool maximizing = board->colourToMove == thread->rootColour;
+    int originalAlpha = alpha;
+    int originalBeta  = beta;
+
+    uint64_t key = board->hash;
+    TTProbe probe = { 0 };
+    Move tableMove = nullMove;
+    STATS(thread->stats.tableProbes++);
+    if(ProbeTranspositionTable(thread->engine->table, key, thread->tableOwner, &probe))
+    {
+        STATS(thread->stats.tableHits++);
+        STATS(thread->traceFlags[ply] |= TRACE_TABLE_HIT);
+        tableMove = probe.move;
+        int score = ScoreFromTable(probe.score, ply);
+        if(ply > 0 && probe.depth >= depth)
+        {
+            bool cutoff = probe.bound == BOUND_EXACT
+                       || (probe.bound == BOUND_LOWER && score >= beta)
+                       || (probe.bound == BOUND_UPPER && score <= alpha);
+            STATS(if(cutoff) thread->stats.tableCutoffs++);
+            STATS(if(cutoff) thread->traceFlags[ply] |= TRACE_TABLE_SCORE);
+            if(cutoff) return score;
+        }
+    }
+
+    MoveList *list = &thread->moveLists[ply];
+    STATS(uint64_t ticks = StatsTicks());
+    uint8_t stuck = GenerateNodeMoves(thread, board, list);
+    STATS(thread->stats.movegenTicks += StatsTicks() - ticks);
+    if(stuck != NONE) return EliminateStuckOpponent(thread, board, stuck, depth, ply, alpha, beta);
+    bool inCheck = InCheck() && !IsBestReplyLayer(thread, board);
+    if(list->count == 0)
+    {
+        STATS(thread->traceFlags[ply] |= TRACE_NO_MOVES);
+        return ScoreNoMoves(thread, board, depth, ply, alpha, beta, InCheck());
+    }
+    if(list->count > MAX_MOVES) list->count = MAX_MOVES;
+    STATS(thread->stats.expanded[ply]++);
+
+    int *scores = thread->moveScores[ply];
+    ScoreMoves(thread, board, list, scores, tableMove, ply);
+
+    int best = maximizing ? -INFINITE_SCORE : INFINITE_SCORE;
+    Move bestMove = nullMove;
+    // checks are extended by a ply, a king in check has few replies anyway
+    int childDepth = depth - 1 + (inCheck && ply < 2*depth);
+    STATS(int searched = 0);
+
+    for(int i = 0; i < list->count; i++)
+    {
+        Move move = PickMove(list, scores, i);
+        if(ply == 0 && IsExcluded(thread, move)) continue;
+        bool quiet = !IsCapture(board, move) && !IsPromotion(move);
+        STATS(thread->stats.children[ply]++);
+        STATS(searched++);
+        STATS(thread->traceMoves[ply+1] = move);
+
+        Board child = *board;
+        PlayNodeMove(thread, &child, move);
+        if(thread->limits.network != NULL) UpdateAccumulator(thread->limits.network, &thread->accumulators[ply], &thread->accumulators[ply+1], &child);
+        int score = SearchNode(thread, &child, childDepth, ply+1, alpha, beta);
+        if(atomic_load_explicit(&thread->engine->stop, memory_order_relaxed)) return 0;
+
+        bool improved = maximizing ? (score > best) : (score < best);
+        if(improved)
+        {
+            best = score;
+            bestMove = move;
+            if(maximizing && best > alpha)
+            {
+                alpha = best;
+                UpdatePv(thread, ply, move);
+            }
+            if(!maximizing && best < beta)
+            {
+                beta = best;
+                UpdatePv(thread, ply, move);
+            }
+        }
+
+        if(alpha >= beta)
+        {
+            STATS(thread->stats.cutoffs[ply]++);
+            STATS(if(searched == 1) thread->stats.firstCutoffs[ply]++);
+            STATS(thread->traceFlags[ply] |= TRACE_CUTOFF);
+            if(quiet)
+            {
+                if(!SameMove(thread->killers[ply][0], move))
+                {
+                    thread->killers[ply][1] = thread->killers[ply][0];
+                    thread->killers[ply][0] = move;
+                }
+                thread->history[move.start][move.target] += depth * depth;
+                if(thread->history[move.start][move.target] > (1 << 20))
+                {
+                    for(int a = 0; a < 144; a++) for(int b = 0; b < 144; b++) thread->history[a][b] /= 2;
+                }
+            }
+            break;
+        }
+    }
+
+    // the best of the moves that were left isn't the best of the position
+    if(ply == 0 && thread->excludedCount > 0) return best;
+
+    int bound = BOUND_EXACT;
+    if(best <= originalAlpha) bound = BOUND_UPPER;
+    else if(best >= originalBeta) bound = BOUND_LOWER;
+    StoreTranspositionTable(thread->engine->table, key, thread->tableOwner, ScoreToTable(best, ply), depth, bound, bestMove);
+
+    return best;
+}
+
+// with a clock budget the main thread decides after every iteration whether
+// another one is worth it: a best move that stays the same ends the search
+// early, a falling score buys more time to find something better. an
+// iteration that can't finish before the deadline isn't started, its result
+// would be thrown away
+static bool ShouldStartIteration(SearchThread *thread, int depth, int score, double iterationTime)
+{
+    Engine *engine = thread->engine;
+    Move best = thread->result.bestMove;
+    double now = GetMonotonicTime();
+
+    // the tree grows unevenly from one depth to the next, the largest growth so far is the safe guess
+    if(depth == 1) thread->iterationGrowth = 2.0;
+    else if(thread->previousIterationTime > 0.001 && iterationTime / thread->previousIterationTime > thread->iterationGrowth)
+    {
+        thread->iterationGrowth = iterationTime / thread->previousIterationTime;
+    }
+    thread->previousIterationTime = iterationTime;
+    if(now + iterationTime * thread->iterationGrowth > engine->deadline) return false;
+
+    if(depth > 1 && SameMove(best, thread->previousBest)) thread->stableIterations++;
+    else thread->stableIterations = 0;
+
+    int stable = (thread->stableIterations < 5) ? thread->stableIterations : 5;
+    double scale = 1.3 - 0.15 * stable;
+
+    int drop = thread->previousScore - score;
+    if(depth > 1 && drop > 25) scale *= (drop > 100) ? 2.0 : 1.0 + drop / 100.0;
+
+    thread->previousBest  = best;
+    thread->previousScore = score;
+    return now - engine->startTime < engine->optimumTime * scale;
+}
+
+// the evaluation of every colour at the end of the line
+static void EvaluateLine(SearchThread *thread, SearchLine *line)
+{
+    Board board = thread->root;
+    for(int i = 0; i < line->pvLength; i++)
+    {
+        // the search goes on past a colour that got checkmated on the way
+        if(board.eliminatedColour == NONE && !HasLegalMove(&board))
+        {
+            EliminateColour(&board, board.colourToMove);
+            NextMove(&board);
+        }
+        MakeSearchMove(&board, line->pv[i]);
+    }
+
+    if(thread->limits.network == NULL)
+    {
+        Evaluate(&board, line->scores);
+        return;
+    }
+    static _Thread_local Accumulator accumulator;
+    RefreshAccumulator(thread->limits.network, &accumulator, &board);
+    EvaluateNNUE(thread->limits.network, &accumulator, &board, line->scores);
+}
+
+// the next best root move after the ones in thread->excluded, false when
+// there are none left or the search was stopped
+static bool SearchLineAtRoot(SearchThread *thread, int depth, SearchLine *line)
+{
+    int score = SearchNode(thread, &thread->root, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+    if(atomic_load(&thread->engine->stop) || thread->pvLength[0] == 0) return false;
+
+    line->score    = score;
+    line->pvLength = thread->pvLength[0];
+    for(int i = 0; i < line->pvLength; i++) line->pv[i] = thread->pv[0][i];
+    return true;
+}
+
+// multi-pv searches the root again for every line with the moves of the
+// lines before it left out, all on the same table. only the main thread
+// does, the helpers keep filling the table for the first line. an
+// iteration that is stopped before all lines are done isn't used
+static void IterativeDeepening(void *arg)
+{
+    SearchThread *thread = arg;
+    Engine *engine = thread->engine;
+    STATS(uint64_t ticks = StatsTicks());
+    int lineCount = (thread->id == 0 && thread->limits.multiPV > 1) ? thread->limits.multiPV : 1;
+    if(lineCount > MAX_MULTIPV) lineCount = MAX_MULTIPV;
+
+    int maxDepth = thread->maxDepth;
+    for(int depth = 1; depth <= maxDepth; depth++)
+    {
+        // helpers search a ply deeper every other iteration so the threads
+        // spread out over the tree instead of all searching the same nodes
+        int searchDepth = depth;
+        if(thread->id > 0 && (thread->id & 1) && depth < maxDepth) searchDepth++;
+        double iterationStart = GetMonotonicTime();
+
+        SearchLine lines[MAX_MULTIPV];
+        int found = 0;
+        thread->excludedCount = 0;
+        while(found < lineCount && SearchLineAtRoot(thread, searchDepth, &lines[found]))
+        {
+            thread->excluded[thread->excludedCount++] = lines[found].pv[0];
+            found++;
+        }
+        thread->excludedCount = 0;
+        if(atomic_load(&engine->stop) || found == 0) break;
+
+        // a later line can come out better than an earlier one when the table
+        // had more to say about it, so they are sorted once all are in
+        for(int i = 1; i < found; i++)
+        {
+            SearchLine line = lines[i];
+            int j = i;
+            for(; j > 0 && lines[j-1].score < line.score; j--) lines[j] = lines[j-1];
+            lines[j] = line;
+        }
+
+        SearchResult *result = &thread->result;
+        int score = lines[0].score;
+        result->bestMove  = lines[0].pv[0];
+        result->score     = score;
+        result->depth     = searchDepth;
+        result->pvLength  = lines[0].pvLength;
+        for(int i = 0; i < result->pvLength; i++) result->pv[i] = lines[0].pv[i];
+        result->lineCount = found;
+        for(int i = 0; i < found; i++)
+        {
+            EvaluateLine(thread, &lines[i]);
+            result->lines[i] = lines[i];
+        }
+
+        if(thread->id == 0 && thread->limits.report != NULL)
+        {
+            result->nodes = atomic_load(&engine->nodes) + thread->nodes % TIME_CHECK_INTERVAL;
+            result->time  = GetMonotonicTime() - engine->startTime;
+            result->nps   = (result->time > 0) ? result->nodes / result->time : 0;
+            thread->limits.report(result, thread->limits.reportArg);
+        }
+
+        if(score >= MATE_SCORE - MAX_PLY || score <= -MATE_SCORE + MAX_PLY)
+        {
+            if(thread->id == 0) break;
+        }
+        if(thread->id == 0 && engine->optimumTime > 0 && !ShouldStartIteration(thread, depth, score, GetMonotonicTime() - iterationStart)) break;
+    }
+
+    if(thread->id == 0) atomic_store(&engine->stop, true);
+    FlushTranspositionStats(engine->table);
+    STATS(thread->stats.searchTicks += StatsTicks() - ticks);
+}
+
+Engine *CreateEngine(size_t hashMegabytes)
+{
+    Engine *engine = calloc(1, sizeof(Engine));
+    if(engine == NULL) return NULL;
+    engine->table = CreateTranspositionTable(hashMegabytes, true);
+    if(engine->table == NULL)
+    {
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+// an engine that searches on a table it doesn't own, any number of them can
+// share one. the table has to outlive them
+Engine *CreateSharingEngine(TranspositionTable *table)
+{
+    Engine *engine = calloc(1, sizeof(Engine));
+    if(engine == NULL) return NULL;
+    engine->table = table;
+    engine->sharedTable = true;
+    return engine;
+}
+
+void DestroyEngine(Engine *engine)
+{
+    if(!engine->sharedTable) DestroyTranspositionTable(engine->table);
+    free(engine);
+}
+
+// a shared table is left alone, the other engines still use it and the
+// generations make room for the new game
+void ClearEngine(Engine *engine)
+{
+    if(!engine->sharedTable) ClearTranspositionTable(engine->table);
+}
+
+void StopSearch(Engine *engine)
+{
+    atomic_store(&engine->stop, true);
+}
+
+// the moves a ponder search was started for were played, from here on it
+// is a normal search. the time spent pondering counts, so a search that
+// pondered for longer than its budget stops at once
+void PonderHit(Engine *engine)
+{
+    engine->optimumTime = engine->ponderOptimumTime;
+    engine->deadline    = engine->ponderDeadline;
+}
+
+// paranoid or best-reply, the names the tools take on the command line.
+// -1 for anything else
+int ParseSearchAlgorithm(const char *name)
+{
+    if(strcmp(name, "paranoid") == 0)   return SEARCH_PARANOID;
+    if(strcmp(name, "best-reply") == 0) return SEARCH_BEST_REPLY;
+    return -1;
+}
+
+SearchResult Search(Engine *engine, Board *board, SearchLimits limits)
+{
+    double start = GetMonotonicTime();
+    int threadCount = (limits.threads > 0) ? limits.threads : GetCoreCount();
+    int maxDepth = (limits.maxDepth > 0 && limits.maxDepth < MAX_PLY/2) ? limits.maxDepth : MAX_PLY/2;
+
+    atomic_store(&engine->stop, false);
+    atomic_store(&engine->nodes, 0);
+    engine->startTime = start;
+    NewTranspositionGeneration(engine->table);
+    double deadline = (limits.timeLimit > 0) ? start + limits.timeLimit : 0;
+    double optimumTime = 0;
+    engine->maxNodes = limits.maxNodes;
+    if(limits.useClock)
+    {
+        TimeBudget budget = AllocateTime(board, board->colourToMove);
+        double maximum = (limits.timeLimit > 0 && limits.timeLimit < budget.maximum) ? limits.timeLimit : budget.maximum;
+        deadline    = start + maximum;
+        optimumTime = (budget.optimum < maximum) ? budget.optimum : maximum;
+    }
+
+    // a ponder search has no limits until the predicted moves are played
+    engine->deadline    = limits.ponder ? 0 : deadline;
+    engine->optimumTime = limits.ponder ? 0 : optimumTime;
+    engine->ponderDeadline    = deadline;
+    engine->ponderOptimumTime = optimumTime;
+
+    // the fallback when the search is stopped before finishing depth 1
+    static _Thread_local MoveList rootMoves = { 0 };
+    GenerateMoves(board, &rootMoves);
+
+    SearchThread **threads = calloc(threadCount, sizeof(SearchThread *));
+    Thread **handles = calloc(threadCount, sizeof(Thread *));
+    for(int i = 0; i < threadCount; i++)
+    {
+        SearchThread *thread = calloc(1, sizeof(SearchThread));
+        thread->engine     = engine;
+        thread->root       = *board;
+        thread->root.mapHistory = (BoardMapHistory) { 0 };
+        thread->id         = i;
+        thread->rootColour = board->colourToMove;
+        thread->tableOwner = TableOwner(board->colourToMove, limits.algorithm);
+        thread->maxDepth   = maxDepth;
+        thread->limits     = limits;
+        if(limits.network != NULL) RefreshAccumulator(limits.network, &thread->accumulators[0], &thread->root);
+        thread->result.bestMove = (rootMoves.count > 0) ? rootMoves.moves[0] : nullMove;
+        threads[i] = thread;
+    }
+
+    for(int i = 1; i < threadCount; i++) handles[i] = StartThread(IterativeDeepening, threads[i]);
+    if(rootMoves.count > 0) IterativeDeepening(threads[0]);
+    atomic_store(&engine->stop, true);
+    for(int i = 1; i < threadCount; i++) if(handles[i] != NULL) JoinThread(handles[i]);
+
+    SearchResult result = threads[0]->result;
+    result.nodes = 0;
+    for(int i = 0; i < threadCount; i++)
+    {
+        result.nodes += threads[i]->nodes;
+        STATS(MergeSearchStats(&result.stats, &threads[i]->stats));
+        for(int ply = 0; ply < MAX_PLY; ply++) free(threads[i]->moveLists[ply].moves);
+        free(threads[i]);
+    }
+    free(threads);
+    free(handles);
+
+    result.time = GetMonotonicTime() - start;
+    result.nps  = (result.time > 0) ? result.nodes / result.time : 0;
+    return result;
+}
@@ -139,6 +139,42 @@ bool IsValidConnection(Socket *sock)
     return true;
 }
 
+// the port of this end of the connection, 0 if it has none yet
+int LocalPort(Socket *sock)
+{
+    struct sockaddr_in addr;
+    int size = sizeof(addr);
+    if(getsockname(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+// the port of the other end of the connection
+int PeerPort(Socket *sock)
+{
+    struct sockaddr_in addr;
+    int size = sizeof(addr);
+    if(getpeername(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+// the ipv4 address of this end of the connection, 0 if it has none yet
+uint32_t LocalAddress(Socket *sock)
+{
+    struct sockaddr_in addr;
+    int size = sizeof(addr);
+    if(getsockname(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohl(addr.sin_addr.s_addr);
+}
+
+// the ipv4 address of the other end of the connection
+uint32_t PeerAddress(Socket *sock)
+{
+    struct sockaddr_in addr;
+    int size = sizeof(addr);
+    if(getpeername(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohl(addr.sin_addr.s_addr);
+}
+
 int SocketFd(Socket *sock)
 {
     return (int)sock->fd;
@@ -323,6 +359,42 @@ bool IsValidConnection(Socket *sock)
     return true;
 }
 
+// the port of this end of the connection, 0 if it has none yet
+int LocalPort(Socket *sock)
+{
+    struct sockaddr_in addr;
+    socklen_t size = sizeof(addr);
+    if(getsockname(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+// the port of the other end of the connection
+int PeerPort(Socket *sock)
+{
+    struct sockaddr_in addr;
+    socklen_t size = sizeof(addr);
+    if(getpeername(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+// the ipv4 address of this end of the connection, 0 if it has none yet
+uint32_t LocalAddress(Socket *sock)
+{
+    struct sockaddr_in addr;
+    socklen_t size = sizeof(addr);
+    if(getsockname(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohl(addr.sin_addr.s_addr);
+}
+
+// the ipv4 address of the other end of the connection
+uint32_t PeerAddress(Socket *sock)
+{
+    struct sockaddr_in addr;
+    socklen_t size = sizeof(addr);
+    if(getpeername(sock->fd, (struct sockaddr *)&addr, &size) != 0) return 0;
+    return ntohl(addr.sin_addr.s_addr);
+}
+
 int Shutdown(Socket *sock)
 {
     return shutdown(sock->fd, SHUT_RDWR);
@@ -0,0 +1,308 @@
+#include "./common.h"
+#include <string.h>
+
+// endgame tablebases for the two player part of the game
+//
+// a table covers one material signature with the eliminated colour turned to
+// BLACK, its frozen pieces count towards the piece limit and can be captured.
+// pawns and castling are not supported and all moats have to be bridged,
+// which is how these endgames look in practice
+//
+// entries are one byte, indexed by side to move (WHITE or GRAY) followed by
+// the square of every piece in material order:
+//  0     position can't happen
+//  1     draw
+//  2+n   the side to move is mated in n plies, even n loses and odd n wins
+
+#define TB_MAGIC   "3MCTB"
+#define TB_VERSION 1
+#define TB_MAX_TABLES 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint8_t pieces[TB_MAX_PIECES];
+    uint64_t entries;
+    uint8_t reserved[4];
+} TBHeader;
+
+typedef struct {
+    TBMaterial material;
+    void *data;
+    size_t size;
+    const uint8_t *entries;
+} TBFile;
+
+struct Tablebases {
+    char directory[256];
+    TBFile files[TB_MAX_TABLES];
+    int fileCount;
+};
+
+static const char pieceLetters[8] = {
+    [KING]   = 'K',
+    [PAWN]   = 'P',
+    [PAWNCC] = 'P',
+    [KNIGHT] = 'N',
+    [BISHOP] = 'B',
+    [ROOK]   = 'R',
+    [QUEEN]  = 'Q',
+};
+
+static const char colourLetters[3] = { 'W', 'G', 'B' };
+
+static int ComparePieces(const void *a, const void *b)
+{
+    return (int)*(const uint8_t *)a - (int)*(const uint8_t *)b;
+}
+
+// turns board so the eliminated colour is BLACK and collects its material,
+// fails for positions no table can hold
+bool GetTablebaseMaterial(Board *board, TBMaterial *material, Board *canonical)
+{
+    if(board->eliminatedColour == NONE) return false;
+    for(int i = 0; i < 3; i++)
+    {
+        if(!board->bridgedMoats[i]) return false;
+        if(board->castleRights[i].kingSide || board->castleRights[i].queenSide) return false;
+    }
+
+    material->count = 0;
+    for(int square = 0; square < 144; square++)
+    {
+        uint8_t piece = board->map[square];
+        if(piece == NONE) continue;
+        if(GetPieceType(piece) == PAWN || GetPieceType(piece) == PAWNCC) return false;
+        if(material->count == TB_MAX_PIECES) return false;
+        material->pieces[material->count++] = piece;
+    }
+
+    int rotation = mod(2 - ((board->eliminatedColour >> 3) - 1), 3);
+    for(int i = 0; i < material->count; i++)
+    {
+        material->pieces[i] = GetPieceType(material->pieces[i]) | RotateColour(GetPieceColour(material->pieces[i]), rotation);
+    }
+    qsort(material->pieces, material->count, 1, ComparePieces);
+
+    if(canonical != NULL) RotateBoard(canonical, board, rotation);
+    return true;
+}
+
+// names look like WKR-GK-BK, the letters after the colour are its pieces
+void TablebaseName(TBMaterial *material, char *name, size_t size)
+{
+    size_t length = 0;
+    for(int colourIndex = 0; colourIndex < 3; colourIndex++)
+    {
+        if(length + 1 < size && colourIndex > 0) name[length++] = '-';
+        if(length + 1 < size) name[length++] = colourLetters[colourIndex];
+        for(int i = 0; i < material->count; i++)
+        {
+            uint8_t piece = material->pieces[i];
+            if((GetPieceColour(piece) >> 3) - 1 != colourIndex) continue;
+            if(length + 1 < size) name[length++] = pieceLetters[GetPieceType(piece)];
+        }
+    }
+    name[length] = '\0';
+}
+
+bool ParseTablebaseName(const char *name, TBMaterial *material)
+{
+    material->count = 0;
+    uint8_t colour = NONE;
+    for(const char *c = name; *c != '\0'; c++)
+    {
+        if(*c == '-') continue;
+
+        const char *colourLetter = memchr(colourLetters, *c, 3);
+        if(colourLetter != NULL && (colour == NONE || c[-1] == '-'))
+        {
+            colour = (colourLetter - colourLetters + 1) << 3;
+            continue;
+        }
+
+        uint8_t type = NONE;
+        for(int t = KING; t <= QUEEN; t++) if(t != PAWN && t != PAWNCC && pieceLetters[t] == *c) type = t;
+        if(type == NONE || colour == NONE || material->count == TB_MAX_PIECES) return false;
+        material->pieces[material->count++] = colour | type;
+    }
+    qsort(material->pieces, material->count, 1, ComparePieces);
+
+    // both colours still playing need their king
+    bool whiteKing = false, grayKing = false;
+    for(int i = 0; i < material->count; i++)
+    {
+        whiteKing = whiteKing || material->pieces[i] == (WHITE | KING);
+        grayKing  = grayKing  || material->pieces[i] == (GRAY  | KING);
+    }
+    return whiteKing && grayKing;
+}
+
+uint64_t TablebaseSize(TBMaterial *material)
+{
+    uint64_t size = 2;
+    for(int i = 0; i < material->count; i++) size *= 144;
+    return size;
+}
+
+// index of a board already turned by GetTablebaseMaterial, pieces of the same
+// kind are taken in piece list order
+uint64_t TablebaseIndex(TBMaterial *material, Board *board)
+{
+    uint64_t index = (board->colourToMove == GRAY) ? 1 : 0;
+    int used[32] = { 0 };
+    for(int i = 0; i < material->count; i++)
+    {
+        uint8_t piece = material->pieces[i];
+        PieceList *list = GetPieceList(board, piece);
+        index = index * 144 + list->pieces[used[piece]++];
+    }
+    return index;
+}
+
+// builds the position of an index, fails when two pieces share a square
+bool TablebaseBoard(TBMaterial *material, uint64_t index, Board *board)
+{
+    *board = (Board) { 0 };
+    int squares[TB_MAX_PIECES];
+    for(int i = material->count - 1; i >= 0; i--)
+    {
+        squares[i] = index % 144;
+        index /= 144;
+    }
+
+    // pieces are added in material order so TablebaseIndex finds them again
+    for(int i = 0; i < material->count; i++)
+    {
+        if(board->map[squares[i]] != NONE) return false;
+        board->map[squares[i]] = material->pieces[i];
+        AddPiece(GetPieceList(board, material->pieces[i]), squares[i]);
+    }
+
+    board->colourToMove     = (index == 1) ? GRAY : WHITE;
+    board->eliminatedColour = BLACK;
+    for(int i = 0; i < 3; i++)
+    {
+        board->bridgedMoats[i] = true;
+        board->enPassantSquares[i] = -1;
+    }
+    board->hash = HashBoard(board);
+    RefreshPieceScores(board);
+    return true;
+}
+
+Tablebases *OpenTablebases(const char *directory)
+{
+    Tablebases *tablebases = calloc(1, sizeof(Tablebases));
+    strncpy(tablebases->directory, directory, sizeof(tablebases->directory)-1);
+    return tablebases;
+}
+
+void CloseTablebases(Tablebases *tablebases)
+{
+    for(int i = 0; i < tablebases->fileCount; i++)
+    {
+        if(tablebases->files[i].data != NULL) UnmapFile(tablebases->files[i].data, tablebases->files[i].size);
+    }
+    free(tablebases);
+}
+
+// maps the table of material, a missing file is remembered so it isn't
+// looked for again on every probe
+static TBFile *LoadTablebase(Tablebases *tablebases, TBMaterial *material)
+{
+    for(int i = 0; i < tablebases->fileCount; i++)
+    {
+        TBFile *file = &tablebases->files[i];
+        if(file->material.count == material->count && memcmp(file->material.pieces, material->pieces, material->count) == 0) return file;
+    }
+    if(tablebases->fileCount == TB_MAX_TABLES) return NULL;
+
+    TBFile *file = &tablebases->files[tablebases->fileCount++];
+    *file = (TBFile) { .material = *material };
+
+    char name[64];
+    char path[512];
+    TablebaseName(material, name, sizeof(name));
+    snprintf(path, sizeof(path), "%s/%s.tb", tablebases->directory, name);
+
+    file->data = MapFile(path, &file->size);
+    if(file->data == NULL) return file;
+
+    const TBHeader *header = file->data;
+    bool valid = file->size >= sizeof(TBHeader)
+              && memcmp(header->magic, TB_MAGIC, sizeof(TB_MAGIC)) == 0
+              && header->version == TB_VERSION
+              && header->count == (uint32_t)material->count
+              && memcmp(header->pieces, material->pieces, material->count) == 0
+              && header->entries == TablebaseSize(material)
+              && file->size >= sizeof(TBHeader) + header->entries;
+    if(!valid)
+    {
+        UnmapFile(file->data, file->size);
+        file->data = NULL;
+        return file;
+    }
+    file->entries = (const uint8_t *)file->data + sizeof(TBHeader);
+    return file;
+}
+
+bool PreloadTablebase(Tablebases *tablebases, TBMaterial *material)
+{
+    TBFile *file = LoadTablebase(tablebases, material);
+    return file != NULL && file->entries != NULL;
+}
+
+bool DecodeTablebaseEntry(uint8_t entry, TBResult *result)
+{
+    if(entry == 0) return false;
+    if(entry == 1)
+    {
+        *result = (TBResult) { .wdl = 0, .dtm = 0 };
+        return true;
+    }
+    int dtm = entry - 2;
+    *result = (TBResult) { .wdl = (dtm & 1) ? 1 : -1, .dtm = dtm };
+    return true;
+}
+
+// the fifty-move clock of a two player board after plies more moves without a
+// capture or a pawn move. the turn of the eliminated colour is skipped after
+// every move of the colour before it, and the skip counts too. dtm ignores the
+// rule, a win is only a win if the clock is still under 150 at the mate
+int FiftyMoveClockAfter(Board *board, int plies)
+{
+    bool skipsFirst = NextColourToPlay(board) == board->eliminatedColour;
+    int skips = skipsFirst ? (plies + 1) / 2 : plies / 2;
+    return board->fiftyMoveClock + plies + skips;
+}
+
+// wdl is from the point of view of the colour to move, dtm counts plies to mate
+bool ProbeTablebases(Tablebases *tablebases, Board *board, TBResult *result)
+{
+    TBMaterial material;
+    Board canonical;
+    if(!GetTablebaseMaterial(board, &material, &canonical)) return false;
+
+    TBFile *file = LoadTablebase(tablebases, &material);
+    if(file == NULL || file->entries == NULL) return false;
+    return DecodeTablebaseEntry(file->entries[TablebaseIndex(&material, &canonical)], result);
+}
+
+bool WriteTablebase(const char *path, TBMaterial *material, const uint8_t *entries)
+{
+    TBHeader header = { 0 };
+    memcpy(header.magic, TB_MAGIC, sizeof(TB_MAGIC));
+    header.version = TB_VERSION;
+    header.count   = material->count;
+    header.entries = TablebaseSize(material);
+    memcpy(header.pieces, material->pieces, material->count);
+
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(entries, 1, header.entries, file) == header.entries;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,49 @@
+#include "./common.h"
+
+// time management for a colour playing on the clock
+//
+// the budget spreads the remaining time over the moves that are probably
+// still to come, fewer as material comes off, and spends most of the
+// increment on top. the optimum is where iterative deepening normally stops,
+// a search whose best move keeps changing or whose score drops may run past
+// it but never past the maximum, which keeps enough on the clock to not flag
+
+#define MOVE_OVERHEAD       0.05 // seconds lost per move to the network and the frame loop
+#define MIN_MOVES_TO_GO     15
+#define OPENING_MOVES_TO_GO 40
+#define INCREMENT_SHARE     0.75
+#define MAX_CLOCK_SHARE     0.3  // no single move gets more of the clock than this
+#define MAX_OPTIMUM_RATIO   4.0
+
+// 1 with all pieces on the board, going to 0 as the pieces are traded off
+static double GamePhase(Board *board)
+{
+    static const int startMaterial = 3 * (2*300 + 2*325 + 2*500 + 900);
+    static const uint8_t types[] = { KNIGHT, BISHOP, ROOK, QUEEN };
+
+    int material = 0;
+    for(int colour = WHITE; colour <= BLACK; colour += 8)
+    {
+        if(colour == board->eliminatedColour) continue;
+        for(int i = 0; i < 4; i++) material += GetPieceList(board, colour | types[i])->count * materialValues[types[i]];
+    }
+
+    double phase = (double)material / startMaterial;
+    return (phase > 1.0) ? 1.0 : phase;
+}
+
+TimeBudget AllocateTime(Board *board, uint8_t colour)
+{
+    int index = (colour >> 3) - 1;
+    double remaining = board->clock.seconds[index] - MOVE_OVERHEAD;
+    if(remaining < 0.01) remaining = 0.01;
+
+    double movesToGo = MIN_MOVES_TO_GO + (OPENING_MOVES_TO_GO - MIN_MOVES_TO_GO) * GamePhase(board);
+    double optimum = remaining / movesToGo + INCREMENT_SHARE * board->clock.increment;
+
+    double maximum = remaining * MAX_CLOCK_SHARE;
+    if(maximum > optimum * MAX_OPTIMUM_RATIO) maximum = optimum * MAX_OPTIMUM_RATIO;
+    if(optimum > maximum) optimum = maximum;
+
+    return (TimeBudget) { .optimum = optimum, .maximum = maximum };
+}
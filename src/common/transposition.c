@@ -0,0 +1,271 @@
+#include "./common.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// an entry is two words, the key is stored xor'd with the data so a torn
+// write from another thread is seen as a miss and the table needs no locks.
+// that makes it safe to share one table between every engine of a process,
+// the server does that for its bots so positions that come up again, like
+// the openings, are found from whichever game searched them first.
+//
+// entries go under the plain board hash. the scores of a search are from the
+// point of view of its root colour, so an entry carries an owner, the root
+// colour and algorithm of the search that stored it, and only the owner gets
+// the score back. anyone else still gets the move to try first, that is what
+// lets a bot use what the bot of another colour found in the same position
+//
+// data layout:
+//  bits  0-19 score (signed)
+//  bits 20-26 depth
+//  bits 27-28 bound
+//  bits 29-36 move start
+//  bits 37-44 move target
+//  bits 45-48 move flag
+//  bits 49-56 generation
+//  bits 57-59 owner
+typedef struct {
+    uint64_t key;
+    uint64_t data;
+} TTEntry;
+
+// a bucket fills a cache line, a probe looks at all of it
+#define BUCKET_SIZE 4
+
+typedef struct {
+    TTEntry entries[BUCKET_SIZE];
+} TTBucket;
+
+// next to the buckets is a cache of the hand written evaluation, one entry a
+// slot. Evaluate scores every colour at once and doesn't care whose search
+// asks, so any search of the table can use any other's evaluations. the
+// three scores take 21 bits each and are checked the same way as the entries
+#define EVAL_SCORE_BITS 21
+#define EVAL_SCORE_MASK ((1ULL << EVAL_SCORE_BITS) - 1)
+
+struct TranspositionTable {
+    TTBucket *buckets;
+    TTEntry *evals;
+    uint64_t mask;
+    size_t size; // bytes
+    // every search starts a new generation, entries of old ones are replaced first
+    atomic_uint generation;
+
+    atomic_uint_fast64_t probes;
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t sharedHits;
+    atomic_uint_fast64_t collisions;
+    atomic_uint_fast64_t stores;
+    atomic_uint_fast64_t replacements;
+    atomic_uint_fast64_t evalProbes;
+    atomic_uint_fast64_t evalHits;
+};
+
+// counted per thread and added to the table by FlushTranspositionStats, so
+// threads sharing a table don't fight over the counters on every probe
+static _Thread_local TTStats threadStats;
+
+static inline uint64_t PackEntry(int score, int depth, int bound, Move move, uint8_t generation, uint8_t owner)
+{
+    uint64_t data = 0;
+    data |= (uint64_t)(score & 0xFFFFF);
+    data |= (uint64_t)(depth & 0x7F)  << 20;
+    data |= (uint64_t)(bound & 0x3)   << 27;
+    data |= (uint64_t)move.start      << 29;
+    data |= (uint64_t)move.target     << 37;
+    data |= (uint64_t)(move.flag & 0xF) << 45;
+    data |= (uint64_t)generation      << 49;
+    data |= (uint64_t)(owner & 0x7)   << 57;
+    return data;
+}
+
+static inline TTProbe UnpackEntry(uint64_t data)
+{
+    TTProbe probe = { 0 };
+    probe.score = (int)(data & 0xFFFFF);
+    if(probe.score & 0x80000) probe.score -= 0x100000;
+    probe.depth = (data >> 20) & 0x7F;
+    probe.bound = (data >> 27) & 0x3;
+    probe.move.start  = (data >> 29) & 0xFF;
+    probe.move.target = (data >> 37) & 0xFF;
+    probe.move.flag   = (data >> 45) & 0xF;
+    return probe;
+}
+
+static inline uint8_t EntryGeneration(uint64_t data) { return (data >> 49) & 0xFF; }
+static inline uint8_t EntryOwner(uint64_t data)      { return (data >> 57) & 0x7; }
+static inline bool IsEmptyEntry(TTEntry entry)     { return entry.key == 0 && entry.data == 0; }
+
+// the size is rounded down to a power of two buckets, each with its evaluation slot
+TranspositionTable *CreateTranspositionTable(size_t megabytes, bool hugePages)
+{
+    size_t slotSize = sizeof(TTBucket) + sizeof(TTEntry);
+    size_t count = 1;
+    while(count * 2 * slotSize <= megabytes * 1024 * 1024) count *= 2;
+
+    TranspositionTable *table = calloc(1, sizeof(TranspositionTable));
+    if(table == NULL) return NULL;
+    table->size = count * slotSize;
+    table->buckets = AllocateLargeMemory(table->size, hugePages);
+    if(table->buckets == NULL)
+    {
+        free(table);
+        return NULL;
+    }
+    table->evals = (TTEntry *)(table->buckets + count);
+    table->mask = count - 1;
+    return table;
+}
+
+void DestroyTranspositionTable(TranspositionTable *table)
+{
+    FreeLargeMemory(table->buckets, table->size);
+    free(table);
+}
+
+void ClearTranspositionTable(TranspositionTable *table)
+{
+    memset(table->buckets, 0, table->size);
+}
+
+void NewTranspositionGeneration(TranspositionTable *table)
+{
+    atomic_fetch_add_explicit(&table->generation, 1, memory_order_relaxed);
+}
+
+// an entry of another owner comes back with only its move, as depth 0 and BOUND_NONE
+bool ProbeTranspositionTable(TranspositionTable *table, uint64_t key, uint8_t owner, TTProbe *probe)
+{
+    TTBucket *bucket = &table->buckets[key & table->mask];
+    threadStats.probes++;
+
+    int occupied = 0;
+    Move sharedMove = nullMove;
+    for(int i = 0; i < BUCKET_SIZE; i++)
+    {
+        TTEntry entry = bucket->entries[i];
+        if((entry.key ^ entry.data) == key)
+        {
+            TTProbe found = UnpackEntry(entry.data);
+            if(EntryOwner(entry.data) == owner)
+            {
+                threadStats.hits++;
+                *probe = found;
+                return true;
+            }
+            if(!IsNullMove(found.move)) sharedMove = found.move;
+        }
+        occupied += !IsEmptyEntry(entry);
+    }
+    if(!IsNullMove(sharedMove))
+    {
+        threadStats.sharedHits++;
+        *probe = (TTProbe) { .bound = BOUND_NONE, .move = sharedMove };
+        return true;
+    }
+    if(occupied == BUCKET_SIZE) threadStats.collisions++;
+    return false;
+}
+
+void StoreTranspositionTable(TranspositionTable *table, uint64_t key, uint8_t owner, int score, int depth, int bound, Move move)
+{
+    TTBucket *bucket = &table->buckets[key & table->mask];
+    uint8_t generation = atomic_load_explicit(&table->generation, memory_order_relaxed);
+
+    // the same position and owner if it is there, otherwise an empty slot,
+    // otherwise the shallowest result with every generation of age counting as 8 plies
+    TTEntry *slot = NULL;
+    int slotValue = 0;
+    bool replaces = false;
+    for(int i = 0; i < BUCKET_SIZE; i++)
+    {
+        TTEntry *entry = &bucket->entries[i];
+        TTEntry old = *entry;
+        if((old.key ^ old.data) == key && EntryOwner(old.data) == owner)
+        {
+            // keep the deeper result for the same position, and keep its move when the new one has none
+            TTProbe previous = UnpackEntry(old.data);
+            if(previous.depth > depth && bound != BOUND_EXACT) return;
+            if(IsNullMove(move)) move = previous.move;
+            slot = entry;
+            replaces = false;
+            break;
+        }
+
+        int age = (uint8_t)(generation - EntryGeneration(old.data));
+        int value = IsEmptyEntry(old) ? -1024 : UnpackEntry(old.data).depth - 8 * age;
+        if(slot == NULL || value < slotValue)
+        {
+            slot = entry;
+            slotValue = value;
+            replaces = !IsEmptyEntry(old) && age == 0;
+        }
+    }
+
+    threadStats.stores++;
+    if(replaces) threadStats.replacements++;
+    uint64_t data = PackEntry(score, depth, bound, move, generation, owner);
+    slot->key  = key ^ data;
+    slot->data = data;
+}
+
+bool ProbeEvalCache(TranspositionTable *table, uint64_t key, int scores[3])
+{
+    TTEntry entry = table->evals[key & table->mask];
+    threadStats.evalProbes++;
+    if((entry.key ^ entry.data) != key || IsEmptyEntry(entry)) return false;
+
+    threadStats.evalHits++;
+    for(int i = 0; i < 3; i++)
+    {
+        int score = (int)((entry.data >> (i * EVAL_SCORE_BITS)) & EVAL_SCORE_MASK);
+        if(score & (1 << (EVAL_SCORE_BITS-1))) score -= 1 << EVAL_SCORE_BITS;
+        scores[i] = score;
+    }
+    return true;
+}
+
+void StoreEvalCache(TranspositionTable *table, uint64_t key, const int scores[3])
+{
+    uint64_t data = 0;
+    for(int i = 0; i < 3; i++) data |= ((uint64_t)scores[i] & EVAL_SCORE_MASK) << (i * EVAL_SCORE_BITS);
+    TTEntry *slot = &table->evals[key & table->mask];
+    slot->key  = key ^ data;
+    slot->data = data;
+}
+
+// adds what this thread counted since the last flush to the table
+void FlushTranspositionStats(TranspositionTable *table)
+{
+    atomic_fetch_add_explicit(&table->probes,       threadStats.probes,       memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->hits,         threadStats.hits,         memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->sharedHits,   threadStats.sharedHits,   memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->collisions,   threadStats.collisions,   memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->stores,       threadStats.stores,       memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->replacements, threadStats.replacements, memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->evalProbes,   threadStats.evalProbes,   memory_order_relaxed);
+    atomic_fetch_add_explicit(&table->evalHits,     threadStats.evalHits,     memory_order_relaxed);
+    threadStats = (TTStats) { 0 };
+}
+
+void GetTranspositionStats(TranspositionTable *table, TTStats *stats)
+{
+    *stats = (TTStats) {
+        .probes       = atomic_load(&table->probes),
+        .hits         = atomic_load(&table->hits),
+        .sharedHits   = atomic_load(&table->sharedHits),
+        .collisions   = atomic_load(&table->collisions),
+        .stores       = atomic_load(&table->stores),
+        .replacements = atomic_load(&table->replacements),
+        .evalProbes   = atomic_load(&table->evalProbes),
+        .evalHits     = atomic_load(&table->evalHits),
+        .megabytes    = table->size / (1024 * 1024),
+    };
+
+    uint64_t sample = (table->mask + 1 < 1024) ? table->mask + 1 : 1024;
+    uint64_t used = 0;
+    for(uint64_t i = 0; i < sample; i++)
+    {
+        for(int j = 0; j < BUCKET_SIZE; j++) used += !IsEmptyEntry(table->buckets[i].entries[j]);
+    }
+    stats->usage = (double)used / (sample * BUCKET_SIZE);
+}
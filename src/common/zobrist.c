@@ -0,0 +1,121 @@
+#include "./common.h"
+
+uint64_t zobristPieces[144][32];
+uint64_t zobristColourToMove[4];
+uint64_t zobristEliminated[4];
+uint64_t zobristCastleRights[3][2];
+uint64_t zobristEnPassant[144];
+uint64_t zobristBridgedMoats[3];
+
+bool zobristGenerated = false;
+
+// splitmix64 with a fixed seed, the keys have to be the same on every run
+// because hashes end up in files (perft logs, books, tablebases)
+static uint64_t NextRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void InitZobrist()
+{
+    uint64_t state = 0x3A4E5C4E55ULL;
+
+    for(int square = 0; square < 144; square++)
+    {
+        // an empty square never changes the hash, which lets MakeMove xor blindly
+        zobristPieces[square][NONE] = 0;
+        for(int piece = 1; piece < 32; piece++) zobristPieces[square][piece] = NextRandom(&state);
+        zobristEnPassant[square] = NextRandom(&state);
+    }
+
+    for(int i = 0; i < 4; i++)
+    {
+        zobristColourToMove[i] = NextRandom(&state);
+        zobristEliminated[i]   = (i == 0) ? 0 : NextRandom(&state);
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        zobristCastleRights[i][0] = NextRandom(&state);
+        zobristCastleRights[i][1] = NextRandom(&state);
+        zobristBridgedMoats[i]    = NextRandom(&state);
+    }
+
+    zobristGenerated = true;
+}
+
+// everything MakeMove may change besides the pieces and the colour to move
+uint64_t HashBoardState(Board *board)
+{
+    uint64_t hash = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        if(board->castleRights[i].kingSide)  hash ^= zobristCastleRights[i][0];
+        if(board->castleRights[i].queenSide) hash ^= zobristCastleRights[i][1];
+        if(board->bridgedMoats[i])           hash ^= zobristBridgedMoats[i];
+
+        uint8_t enPassantSquare = board->enPassantSquares[i];
+        if(enPassantSquare < 144) hash ^= zobristEnPassant[enPassantSquare];
+    }
+    return hash;
+}
+
+uint64_t HashBoard(Board *board)
+{
+    if(!zobristGenerated) InitZobrist();
+
+    uint64_t hash = HashBoardState(board);
+    for(int square = 0; square < 144; square++)
+    {
+        hash ^= zobristPieces[square][board->map[square]];
+    }
+    hash ^= zobristColourToMove[board->colourToMove >> 3];
+    hash ^= zobristEliminated[board->eliminatedColour >> 3];
+    return hash;
+}
+
+// the hash RotateBoard(board, rotation) would end up with, without building the board
+uint64_t HashRotatedBoard(Board *board, int rotation)
+{
+    if(!zobristGenerated) InitZobrist();
+    rotation = mod(rotation, 3);
+
+    uint64_t hash = 0;
+    for(int square = 0; square < 144; square++)
+    {
+        uint8_t piece = board->map[square];
+        if(piece == NONE) continue;
+        uint8_t rotatedPiece = GetPieceType(piece) | RotateColour(GetPieceColour(piece), rotation);
+        hash ^= zobristPieces[RotateSquare(square, rotation)][rotatedPiece];
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        int index = (i + rotation) % 3;
+        if(board->castleRights[i].kingSide)  hash ^= zobristCastleRights[index][0];
+        if(board->castleRights[i].queenSide) hash ^= zobristCastleRights[index][1];
+        if(board->bridgedMoats[i])           hash ^= zobristBridgedMoats[index];
+
+        uint8_t enPassantSquare = board->enPassantSquares[i];
+        if(enPassantSquare < 144) hash ^= zobristEnPassant[RotateSquare(enPassantSquare, rotation)];
+    }
+
+    hash ^= zobristColourToMove[RotateColour(board->colourToMove, rotation) >> 3];
+    hash ^= zobristEliminated[RotateColour(board->eliminatedColour, rotation) >> 3];
+    return hash;
+}
+
+// one key for all three rotations of a position
+uint64_t CanonicalHash(Board *board)
+{
+    uint64_t hash = board->hash;
+    for(int i = 1; i < 3; i++)
+    {
+        uint64_t rotated = HashRotatedBoard(board, i);
+        if(rotated < hash) hash = rotated;
+    }
+    return hash;
+}
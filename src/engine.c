@@ -0,0 +1,645 @@
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_BENCH_DEPTH 4
+#define DEFAULT_HASH_MB     64
+#define DEFAULT_MULTIPV     4
+#define DEFAULT_SEE_SECONDS 3
+#define DEFAULT_TRACE_PLIES 3
+#define ENGINE_NAME         "3_man_chess_engine"
+
+// positions for bench, given as the moves from the start position so they
+// stay valid whatever the fen format becomes. changing this list changes the
+// signature
+static const char *benchPositions[] = {
+    "",
+    "Wc4 Gg4 Bf4 Wc5 NGc3 Bd3 QBa6 Gd4 NBc3 Wd3 BBh4+ KBd2",
+    "Wc4 Gg4 Bf4 Wc5 NGc3 Bd3 QBa6 Gd4 NBc3 Wd3 BBh4+ KBd2 NWf3 NGf3 Bb4 NWc3 BxBb4 KBe3 Wb4 BxBc3 RBb1 We4 BGg2 BBg5",
+    "Wc4 Gg4 Bf4 Wc5 NGc3 Bd3 QBa6 Gd4 NBc3 Wd3 BBh4+ KBd2 NWf3 NGf3 Bb4 NWc3 BxBb4 KBe3 Wb4 BxBc3 RBb1 We4 BGg2 BBg5 "
+        "QxBa2 Ga3 RBb6 QBd5 NGe5 RGd6 QBc5+ NGc4 KBf3 QxBc3 NxGd6 KBe3",
+    "Wf4 NGh3 Bd3 Wc3 Ge3 NBd2 QGg6 QGa4 Bc4 NWf3 NGc3 NBg1Bf3",
+    "Wf4 NGh3 Bd3 Wc3 Ge3 NBd2 QGg6 QGa4 Bc4 NWf3 NGc3 NBg1Bf3 We4 QxWe4+ QWh5 BWe2 QxWf4 QxGg6 Wg4 Gd3 QBb6+ Wh4 QxWg4 QWd6",
+    "Wf4 NGh3 Bd3 Wc3 Ge3 NBd2 QGg6 QGa4 Bc4 NWf3 NGc3 NBg1Bf3 We4 QxWe4+ QWh5 BWe2 QxWf4 QxGg6 Wg4 Gd3 QBb6+ Wh4 QxWg4 QWd6 "
+        "Wd4 Gb4 QWb6 NWf3Wd2 QWf5 Bd4 Wb3 NWa5 Ba4 Wb4 NBf6 Bg3",
+    "Wc3 Gc4 Bb3 QGh5 Gb3 Be3 We4 BGe3 BBd3 Wd4 NGc3 QGa6",
+    "Wc3 Gc4 Bb3 QGh5 Gb3 Be3 We4 BGe3 BBd3 Wd4 NGc3 QGa6 QGf5 QGc1 NBf3 BWe3 Gd3 NBc3 NWd2 Gb4 BWf6 NWg1Wf3 Gb5 QBg6",
+    "Wc3 Gc4 Bb3 QGh5 Gb3 Be3 We4 BGe3 BBd3 Wd4 NGc3 QGa6 QGf5 QGc1 NBf3 BWe3 Gd3 NBc3 NWd2 Gb4 BWf6 NWg1Wf3 Gb5 QBg6 "
+        "QWa5 NGf3 Bb4 Wg4 Ga4 QxWg4 QWb6 Ga5 BBf4 NWe5 Gd4 QWh4",
+};
+
+// plays the moves of a bench position, they are all from trusted input
+static bool SetupPosition(Board *board, const char *moves)
+{
+    InitBoard(board, DEFAULT_FEN);
+
+    char token[16];
+    int length = 0;
+    for(const char *c = moves; ; c++)
+    {
+        if(*c != ' ' && *c != '\0')
+        {
+            if(length < (int)sizeof(token) - 1) token[length++] = *c;
+            continue;
+        }
+        if(length > 0)
+        {
+            token[length] = '\0';
+            length = 0;
+
+            Move move;
+            if(!ParseMoveNotation(board, token, &move)) return false;
+            MakeMove(board, move);
+        }
+        if(*c == '\0') return true;
+    }
+}
+
+#ifdef SEARCH_STATS
+// the statistics of every search of the last RunBench
+static SearchStats benchStats;
+#endif
+
+static inline uint64_t MixSignature(uint64_t signature, uint64_t value)
+{
+    signature ^= value;
+    signature *= 0x100000001B3ULL;
+    return signature;
+}
+
+// the signatures of the two algorithms can't be compared with each other
+static int benchAlgorithm = SEARCH_PARANOID;
+
+// searches every bench position to depth with a fresh table, returns the
+// signature, which only means something with one thread
+static uint64_t RunBench(Engine *engine, int depth, int threads, int multiPV, uint64_t *totalNodes, double *totalTime)
+{
+    uint64_t signature = 0xCBF29CE484222325ULL;
+    *totalNodes = 0;
+    *totalTime  = 0;
+#ifdef SEARCH_STATS
+    benchStats = (SearchStats) { 0 };
+#endif
+
+    for(int i = 0; i < (int)NOB_ARRAY_LEN(benchPositions); i++)
+    {
+        Board board = { 0 };
+        if(!SetupPosition(&board, benchPositions[i]))
+        {
+            fprintf(stderr, "bench position %d does not replay\n", i + 1);
+            continue;
+        }
+
+        ClearEngine(engine);
+        SearchLimits limits = { .algorithm = benchAlgorithm, .maxDepth = depth, .threads = threads, .multiPV = multiPV };
+        SearchResult result = Search(engine, &board, limits);
+
+        printf("position %2d: %12llu nodes, score %6d, depth %d\n", i + 1, (unsigned long long)result.nodes, result.score, result.depth);
+        signature = MixSignature(signature, result.nodes);
+        signature = MixSignature(signature, ((uint64_t)result.bestMove.start << 16) | ((uint64_t)result.bestMove.target << 8) | result.bestMove.flag);
+        *totalNodes += result.nodes;
+        *totalTime  += result.time;
+#ifdef SEARCH_STATS
+        MergeSearchStats(&benchStats, &result.stats);
+#endif
+        free(board.mapHistory.items);
+    }
+    return signature;
+}
+
+static int Bench(int depth, int threads, size_t hashMegabytes)
+{
+    Engine *engine = CreateEngine(hashMegabytes);
+    if(engine == NULL)
+    {
+        fprintf(stderr, "could not allocate a %zuMB hash table\n", hashMegabytes);
+        return 1;
+    }
+
+    uint64_t nodes;
+    double time;
+    uint64_t signature = RunBench(engine, depth, 1, 1, &nodes, &time);
+    printf("===========================\n");
+    printf("1 thread, depth %d\n", depth);
+    printf("total nodes: %llu\n", (unsigned long long)nodes);
+    printf("signature:   %016llx\n", (unsigned long long)signature);
+    printf("nodes/sec:   %.0f\n", (time > 0) ? nodes / time : 0.0);
+#ifdef SEARCH_STATS
+    printf("===========================\n");
+    PrintSearchStats(stdout, &benchStats);
+#endif
+
+    int threadCount = (threads > 0) ? threads : GetCoreCount();
+    if(threadCount > 1)
+    {
+        RunBench(engine, depth, threadCount, 1, &nodes, &time);
+        printf("===========================\n");
+        printf("%d threads, depth %d\n", threadCount, depth);
+        printf("total nodes: %llu\n", (unsigned long long)nodes);
+        printf("nodes/sec:   %.0f\n", (time > 0) ? nodes / time : 0.0);
+    }
+
+    DestroyEngine(engine);
+    return 0;
+}
+
+#ifdef SEARCH_STATS
+// searches the bench positions to depth and writes the top plies of every
+// tree to path, see SearchTraceNode
+static int Trace(const char *path, int plies, int depth)
+{
+    if(!SetSearchTrace(path, plies))
+    {
+        fprintf(stderr, "could not write %s\n", path);
+        return 1;
+    }
+    Engine *engine = CreateEngine(DEFAULT_HASH_MB);
+    if(engine == NULL) return 1;
+
+    uint64_t nodes;
+    double time;
+    RunBench(engine, depth, 1, 1, &nodes, &time);
+    SetSearchTrace(NULL, 0);
+    DestroyEngine(engine);
+    printf("traced the first %d plies of %llu nodes to %s\n", plies, (unsigned long long)nodes, path);
+    return 0;
+}
+
+static int CompareTraceNodes(const void *a, const void *b)
+{
+    uint32_t x = ((const SearchTraceNode *)a)->id;
+    uint32_t y = ((const SearchTraceNode *)b)->id;
+    return (x > y) - (x < y);
+}
+
+// prints a trace as an indented tree, up to maxPly
+static int ShowTrace(const char *path, int maxPly)
+{
+    size_t size;
+    void *data = MapFile(path, &size);
+    SearchTraceHeader *header = data;
+    if(data == NULL || size < sizeof(SearchTraceHeader) || memcmp(header->magic, SEARCH_TRACE_MAGIC, 8) != 0 || header->version != SEARCH_TRACE_VERSION)
+    {
+        fprintf(stderr, "%s is not a search trace\n", path);
+        if(data != NULL) UnmapFile(data, size);
+        return 1;
+    }
+
+    size_t count = (size - sizeof(SearchTraceHeader)) / sizeof(SearchTraceNode);
+    SearchTraceNode *nodes = malloc(count * sizeof(SearchTraceNode));
+    memcpy(nodes, (uint8_t *)data + sizeof(SearchTraceHeader), count * sizeof(SearchTraceNode));
+    qsort(nodes, count, sizeof(SearchTraceNode), CompareTraceNodes);
+
+    printf("%zu nodes of the first %u plies\n", count, header->plies);
+    for(size_t i = 0; i < count; i++)
+    {
+        SearchTraceNode *node = &nodes[i];
+        if(node->ply > maxPly) continue;
+        printf("%*s", 2 * node->ply, "");
+        if(node->ply == 0) printf("root");
+        else printf("%d,%d,%d", node->move.start, node->move.target, node->move.flag);
+        printf(" depth %d [%d, %d] -> %d", node->depth, node->alpha, node->beta, node->score);
+        if(node->flags & TRACE_QUIESCENCE)  printf(" quiescence");
+        if(node->flags & TRACE_TABLE_HIT)   printf(" hit");
+        if(node->flags & TRACE_TABLE_SCORE) printf(" table");
+        if(node->flags & TRACE_CUTOFF)      printf(" cutoff");
+        if(node->flags & TRACE_NO_MOVES)    printf(" no moves");
+        printf("\n");
+    }
+    free(nodes);
+    UnmapFile(data, size);
+    return 0;
+}
+#endif
+
+// what finding more than one line costs over finding one on the bench positions
+static int MultiPVCost(int lines, int depth)
+{
+    Engine *engine = CreateEngine(DEFAULT_HASH_MB);
+    if(engine == NULL) return 1;
+
+    uint64_t singleNodes, multiNodes;
+    double singleTime, multiTime;
+    printf("1 line, depth %d\n", depth);
+    RunBench(engine, depth, 1, 1, &singleNodes, &singleTime);
+    printf("%d lines, depth %d\n", lines, depth);
+    RunBench(engine, depth, 1, lines, &multiNodes, &multiTime);
+
+    printf("===========================\n");
+    printf("%d lines took %.2fx the nodes and %.2fx the time of 1 line (%llu against %llu nodes)\n",
+           lines, (double)multiNodes / singleNodes, (singleTime > 0) ? multiTime / singleTime : 0.0,
+           (unsigned long long)multiNodes, (unsigned long long)singleNodes);
+    DestroyEngine(engine);
+    return 0;
+}
+
+// how fast SEE runs on every legal move of the bench positions
+static int SEEBench(double seconds)
+{
+    Board boards[NOB_ARRAY_LEN(benchPositions)] = { 0 };
+    MoveList moveLists[NOB_ARRAY_LEN(benchPositions)] = { 0 };
+    int captures = 0, losing = 0, moveCount = 0;
+    for(int i = 0; i < (int)NOB_ARRAY_LEN(benchPositions); i++)
+    {
+        if(!SetupPosition(&boards[i], benchPositions[i]))
+        {
+            fprintf(stderr, "could not set up bench position %d\n", i);
+            return 1;
+        }
+        GenerateMoves(&boards[i], &moveLists[i]);
+        for(int j = 0; j < moveLists[i].count; j++)
+        {
+            Move move = moveLists[i].moves[j];
+            if(boards[i].map[move.target] != NONE) captures++;
+            if(SEE(&boards[i], move) < 0) losing++;
+        }
+        moveCount += moveLists[i].count;
+    }
+
+    uint64_t calls = 0;
+    int64_t checksum = 0;
+    double start = GetMonotonicTime();
+    double elapsed = 0;
+    while(elapsed < seconds)
+    {
+        for(int i = 0; i < (int)NOB_ARRAY_LEN(benchPositions); i++)
+        {
+            for(int j = 0; j < moveLists[i].count; j++) checksum += SEE(&boards[i], moveLists[i].moves[j]);
+            calls += moveLists[i].count;
+        }
+        elapsed = GetMonotonicTime() - start;
+    }
+
+    printf("%d moves, %d captures, %d lose material\n", moveCount, captures, losing);
+    printf("===========================\n");
+    printf("see calls:   %llu\n", (unsigned long long)calls);
+    printf("checksum:    %lld\n", (long long)checksum / (long long)(calls / moveCount));
+    printf("calls/sec:   %.0f\n", (elapsed > 0) ? calls / elapsed : 0.0);
+
+    for(int i = 0; i < (int)NOB_ARRAY_LEN(benchPositions); i++)
+    {
+        free(moveLists[i].moves);
+        free(boards[i].mapHistory.items);
+    }
+    return 0;
+}
+
+// a ponder or infinite search that ends by itself holds its answer back
+// until ponderhit or stop
+enum {
+    HOLD_NONE,
+    HOLD_SEARCHING,
+    HOLD_FINISHED,
+};
+
+typedef struct {
+    Engine *engine;
+    Board board;
+    SearchLimits limits;
+    Thread *searchThread;
+    atomic_bool stopRequested;
+    atomic_bool ponderHitRequested;
+    atomic_int hold;
+    SearchResult heldResult;
+    size_t hashMegabytes;
+    int threads;
+    int multiPV;
+    int algorithm;
+    OpeningBook *book; // positions in it are answered with a book move, see setoption book
+} ProtocolState;
+
+// one line to whoever runs the engine, flushed right away since they wait for it
+static void Reply(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    fflush(stdout);
+}
+
+static void ReportIteration(SearchResult *result, void *arg)
+{
+    ProtocolState *state = arg;
+    // a stop that came before the search cleared its flag is caught here,
+    // and so is a ponderhit that came before the search set its limits
+    if(atomic_load(&state->stopRequested)) StopSearch(state->engine);
+    if(atomic_exchange(&state->ponderHitRequested, false)) PonderHit(state->engine);
+
+    for(int line = 0; line < result->lineCount; line++)
+    {
+        SearchLine *searchLine = &result->lines[line];
+        char pv[MAX_PLY * 8] = { 0 };
+        int length = 0;
+        for(int i = 0; i < searchLine->pvLength; i++)
+        {
+            if(i > 0) pv[length++] = ' ';
+            FormatProtocolMove(searchLine->pv[i], &pv[length]);
+            length += strlen(&pv[length]);
+        }
+        Reply("info depth %d multipv %d score %d scores %d %d %d nodes %llu nps %.0f time %.0f pv %s",
+              result->depth, line + 1, searchLine->score, searchLine->scores[0], searchLine->scores[1], searchLine->scores[2],
+              (unsigned long long)result->nodes, result->nps, result->time * 1000, pv);
+    }
+}
+
+// the best move and the opponents' replies up to our next turn, which is
+// what to ponder on
+static void ReplyBestMove(ProtocolState *state, SearchResult *result)
+{
+    char line[64] = "bestmove ";
+    FormatProtocolMove(result->bestMove, &line[strlen(line)]);
+
+    if(result->pvLength > 1)
+    {
+        Board board = state->board;
+        uint8_t colour = board.colourToMove;
+        strcat(line, " ponder");
+        MakeSearchMove(&board, result->pv[0]);
+        for(int i = 1; i < result->pvLength && board.colourToMove != colour; i++)
+        {
+            strcat(line, " ");
+            FormatProtocolMove(result->pv[i], &line[strlen(line)]);
+            MakeSearchMove(&board, result->pv[i]);
+        }
+    }
+    Reply("%s", line);
+}
+
+static void SearchJob(void *arg)
+{
+    ProtocolState *state = arg;
+    SearchResult result = Search(state->engine, &state->board, state->limits);
+#ifdef SEARCH_STATS
+    PrintSearchStats(stderr, &result.stats);
+#endif
+
+    state->heldResult = result;
+    int expected = HOLD_SEARCHING;
+    if(atomic_compare_exchange_strong(&state->hold, &expected, HOLD_FINISHED)) return;
+    ReplyBestMove(state, &result);
+}
+
+static void WaitForSearch(ProtocolState *state, bool stop)
+{
+    if(state->searchThread == NULL) return;
+    if(stop)
+    {
+        atomic_store(&state->stopRequested, true);
+        StopSearch(state->engine);
+    }
+    JoinThread(state->searchThread);
+    state->searchThread = NULL;
+    if(atomic_exchange(&state->hold, HOLD_NONE) == HOLD_FINISHED) ReplyBestMove(state, &state->heldResult);
+}
+
+// the predicted moves were played, the ponder search carries on as a normal one
+static void PonderHitCommand(ProtocolState *state)
+{
+    if(state->searchThread == NULL) return;
+    atomic_store(&state->ponderHitRequested, true);
+    PonderHit(state->engine);
+    int expected = HOLD_SEARCHING;
+    if(!atomic_compare_exchange_strong(&state->hold, &expected, HOLD_NONE)) WaitForSearch(state, false);
+}
+
+static void Go(ProtocolState *state, char *arguments)
+{
+    state->limits = (SearchLimits) {
+        .algorithm = state->algorithm,
+        .threads   = state->threads,
+        .multiPV   = state->multiPV,
+        .report    = ReportIteration,
+        .reportArg = state,
+    };
+
+    bool clockGiven = false;
+    bool hold = false;
+    double moveTime = 0;
+    char *token = strtok(arguments, " ");
+    while(token != NULL)
+    {
+        char *value = strtok(NULL, " ");
+        if(strcmp(token, "infinite") == 0 || strcmp(token, "ponder") == 0)
+        {
+            if(token[0] == 'p') state->limits.ponder = true;
+            hold = true;
+            token = value;
+            continue;
+        }
+        if(value == NULL) break;
+
+        if(strcmp(token, "wtime") == 0)         state->board.clock.seconds[0] = atof(value) / 1000, clockGiven = true;
+        else if(strcmp(token, "gtime") == 0)    state->board.clock.seconds[1] = atof(value) / 1000, clockGiven = true;
+        else if(strcmp(token, "btime") == 0)    state->board.clock.seconds[2] = atof(value) / 1000, clockGiven = true;
+        else if(strcmp(token, "inc") == 0)      state->board.clock.increment  = atoi(value) / 1000.0;
+        else if(strcmp(token, "movetime") == 0) moveTime = atof(value) / 1000;
+        else if(strcmp(token, "depth") == 0)    state->limits.maxDepth = atoi(value);
+        else if(strcmp(token, "nodes") == 0)    state->limits.maxNodes = strtoull(value, NULL, 10);
+        token = strtok(NULL, " ");
+    }
+
+    if(moveTime > 0) state->limits.timeLimit = moveTime;
+    else if(clockGiven) state->limits.useClock = true;
+
+    // only a search that answers by itself plays from the book
+    Move bookMove;
+    if(!hold && state->book != NULL && PickBookMove(state->book, &state->board, rand(), &bookMove))
+    {
+        char move[8];
+        FormatProtocolMove(bookMove, move);
+        Reply("bestmove %s", move);
+        return;
+    }
+
+    atomic_store(&state->stopRequested, false);
+    atomic_store(&state->ponderHitRequested, false);
+    atomic_store(&state->hold, hold ? HOLD_SEARCHING : HOLD_NONE);
+    state->searchThread = StartThread(SearchJob, state);
+}
+
+// a whole line of stdin however long it is, positions grow with the game
+static bool ReadLine(Nob_String_Builder *line)
+{
+    line->count = 0;
+    char chunk[1024];
+    while(fgets(chunk, sizeof(chunk), stdin) != NULL)
+    {
+        nob_sb_append_cstr(line, chunk);
+        if(line->items[line->count-1] == '\n') break;
+    }
+    nob_sb_append_null(line);
+    return line->count > 1;
+}
+
+// reads commands until quit or the end of stdin, see protocol.c
+static int RunProtocol()
+{
+    ProtocolState state = { .hashMegabytes = DEFAULT_HASH_MB, .threads = 1, .multiPV = 1, .algorithm = SEARCH_PARANOID };
+    state.engine = CreateEngine(state.hashMegabytes);
+    InitBoard(&state.board, DEFAULT_FEN);
+    srand(time(NULL));
+
+    Nob_String_Builder input = { 0 };
+    while(ReadLine(&input))
+    {
+        char *line = input.items;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *arguments = strchr(line, ' ');
+        if(arguments != NULL) *arguments++ = '\0';
+        else arguments = "";
+
+        if(strcmp(line, "protocol") == 0)
+        {
+            Reply("id name %s", ENGINE_NAME);
+            Reply("protocolok");
+        }
+        else if(strcmp(line, "isready") == 0) Reply("readyok");
+        else if(strcmp(line, "setoption") == 0)
+        {
+            WaitForSearch(&state, true);
+            char name[32];
+            char text[256];
+            if(sscanf(arguments, "%31s %255s", name, text) != 2) continue;
+            long value = atol(text);
+            if(strcmp(name, "algorithm") == 0)
+            {
+                int algorithm = ParseSearchAlgorithm(text);
+                if(algorithm >= 0) state.algorithm = algorithm;
+            }
+            else if(strcmp(name, "book") == 0)
+            {
+                if(state.book != NULL) FreeOpeningBook(state.book);
+                state.book = (strcmp(text, "none") != 0) ? LoadOpeningBook(text) : NULL;
+                if(state.book == NULL && strcmp(text, "none") != 0) fprintf(stderr, "could not load opening book %s\n", text);
+            }
+            else if(strcmp(name, "threads") == 0) state.threads = (value > 0) ? value : 1;
+            else if(strcmp(name, "multipv") == 0) state.multiPV = (value < 1) ? 1 : (value > MAX_MULTIPV) ? MAX_MULTIPV : value;
+            else if(strcmp(name, "hash") == 0 && value > 0 && (size_t)value != state.hashMegabytes)
+            {
+                Engine *engine = CreateEngine(value);
+                if(engine == NULL) continue;
+                DestroyEngine(state.engine);
+                state.engine = engine;
+                state.hashMegabytes = value;
+            }
+        }
+        else if(strcmp(line, "newgame") == 0)
+        {
+            WaitForSearch(&state, true);
+            ClearEngine(state.engine);
+        }
+        else if(strcmp(line, "position") == 0)
+        {
+            WaitForSearch(&state, true);
+            if(!SetupProtocolPosition(&state.board, arguments))
+            {
+                fprintf(stderr, "could not set up position %s\n", arguments);
+                InitBoard(&state.board, DEFAULT_FEN);
+            }
+        }
+        else if(strcmp(line, "go") == 0)
+        {
+            WaitForSearch(&state, true);
+            Go(&state, arguments);
+        }
+        else if(strcmp(line, "ponderhit") == 0) PonderHitCommand(&state);
+        else if(strcmp(line, "stop") == 0) WaitForSearch(&state, true);
+        else if(strcmp(line, "quit") == 0) break;
+    }
+
+    WaitForSearch(&state, true);
+    DestroyEngine(state.engine);
+    if(state.book != NULL) FreeOpeningBook(state.book);
+    free(state.board.mapHistory.items);
+    free(input.items);
+    return 0;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s [command] [options]\n", program);
+    printf("without a command the engine reads the engine protocol from stdin, see src/common/protocol.c\n");
+    printf("commands:\n");
+    printf("\tbench [depth] [threads] [hash] [algorithm]:\n");
+    printf("\t                                search the bench positions with one thread and then with threads\n");
+    printf("\t                                (default %d, 0 = one per core, %dMB, paranoid or best-reply)\n",
+           DEFAULT_BENCH_DEPTH, DEFAULT_HASH_MB);
+    printf("\tmultipv [lines] [depth]:        compare the cost of finding lines best moves on the bench positions to finding one (default %d, %d)\n",
+           DEFAULT_MULTIPV, DEFAULT_BENCH_DEPTH);
+#ifdef SEARCH_STATS
+    printf("\ttrace <file> [plies] [depth]:   write the first plies of the bench searches to file (default %d, %d)\n",
+           DEFAULT_TRACE_PLIES, DEFAULT_BENCH_DEPTH);
+    printf("\tshowtrace <file> [plies]:       print a trace as a tree, up to plies\n");
+#endif
+    printf("\tsee [seconds]:                  time static exchange evaluation of every legal move of the bench positions (default %d)\n",
+           DEFAULT_SEE_SECONDS);
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    GenerateMoveData();
+    InitEvaluation();
+    if(argc == 0) return RunProtocol();
+
+    char *command = nob_shift_args(&argc, &argv);
+
+    if(strcmp(command, "bench") == 0)
+    {
+        int depth   = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_BENCH_DEPTH;
+        int threads = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : 0;
+        size_t hash = (argc > 0) ? strtoul(nob_shift_args(&argc, &argv), NULL, 10) : DEFAULT_HASH_MB;
+        if(argc > 0)
+        {
+            char *name = nob_shift_args(&argc, &argv);
+            benchAlgorithm = ParseSearchAlgorithm(name);
+            if(benchAlgorithm < 0)
+            {
+                fprintf(stderr, "unknown algorithm %s\n", name);
+                return 1;
+            }
+        }
+        return Bench(depth > 0 ? depth : DEFAULT_BENCH_DEPTH, threads, hash);
+    }
+
+    if(strcmp(command, "multipv") == 0)
+    {
+        int lines = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_MULTIPV;
+        int depth = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_BENCH_DEPTH;
+        if(lines < 2 || lines > MAX_MULTIPV) lines = DEFAULT_MULTIPV;
+        return MultiPVCost(lines, depth > 0 ? depth : DEFAULT_BENCH_DEPTH);
+    }
+
+#ifdef SEARCH_STATS
+    if(strcmp(command, "trace") == 0 && argc > 0)
+    {
+        char *path = nob_shift_args(&argc, &argv);
+        int plies  = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_TRACE_PLIES;
+        int depth  = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_BENCH_DEPTH;
+        return Trace(path, plies > 0 ? plies : DEFAULT_TRACE_PLIES, depth > 0 ? depth : DEFAULT_BENCH_DEPTH);
+    }
+
+    if(strcmp(command, "showtrace") == 0 && argc > 0)
+    {
+        char *path = nob_shift_args(&argc, &argv);
+        int plies  = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : MAX_PLY;
+        return ShowTrace(path, plies);
+    }
+#endif
+
+    if(strcmp(command, "see") == 0)
+    {
+        double seconds = (argc > 0) ? atof(nob_shift_args(&argc, &argv)) : DEFAULT_SEE_SECONDS;
+        return SEEBench(seconds > 0 ? seconds : DEFAULT_SEE_SECONDS);
+    }
+
+    PrintUsage(program);
+    return strcmp(command, "--help") == 0 ? 0 : 1;
+}
@@ -0,0 +1,723 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_MATE_IN     5
+#define DEFAULT_MINE_MATE   3
+#define DEFAULT_NODES       10000000
+#define DEFAULT_MINE_NODES  200000
+#define DEFAULT_MEMORY_MB   256
+#define MAX_SOLVE_PLY       64
+#define MAX_CHILDREN        512
+#define NODE_CHECK_INTERVAL 1024
+#define BUCKET_SIZE         4
+
+// mate solver
+//
+// depth-first proof-number search for a forced mate by one colour. the
+// mating colour picks its moves (or nodes), the other two defend together
+// (and nodes), and the proof is the target being left without moves on its
+// turn: the first colour without moves is out whether it is in check or not,
+// after that only a checkmate counts. with no target either opponent will do.
+// mate in n limits the mating colour to n moves, the moves left are part of
+// the key, so a node's numbers always belong to one bound and the tree has
+// no cycles
+//
+// the table is a fixed number of buckets, an entry that doesn't fit pushes
+// out the one with the least work below it. the threads of one problem all
+// search from the root on the same table, starting their ties from
+// different children so they spread out, and the first to settle the root
+// stops the rest. entries are written without locks, the key is stored
+// xored with the data so a torn entry reads as a miss
+
+#define PN_INFINITY ((1u << 26) - 1)
+#define WORK_MAX    ((1u << 12) - 1)
+
+typedef struct {
+    _Atomic uint64_t check; // key ^ data
+    _Atomic uint64_t data;
+} SolveEntry;
+
+typedef struct {
+    SolveEntry *entries;
+    uint64_t mask; // of the bucket index
+} SolveTable;
+
+typedef struct {
+    uint32_t pn;
+    uint32_t dn;
+    uint32_t work; // log2 of the nodes searched below, to decide what gets replaced
+} ProofNumbers;
+
+enum {
+    UNDECIDED,
+    PROVEN,
+    DISPROVEN,
+};
+
+typedef struct {
+    SolveTable *table;
+    uint8_t attacker;
+    uint8_t target; // NONE for either opponent
+    uint64_t salt;  // tells the problems apart in a shared table
+    uint64_t maxNodes;
+    atomic_uint_fast64_t nodes;
+    atomic_bool stop;
+} Problem;
+
+typedef struct {
+    Problem *problem;
+    int id;
+    uint64_t nodes;
+    MoveList lists[MAX_SOLVE_PLY];
+    uint64_t keys[MAX_SOLVE_PLY][MAX_CHILDREN];
+} Solver;
+
+static inline uint32_t AddNumbers(uint32_t a, uint32_t b)
+{
+    return (a + b >= PN_INFINITY) ? PN_INFINITY : a + b;
+}
+
+static inline uint64_t PackNumbers(ProofNumbers numbers)
+{
+    return (uint64_t)numbers.pn | ((uint64_t)numbers.dn << 26) | ((uint64_t)numbers.work << 52);
+}
+
+static inline ProofNumbers UnpackNumbers(uint64_t data)
+{
+    return (ProofNumbers) { .pn = data & PN_INFINITY, .dn = (data >> 26) & PN_INFINITY, .work = data >> 52 };
+}
+
+static bool InitSolveTable(SolveTable *table, size_t megabytes)
+{
+    uint64_t buckets = 1;
+    while(buckets * 2 * BUCKET_SIZE * sizeof(SolveEntry) <= megabytes * 1024 * 1024) buckets *= 2;
+    table->entries = calloc(buckets * BUCKET_SIZE, sizeof(SolveEntry));
+    table->mask = buckets - 1;
+    return table->entries != NULL;
+}
+
+// an unknown node starts at 1 and 1
+static ProofNumbers LookupNumbers(SolveTable *table, uint64_t key)
+{
+    SolveEntry *bucket = &table->entries[(key & table->mask) * BUCKET_SIZE];
+    for(int i = 0; i < BUCKET_SIZE; i++)
+    {
+        uint64_t data  = atomic_load_explicit(&bucket[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&bucket[i].check, memory_order_relaxed);
+        if((check ^ data) == key) return UnpackNumbers(data);
+    }
+    return (ProofNumbers) { .pn = 1, .dn = 1 };
+}
+
+static void StoreNumbers(SolveTable *table, uint64_t key, ProofNumbers numbers)
+{
+    SolveEntry *bucket = &table->entries[(key & table->mask) * BUCKET_SIZE];
+    int replace = 0;
+    uint32_t leastWork = UINT32_MAX;
+    for(int i = 0; i < BUCKET_SIZE; i++)
+    {
+        uint64_t data  = atomic_load_explicit(&bucket[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&bucket[i].check, memory_order_relaxed);
+        if((check ^ data) == key)
+        {
+            replace = i;
+            break;
+        }
+        uint32_t work = (data == 0) ? 0 : UnpackNumbers(data).work;
+        if(work < leastWork)
+        {
+            leastWork = work;
+            replace = i;
+        }
+    }
+
+    uint64_t data = PackNumbers(numbers);
+    atomic_store_explicit(&bucket[replace].data, data, memory_order_relaxed);
+    atomic_store_explicit(&bucket[replace].check, key ^ data, memory_order_relaxed);
+}
+
+static inline uint64_t NodeKey(Problem *problem, Board *board, int movesLeft)
+{
+    return (board->hash ^ problem->salt) + (uint64_t)movesLeft * 0x9E3779B97F4A7C15ULL;
+}
+
+static inline uint32_t WorkOf(uint64_t nodes)
+{
+    uint32_t work = 0;
+    while(nodes > 1 && work < WORK_MAX)
+    {
+        nodes >>= 1;
+        work++;
+    }
+    return work;
+}
+
+// the moves at a node once the colours without any are taken off the board,
+// or whether the node is decided without them
+static int ExpandNode(Problem *problem, Board *board, int movesLeft, MoveList *list)
+{
+    while(true)
+    {
+        uint8_t colour = board->colourToMove;
+        if(colour == problem->attacker && movesLeft == 0) return DISPROVEN;
+
+        GenerateMoves(board, list);
+        if(list->count > 0) return UNDECIDED;
+
+        bool targeted = problem->target == NONE || colour == problem->target;
+        if(board->eliminatedColour == NONE)
+        {
+            if(colour == problem->attacker) return DISPROVEN;
+            if(targeted) return PROVEN;
+
+            // the other opponent is out, the game goes on
+            EliminateColour(board, colour);
+            NextMove(board);
+            continue;
+        }
+
+        // with one colour gone a checkmate ends the game and a stalemate draws it
+        if(colour == problem->attacker || !InCheck()) return DISPROVEN;
+        return targeted ? PROVEN : DISPROVEN;
+    }
+}
+
+static bool SolverShouldStop(Solver *solver)
+{
+    Problem *problem = solver->problem;
+    if(atomic_load_explicit(&problem->stop, memory_order_relaxed)) return true;
+    if((solver->nodes % NODE_CHECK_INTERVAL) != 0) return false;
+
+    uint64_t total = atomic_fetch_add_explicit(&problem->nodes, NODE_CHECK_INTERVAL, memory_order_relaxed) + NODE_CHECK_INTERVAL;
+    if(problem->maxNodes != 0 && total >= problem->maxNodes) atomic_store(&problem->stop, true);
+    return atomic_load_explicit(&problem->stop, memory_order_relaxed);
+}
+
+// searches below the node until its proof or disproof number reaches its threshold
+static void SearchProof(Solver *solver, Board *board, uint64_t key, int movesLeft, int ply, uint32_t proofThreshold, uint32_t disproofThreshold)
+{
+    Problem *problem = solver->problem;
+    solver->nodes++;
+    if(SolverShouldStop(solver)) return;
+
+    ProofNumbers numbers = LookupNumbers(problem->table, key);
+    if(numbers.pn >= proofThreshold || numbers.dn >= disproofThreshold) return;
+
+    Board node = *board;
+    MoveList *list = &solver->lists[ply];
+    int state = (ply < MAX_SOLVE_PLY - 1) ? ExpandNode(problem, &node, movesLeft, list) : DISPROVEN;
+    if(state != UNDECIDED)
+    {
+        ProofNumbers decided = (state == PROVEN) ? (ProofNumbers) { 0, PN_INFINITY, 0 } : (ProofNumbers) { PN_INFINITY, 0, 0 };
+        StoreNumbers(problem->table, key, decided);
+        return;
+    }
+
+    bool attacking = node.colourToMove == problem->attacker;
+    int childMovesLeft = movesLeft - attacking;
+    int count = (list->count < MAX_CHILDREN) ? list->count : MAX_CHILDREN;
+    uint64_t *keys = solver->keys[ply];
+    for(int i = 0; i < count; i++)
+    {
+        Board child = node;
+        MakeSearchMove(&child, list->moves[i]);
+        keys[i] = NodeKey(problem, &child, childMovesLeft);
+    }
+
+    uint64_t startNodes = solver->nodes;
+    // helpers look at the children from a different one each, so equal ones
+    // are picked differently
+    int first = (solver->id * 7) % count;
+    while(true)
+    {
+        // the numbers of this node from its children, an or node needs one
+        // proven child and all of them disproven, an and node the other way around
+        uint32_t proof = attacking ? PN_INFINITY : 0;
+        uint32_t disproof = attacking ? 0 : PN_INFINITY;
+        uint32_t second = PN_INFINITY;
+        int best = -1;
+        ProofNumbers bestNumbers = { 0 };
+        for(int n = 0; n < count; n++)
+        {
+            int i = (first + n) % count;
+            ProofNumbers child = LookupNumbers(problem->table, keys[i]);
+            uint32_t selected = attacking ? child.pn : child.dn;
+            if(best < 0 || selected < (attacking ? bestNumbers.pn : bestNumbers.dn))
+            {
+                if(best >= 0) second = attacking ? bestNumbers.pn : bestNumbers.dn;
+                best = i;
+                bestNumbers = child;
+            }
+            else if(selected < second) second = selected;
+
+            if(attacking)
+            {
+                if(child.pn < proof) proof = child.pn;
+                disproof = AddNumbers(disproof, child.dn);
+            }
+            else
+            {
+                proof = AddNumbers(proof, child.pn);
+                if(child.dn < disproof) disproof = child.dn;
+            }
+        }
+
+        if(proof >= proofThreshold || disproof >= disproofThreshold || atomic_load_explicit(&problem->stop, memory_order_relaxed))
+        {
+            numbers = (ProofNumbers) { .pn = proof, .dn = disproof, .work = WorkOf(solver->nodes - startNodes) };
+            if(proof == 0 || disproof == 0 || !atomic_load(&problem->stop)) StoreNumbers(problem->table, key, numbers);
+            return;
+        }
+
+        // 1 + 1/4 of the second best as the threshold of the best keeps the
+        // search from jumping between two children that are about as good
+        uint32_t secondThreshold = AddNumbers(second, (second / 4 > 1) ? second / 4 : 1);
+        uint32_t childProof, childDisproof;
+        if(attacking)
+        {
+            childProof    = (proofThreshold < secondThreshold) ? proofThreshold : secondThreshold;
+            childDisproof = (disproofThreshold >= PN_INFINITY) ? PN_INFINITY : disproofThreshold - disproof + bestNumbers.dn;
+        }
+        else
+        {
+            childProof    = (proofThreshold >= PN_INFINITY) ? PN_INFINITY : proofThreshold - proof + bestNumbers.pn;
+            childDisproof = (disproofThreshold < secondThreshold) ? disproofThreshold : secondThreshold;
+        }
+
+        Board child = node;
+        MakeSearchMove(&child, list->moves[best]);
+        SearchProof(solver, &child, keys[best], childMovesLeft, ply + 1, childProof, childDisproof);
+    }
+}
+
+typedef struct {
+    Problem *problem;
+    Board *root;
+    int movesLeft;
+    Solver **solvers;
+} SolveJob;
+
+static void SolveOnThread(void *arg, int index)
+{
+    SolveJob *job = arg;
+    Problem *problem = job->problem;
+    Solver *solver = job->solvers[index];
+    uint64_t key = NodeKey(problem, job->root, job->movesLeft);
+
+    while(!atomic_load(&problem->stop))
+    {
+        SearchProof(solver, job->root, key, job->movesLeft, 0, PN_INFINITY, PN_INFINITY);
+        ProofNumbers numbers = LookupNumbers(problem->table, key);
+        if(numbers.pn == 0 || numbers.dn == 0) atomic_store(&problem->stop, true);
+    }
+}
+
+// PROVEN, DISPROVEN or UNDECIDED when the node budget ran out
+static int SolveMateIn(Problem *problem, ThreadPool *pool, Solver **solvers, Board *root, int movesLeft)
+{
+    atomic_store(&problem->stop, false);
+    SolveJob job = { .problem = problem, .root = root, .movesLeft = movesLeft, .solvers = solvers };
+    if(pool == NULL) SolveOnThread(&job, 0);
+    else ParallelFor(pool, ThreadPoolSize(pool), SolveOnThread, &job);
+
+    for(int i = 0; solvers[i] != NULL; i++)
+    {
+        atomic_fetch_add(&problem->nodes, solvers[i]->nodes % NODE_CHECK_INTERVAL);
+        solvers[i]->nodes = 0;
+    }
+
+    ProofNumbers numbers = LookupNumbers(problem->table, NodeKey(problem, root, movesLeft));
+    if(numbers.pn == 0) return PROVEN;
+    if(numbers.dn == 0) return DISPROVEN;
+    return UNDECIDED;
+}
+
+// the shortest mate up to mateIn, 0 when there is none and -1 when the budget
+// ran out before that was known
+static int FindShortestMate(Problem *problem, ThreadPool *pool, Solver **solvers, Board *root, int mateIn)
+{
+    for(int moves = 1; moves <= mateIn; moves++)
+    {
+        int state = SolveMateIn(problem, pool, solvers, root, moves);
+        if(state == PROVEN) return moves;
+        if(state == UNDECIDED) return -1;
+    }
+    return 0;
+}
+
+// the proven line, the mating colour plays a proven move and the defenders
+// the one that took the most work to refute. it stops early when the table
+// lost part of the proof
+static void GetMateLine(Problem *problem, Board *root, int movesLeft, MoveNotations *notations)
+{
+    static _Thread_local MoveList list = { 0 };
+    Board board = *root;
+    for(int ply = 0; ply < MAX_SOLVE_PLY; ply++)
+    {
+        if(ExpandNode(problem, &board, movesLeft, &list) != UNDECIDED) return;
+
+        bool attacking = board.colourToMove == problem->attacker;
+        int childMovesLeft = movesLeft - attacking;
+        int best = -1;
+        uint32_t bestWork = 0;
+        for(int i = 0; i < list.count; i++)
+        {
+            Board child = board;
+            MakeSearchMove(&child, list.moves[i]);
+            ProofNumbers numbers = LookupNumbers(problem->table, NodeKey(problem, &child, childMovesLeft));
+            if(numbers.pn != 0) continue;
+            if(best < 0 || (!attacking && numbers.work > bestWork))
+            {
+                best = i;
+                bestWork = numbers.work;
+            }
+            if(attacking) break;
+        }
+        if(best < 0)
+        {
+            nob_da_append(notations, "...");
+            return;
+        }
+
+        GetMoveNotation(&board, list.moves[best], notations);
+        MakeSearchMove(&board, list.moves[best]);
+        movesLeft = childMovesLeft;
+    }
+}
+
+static void PrintMateLine(MoveNotations *notations)
+{
+    for(size_t i = 0; i < notations->count; i++)
+    {
+        printf("%s%s", (i > 0) ? " " : "", notations->items[i]);
+        if(strcmp(notations->items[i], "...") != 0) free(notations->items[i]);
+    }
+    notations->count = 0;
+}
+
+static Solver **CreateSolvers(Problem *problem, int count)
+{
+    Solver **solvers = calloc(count + 1, sizeof(Solver *));
+    for(int i = 0; i < count; i++)
+    {
+        solvers[i] = calloc(1, sizeof(Solver));
+        solvers[i]->problem = problem;
+        solvers[i]->id = i;
+    }
+    return solvers;
+}
+
+static void FreeSolvers(Solver **solvers)
+{
+    for(int i = 0; solvers[i] != NULL; i++)
+    {
+        for(int ply = 0; ply < MAX_SOLVE_PLY; ply++) free(solvers[i]->lists[ply].moves);
+        free(solvers[i]);
+    }
+    free(solvers);
+}
+
+static void InitProblem(Problem *problem, SolveTable *table, uint8_t attacker, uint8_t target, uint64_t maxNodes)
+{
+    *problem = (Problem) { .table = table, .attacker = attacker, .target = target, .maxNodes = maxNodes };
+    problem->salt = (attacker * 0x100000001B3ULL + target + 1) * 0xD6E8FEB86659FD93ULL;
+}
+
+static uint8_t ParseColour(const char *text)
+{
+    switch(text[0])
+    {
+        case 'w': case 'W': return WHITE;
+        case 'g': case 'G': return GRAY;
+        case 'b': case 'B': return BLACK;
+        default: return NONE;
+    }
+}
+
+typedef struct {
+    uint8_t attacker;
+    uint8_t target;
+    int mateIn;
+    uint64_t nodes;
+    size_t memory;
+    int threads;
+} SolveOptions;
+
+static int Solve(Board *board, SolveOptions options)
+{
+    SolveTable table;
+    if(!InitSolveTable(&table, options.memory))
+    {
+        fprintf(stderr, "could not allocate %zuMB for the table\n", options.memory);
+        return 1;
+    }
+
+    Problem problem;
+    uint8_t attacker = (options.attacker != NONE) ? options.attacker : board->colourToMove;
+    InitProblem(&problem, &table, attacker, options.target, options.nodes);
+
+    ThreadPool *pool = CreateThreadPool(options.threads);
+    int threadCount = ThreadPoolSize(pool);
+    Solver **solvers = CreateSolvers(&problem, threadCount);
+
+    double start = GetMonotonicTime();
+    int mate = FindShortestMate(&problem, pool, solvers, board, options.mateIn);
+    double time = GetMonotonicTime() - start;
+    uint64_t nodes = atomic_load(&problem.nodes);
+
+    const char *target = (options.target != NONE) ? GetColourString(options.target) : "an opponent";
+    if(mate > 0)
+    {
+        printf("%s mates %s in %d: ", GetColourString(attacker), target, mate);
+        MoveNotations notations = { 0 };
+        GetMateLine(&problem, board, mate, &notations);
+        PrintMateLine(&notations);
+        printf("\n");
+        free(notations.items);
+    }
+    else if(mate == 0) printf("%s can't force a mate of %s in %d\n", GetColourString(attacker), target, options.mateIn);
+    else printf("no answer within %llu nodes\n", (unsigned long long)options.nodes);
+    printf("%llu nodes in %.2fs, %.0f nodes/s on %d threads\n", (unsigned long long)nodes, time, (time > 0) ? nodes / time : 0.0, threadCount);
+
+    FreeSolvers(solvers);
+    DestroyThreadPool(pool);
+    free(table.entries);
+    return 0;
+}
+
+typedef struct {
+    const char *text;
+    size_t size;
+    int chunkCount;
+    SolveOptions options;
+    SolveTable *table;
+    atomic_uint_fast64_t positions;
+    atomic_uint_fast64_t puzzles;
+    atomic_uint_fast64_t nodes;
+} Miner;
+
+// tries every position of a game for a mate by the colour to move
+static void MineGame(Miner *miner, Solver **solvers, Problem *problem, Board *board, int gameIndex, char *line)
+{
+    InitBoard(board, DEFAULT_FEN);
+
+    char played[4096] = "";
+    char *cursor = line;
+    for(int ply = 0; ; ply++)
+    {
+        InitProblem(problem, miner->table, board->colourToMove, miner->options.target, miner->options.nodes);
+        solvers[0]->problem = problem;
+        int mate = FindShortestMate(problem, NULL, solvers, board, miner->options.mateIn);
+        atomic_fetch_add(&miner->positions, 1);
+        atomic_fetch_add(&miner->nodes, atomic_load(&problem->nodes));
+        if(mate > 0)
+        {
+            MoveNotations notations = { 0 };
+            GetMateLine(problem, board, mate, &notations);
+
+            // one printf per puzzle, lines from different threads don't mix
+            char solution[1024] = "";
+            for(size_t i = 0; i < notations.count && strlen(solution) + 16 < sizeof(solution); i++)
+            {
+                if(i > 0) strcat(solution, " ");
+                strcat(solution, notations.items[i]);
+                if(strcmp(notations.items[i], "...") != 0) free(notations.items[i]);
+            }
+            free(notations.items);
+            printf("game %d ply %d, %s mates in %d: %s | after: %s\n", gameIndex + 1, ply, GetColourString(problem->attacker), mate, solution, played);
+            atomic_fetch_add(&miner->puzzles, 1);
+        }
+
+        while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r') cursor++;
+        if(*cursor == '\0') return;
+        char *token = cursor;
+        while(*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r') cursor++;
+        if(*cursor != '\0') *cursor++ = '\0';
+
+        if(token[strlen(token)-1] == '.')
+        {
+            ply--;
+            continue;
+        }
+        Move move = nullMove;
+        bool eliminated = strcmp(token, "xxx") == 0;
+        if(eliminated)
+        {
+            // the second one ends the game, only the result can follow
+            if(board->eliminatedColour != NONE) return;
+        }
+        else if(!ParseMoveToken(board, token, &move)) return;
+
+        if(strlen(played) + strlen(token) + 2 < sizeof(played))
+        {
+            if(played[0] != '\0') strcat(played, " ");
+            strcat(played, token);
+        }
+        if(eliminated)
+        {
+            EliminateColour(board, board->colourToMove);
+            NextMove(board);
+        }
+        else MakeMove(board, move);
+    }
+}
+
+// lines that start inside a chunk belong to it, like in booktool.c
+static void MineChunk(void *arg, int chunk)
+{
+    Miner *miner = arg;
+    static _Thread_local Board board = { 0 };
+    Problem problem;
+    Solver **solvers = CreateSolvers(&problem, 1);
+
+    size_t start = miner->size * chunk / miner->chunkCount;
+    size_t end   = miner->size * (chunk + 1) / miner->chunkCount;
+    if(start > 0) while(start < miner->size && miner->text[start-1] != '\n') start++;
+
+    // the game number is the line number, counted up to the chunk
+    int gameIndex = 0;
+    for(size_t i = 0; i < start; i++) if(miner->text[i] == '\n') gameIndex++;
+
+    char line[4096];
+    while(start < end)
+    {
+        size_t length = 0;
+        while(start + length < miner->size && miner->text[start + length] != '\n') length++;
+        if(length > 0 && length < sizeof(line) && miner->text[start] != '#')
+        {
+            memcpy(line, &miner->text[start], length);
+            line[length] = '\0';
+            MineGame(miner, solvers, &problem, &board, gameIndex, line);
+        }
+        start += length + 1;
+        gameIndex++;
+    }
+    FreeSolvers(solvers);
+}
+
+static int Mine(const char *gamesPath, SolveOptions options)
+{
+    size_t size;
+    void *text = MapFile(gamesPath, &size);
+    if(text == NULL)
+    {
+        fprintf(stderr, "could not read %s\n", gamesPath);
+        return 1;
+    }
+
+    SolveTable table;
+    if(!InitSolveTable(&table, options.memory))
+    {
+        fprintf(stderr, "could not allocate %zuMB for the table\n", options.memory);
+        UnmapFile(text, size);
+        return 1;
+    }
+
+    ThreadPool *pool = CreateThreadPool(options.threads);
+    Miner miner = { .text = text, .size = size, .options = options, .table = &table };
+    miner.chunkCount = ThreadPoolSize(pool) * 8;
+
+    double start = GetMonotonicTime();
+    ParallelFor(pool, miner.chunkCount, MineChunk, &miner);
+    double time = GetMonotonicTime() - start;
+
+    uint64_t nodes = atomic_load(&miner.nodes);
+    printf("%llu puzzles in %llu positions, %llu nodes in %.2fs, %.0f nodes/s on %d threads\n",
+           (unsigned long long)atomic_load(&miner.puzzles), (unsigned long long)atomic_load(&miner.positions),
+           (unsigned long long)nodes, time, (time > 0) ? nodes / time : 0.0, ThreadPoolSize(pool));
+
+    DestroyThreadPool(pool);
+    free(table.entries);
+    UnmapFile(text, size);
+    return 0;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <command> [options]\n", program);
+    printf("commands:\n");
+    printf("\tsolve <fen|startpos> [moves] [options]: look for a forced mate after the moves, the fen with its lines joined by |\n");
+    printf("\t    --by <colour>:     the colour that mates (default the colour to move)\n");
+    printf("\t    --target <colour>: the colour that gets mated (default either opponent)\n");
+    printf("\t    --mate-in <n>:     the most moves of the mating colour (default %d)\n", DEFAULT_MATE_IN);
+    printf("\t    --nodes <n>:       give up after this many nodes (default %d)\n", DEFAULT_NODES);
+    printf("\t    --memory <MB>:     size of the node table (default %d)\n", DEFAULT_MEMORY_MB);
+    printf("\t    --threads <n>:     threads searching the position, 0 for one per core (default 0)\n");
+    printf("\tmine <games> [options]:                 print the positions of a file with one game per line where the colour to move mates\n");
+    printf("\t    --target, --mate-in (default %d), --nodes per position (default %d), --memory and --threads as above,\n", DEFAULT_MINE_MATE, DEFAULT_MINE_NODES);
+    printf("\t    the threads share the table and work on different games\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc < 2)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    GenerateMoveData();
+    char *command = nob_shift_args(&argc, &argv);
+    bool mining = strcmp(command, "mine") == 0;
+    if(!mining && strcmp(command, "solve") != 0)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    char *input = nob_shift_args(&argc, &argv);
+    Board board = { 0 };
+    if(!mining)
+    {
+        char FEN[256];
+        snprintf(FEN, sizeof(FEN), "%s", (strcmp(input, "startpos") == 0) ? DEFAULT_FEN : input);
+        for(char *c = FEN; *c != '\0'; c++) if(*c == '|') *c = '\n';
+        if(InitBoard(&board, FEN) != 0)
+        {
+            fprintf(stderr, "could not read the fen %s\n", input);
+            return 1;
+        }
+        while(argc > 0 && argv[0][0] != '-')
+        {
+            char *token = nob_shift_args(&argc, &argv);
+            Move move;
+            if(!ParseMoveToken(&board, token, &move))
+            {
+                fprintf(stderr, "%s is not a legal move here\n", token);
+                return 1;
+            }
+            MakeMove(&board, move);
+        }
+    }
+
+    SolveOptions options = {
+        .mateIn  = mining ? DEFAULT_MINE_MATE : DEFAULT_MATE_IN,
+        .nodes   = mining ? DEFAULT_MINE_NODES : DEFAULT_NODES,
+        .memory  = DEFAULT_MEMORY_MB,
+    };
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--by") == 0 && argc > 0 && !mining) options.attacker = ParseColour(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--target") == 0 && argc > 0)   options.target = ParseColour(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--mate-in") == 0 && argc > 0)  options.mateIn = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--nodes") == 0 && argc > 0)    options.nodes = strtoull(nob_shift_args(&argc, &argv), NULL, 10);
+        else if(strcmp(option, "--memory") == 0 && argc > 0)   options.memory = strtoul(nob_shift_args(&argc, &argv), NULL, 10);
+        else if(strcmp(option, "--threads") == 0 && argc > 0)  options.threads = atoi(nob_shift_args(&argc, &argv));
+        else
+        {
+            PrintUsage(program);
+            return 1;
+        }
+    }
+
+    if(mining) return Mine(input, options);
+    int result = Solve(&board, options);
+    free(board.mapHistory.items);
+    return result;
+}
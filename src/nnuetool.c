@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_POSITIONS 4096
+#define GAME_LENGTH 120
+
+typedef struct {
+    Board *boards;
+    int count;
+} PositionSet;
+
+static uint64_t NextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// random games from the start position, every position along the way is kept
+// so the incremental benchmark can replay them move by move
+static PositionSet GeneratePositions(int count)
+{
+    PositionSet set = { .boards = calloc(count, sizeof(Board)), .count = 0 };
+    MoveList moveList = {0};
+    uint64_t random = 0x9E3779B97F4A7C15ULL;
+
+    while(set.count < count)
+    {
+        Board board = {0};
+        InitBoard(&board, DEFAULT_FEN);
+        for(int ply = 0; ply < GAME_LENGTH && set.count < count; ply++)
+        {
+            GenerateMoves(&board, &moveList);
+            if(moveList.count == 0) break;
+            MakeSearchMove(&board, moveList.moves[NextRandom(&random) % moveList.count]);
+            set.boards[set.count++] = board;
+        }
+    }
+
+    free(moveList.moves);
+    return set;
+}
+
+static void Bench(NNUE *network, PositionSet *set, bool allowSimd)
+{
+    const char *kernels = SelectNNUEKernels(allowSimd);
+    Accumulator accumulator, child;
+    int scores[3];
+    volatile int sink = 0;
+
+    // full refresh of all three accumulators before every evaluation
+    double start = GetMonotonicTime();
+    for(int i = 0; i < set->count; i++)
+    {
+        RefreshAccumulator(network, &accumulator, &set->boards[i]);
+        EvaluateNNUE(network, &accumulator, &set->boards[i], scores);
+        sink += scores[0];
+    }
+    double refreshTime = GetMonotonicTime() - start;
+
+    // the way a search uses it, one update from the parent per evaluation
+    RefreshAccumulator(network, &accumulator, &set->boards[0]);
+    start = GetMonotonicTime();
+    for(int i = 1; i < set->count; i++)
+    {
+        Board *board = &set->boards[i];
+        if(board->moveCount == 1) RefreshAccumulator(network, &child, board);
+        else UpdateAccumulator(network, &accumulator, &child, board);
+        EvaluateNNUE(network, &child, board, scores);
+        accumulator = child;
+        sink += scores[0];
+    }
+    double updateTime = GetMonotonicTime() - start;
+
+    printf("%-6s refresh:     %12.0f evals/s\n", kernels, set->count / refreshTime);
+    printf("%-6s incremental: %12.0f evals/s\n", kernels, (set->count - 1) / updateTime);
+    (void)sink;
+}
+
+static void BenchHandWritten(PositionSet *set)
+{
+    int scores[3];
+    volatile int sink = 0;
+    double start = GetMonotonicTime();
+    for(int i = 0; i < set->count; i++)
+    {
+        Evaluate(&set->boards[i], scores);
+        sink += scores[0];
+    }
+    double elapsed = GetMonotonicTime() - start;
+    printf("Evaluate():         %12.0f evals/s\n", set->count / elapsed);
+    (void)sink;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <command> <weights file> [options]\n", program);
+    printf("commands:\n");
+    printf("\tinit <file> [seed]:          write a network with random weights\n");
+    printf("\tbench <file> [positions]:    measure evaluations per second (default %d positions)\n", DEFAULT_POSITIONS);
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc < 2)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    char *command = nob_shift_args(&argc, &argv);
+    char *path    = nob_shift_args(&argc, &argv);
+
+    if(strcmp(command, "init") == 0)
+    {
+        uint64_t seed = (argc > 0) ? strtoull(nob_shift_args(&argc, &argv), NULL, 10) : 0;
+        if(!WriteRandomNNUE(path, seed))
+        {
+            fprintf(stderr, "could not write %s\n", path);
+            return 1;
+        }
+        printf("wrote %s\n", path);
+        return 0;
+    }
+
+    if(strcmp(command, "bench") == 0)
+    {
+        int positions = (argc > 0) ? atoi(nob_shift_args(&argc, &argv)) : DEFAULT_POSITIONS;
+        if(positions < 2) positions = 2;
+
+        NNUE *network = LoadNNUE(path);
+        if(network == NULL)
+        {
+            fprintf(stderr, "could not load %s, is it a weights file of this version?\n", path);
+            return 1;
+        }
+
+        PositionSet set = GeneratePositions(positions);
+        printf("%d positions\n", set.count);
+        Bench(network, &set, false);
+        Bench(network, &set, true);
+        BenchHandWritten(&set);
+
+        free(set.boards);
+        FreeNNUE(network);
+        return 0;
+    }
+
+    PrintUsage(program);
+    return 1;
+}
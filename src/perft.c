@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_HASH_MB 256
+#define MAX_DEPTH 32
+#define BATCH_GAME_LENGTH 150
+
+// the key is stored xor'd with the node count, an entry is only a hit when
+// both halves belong to the same store
+typedef struct {
+    uint64_t key;
+    uint64_t nodes;
+} PerftEntry;
+
+typedef struct {
+    PerftEntry *entries;
+    uint64_t mask;
+    uint64_t probes;
+    uint64_t hits;
+} PerftTable;
+
+static MoveList moveLists[MAX_DEPTH] = {0};
+
+bool InitPerftTable(PerftTable *table, size_t megabytes)
+{
+    size_t count = 1;
+    while(count * 2 * sizeof(PerftEntry) <= megabytes * 1024 * 1024) count *= 2;
+
+    *table = (PerftTable) { 0 };
+    table->entries = calloc(count, sizeof(PerftEntry));
+    if(table->entries == NULL) return false;
+    table->mask = count - 1;
+    return true;
+}
+
+static inline uint64_t PerftKey(uint64_t hash, int depth)
+{
+    return hash ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ULL);
+}
+
+bool ProbePerftTable(PerftTable *table, uint64_t key, uint64_t *nodes)
+{
+    PerftEntry entry = table->entries[key & table->mask];
+    table->probes++;
+    if((entry.key ^ entry.nodes) != key) return false;
+    table->hits++;
+    *nodes = entry.nodes;
+    return true;
+}
+
+void StorePerftTable(PerftTable *table, uint64_t key, uint64_t nodes)
+{
+    PerftEntry *entry = &table->entries[key & table->mask];
+    entry->key   = key ^ nodes;
+    entry->nodes = nodes;
+}
+
+uint64_t Perft(Board *board, int depth, PerftTable *table)
+{
+    // a hit skips the move generation too, at depth 1 the count is all there is to do
+    uint64_t key = PerftKey(board->hash, depth);
+    uint64_t nodes = 0;
+    if(depth > 1 && table != NULL && ProbePerftTable(table, key, &nodes)) return nodes;
+
+    MoveList *list = &moveLists[depth];
+    GenerateMoves(board, list);
+    if(depth == 1) return list->count;
+
+    for(int i = 0; i < list->count; i++)
+    {
+        Board child = *board;
+        MakeSearchMove(&child, list->moves[i]);
+        nodes += Perft(&child, depth-1, table);
+    }
+
+    if(table != NULL) StorePerftTable(table, key, nodes);
+    return nodes;
+}
+
+void Divide(Board *board, int depth, PerftTable *table)
+{
+    MoveList list = {0};
+    GenerateMoves(board, &list);
+
+    uint64_t total = 0;
+    for(int i = 0; i < list.count; i++)
+    {
+        Move move = list.moves[i];
+        Board child = *board;
+        MakeSearchMove(&child, move);
+
+        uint64_t nodes = (depth > 1) ? Perft(&child, depth-1, table) : 1;
+        total += nodes;
+        printf("%3d -> %3d (flag %d): %llu\n", move.start, move.target, move.flag, (unsigned long long)nodes);
+    }
+    printf("moves: %d, nodes: %llu\n", list.count, (unsigned long long)total);
+    free(list.moves);
+}
+
+static uint64_t NextRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// times GenerateMovesBatchParallel on positions from random games with 1, 2,
+// 4... threads up to maxThreads, every run has to give the same moves as
+// generating them one by one
+int BatchBench(int count, int maxThreads)
+{
+    Board *positions = calloc(count, sizeof(Board));
+    Board **boards = malloc(count * sizeof(Board *));
+    MoveList *expected = calloc(count, sizeof(MoveList));
+    MoveList *out = calloc(count, sizeof(MoveList));
+    MoveList moveList = {0};
+    uint64_t random = 1;
+
+    int filled = 0;
+    while(filled < count)
+    {
+        Board board = {0};
+        InitBoard(&board, DEFAULT_FEN);
+        for(int ply = 0; ply < BATCH_GAME_LENGTH && filled < count; ply++)
+        {
+            GenerateMoves(&board, &moveList);
+            if(moveList.count == 0) break;
+            MakeSearchMove(&board, moveList.moves[NextRandom(&random) % moveList.count]);
+            positions[filled] = board;
+            positions[filled].mapHistory = (BoardMapHistory) { 0 };
+            boards[filled] = &positions[filled];
+            filled++;
+        }
+        free(board.mapHistory.items);
+    }
+    for(int i = 0; i < count; i++) GenerateMoves(boards[i], &expected[i]);
+
+    printf("%d positions from random games, %d cores\n", count, GetCoreCount());
+    double single = 0;
+    bool ok = true;
+    for(int threads = 1; ; threads *= 2)
+    {
+        if(threads > maxThreads) threads = maxThreads;
+        ThreadPool *pool = CreateThreadPool(threads);
+        GenerateMovesBatchParallel(pool, boards, count, out);
+
+        // the best of a few runs, the first one also warms up the output lists
+        double best = 0;
+        for(int run = 0; run < 5; run++)
+        {
+            double start = GetMonotonicTime();
+            GenerateMovesBatchParallel(pool, boards, count, out);
+            double elapsed = GetMonotonicTime() - start;
+            if(run == 0 || elapsed < best) best = elapsed;
+        }
+        DestroyThreadPool(pool);
+        if(threads == 1) single = best;
+
+        int mismatches = 0;
+        for(int i = 0; i < count; i++)
+        {
+            bool same = out[i].count == expected[i].count && memcmp(out[i].moves, expected[i].moves, out[i].count * sizeof(Move)) == 0;
+            if(!same) mismatches++;
+        }
+        ok = ok && mismatches == 0;
+
+        printf("%3d threads: %.3fs, %10.0f positions/s, %.2fx one thread, %d mismatches\n",
+               threads, best, count / best, single / best, mismatches);
+        if(threads == maxThreads) break;
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        free(expected[i].moves);
+        free(out[i].moves);
+    }
+    free(expected);
+    free(out);
+    free(boards);
+    free(positions);
+    free(moveList.moves);
+    return ok ? 0 : 1;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <depth> [options]\n", program);
+    printf("       %s --batch <positions> [--threads <n>]\n", program);
+    printf("options:\n");
+    printf("\t--help:         print this message\n");
+    printf("\t--fen <fen>:    start from this position, lines may be separated with ';'\n");
+    printf("\t--hash <mb>:    size of the transposition table in megabytes (default %d)\n", DEFAULT_HASH_MB);
+    printf("\t--no-hash:      don't use a transposition table, used to verify results\n");
+    printf("\t--divide:       print the node count below every root move\n");
+    printf("\t--batch <n>:    time batch move generation on n positions with 1, 2, 4... threads instead\n");
+    printf("\t--threads <n>:  the most threads --batch tries (default one per core)\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc == 0)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    int depth = 0;
+    size_t hashSize = DEFAULT_HASH_MB;
+    bool useHash = true;
+    bool divide = false;
+    int batchCount = 0;
+    int batchThreads = 0;
+    char fen[512] = DEFAULT_FEN;
+
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--help") == 0)
+        {
+            PrintUsage(program);
+            return 0;
+        }
+        else if(strcmp(option, "--fen") == 0 && argc > 0)
+        {
+            char *arg = nob_shift_args(&argc, &argv);
+            strncpy(fen, arg, sizeof(fen)-1);
+            for(char *c = fen; *c != '\0'; c++) if(*c == ';') *c = '\n';
+        }
+        else if(strcmp(option, "--hash") == 0 && argc > 0)
+        {
+            hashSize = atoi(nob_shift_args(&argc, &argv));
+        }
+        else if(strcmp(option, "--no-hash") == 0) useHash = false;
+        else if(strcmp(option, "--divide") == 0)  divide = true;
+        else if(strcmp(option, "--batch") == 0 && argc > 0)   batchCount = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--threads") == 0 && argc > 0) batchThreads = atoi(nob_shift_args(&argc, &argv));
+        else depth = atoi(option);
+    }
+
+    if(batchCount > 0) return BatchBench(batchCount, (batchThreads > 0) ? batchThreads : GetCoreCount());
+
+    if(depth <= 0 || depth >= MAX_DEPTH)
+    {
+        fprintf(stderr, "depth must be between 1 and %d\n", MAX_DEPTH-1);
+        return 1;
+    }
+
+    Board board = {0};
+    if(InitBoard(&board, fen) != 0)
+    {
+        fprintf(stderr, "invalid fen\n");
+        return 1;
+    }
+
+    PerftTable table = {0};
+    PerftTable *Ptable = NULL;
+    if(useHash && hashSize > 0)
+    {
+        if(!InitPerftTable(&table, hashSize))
+        {
+            fprintf(stderr, "failed to allocate %zu MB for the hash table\n", hashSize);
+            return 1;
+        }
+        Ptable = &table;
+        printf("hash table: %llu entries\n", (unsigned long long)(table.mask + 1));
+    }
+
+    if(divide)
+    {
+        Divide(&board, depth, Ptable);
+        return 0;
+    }
+
+    for(int d = 1; d <= depth; d++)
+    {
+        double start = GetMonotonicTime();
+        uint64_t nodes = Perft(&board, d, Ptable);
+        double elapsed = GetMonotonicTime() - start;
+        double nps = (elapsed > 0) ? nodes / elapsed : 0;
+
+        printf("depth %2d: %14llu nodes %9.3fs %12.0f nps", d, (unsigned long long)nodes, elapsed, nps);
+        if(Ptable != NULL) printf("  hash hits %llu/%llu", (unsigned long long)table.hits, (unsigned long long)table.probes);
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,521 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#define DEFAULT_GAMES         600 // a multiple of 6, so every seat assignment plays every opening
+#define DEFAULT_MINUTES       10
+#define DEFAULT_INCREMENT     10
+#define DEFAULT_SCALE         0.01
+#define DEFAULT_OPENING_PLIES 8
+#define DEFAULT_HASH_MB       16
+#define MAX_PLAYERS           3
+#define MAX_ASSIGNMENTS       6
+#define ENGINE_TIMEOUT_MS     5000
+
+// self-play matches
+//
+// plays games between two or three players on every core, one game per
+// thread with single threaded players so the games don't take time from
+// each other. a player is one of the searches linked in here or the command
+// of an engine that speaks the text protocol of protocol.c, which is how a
+// new build gets played against an old one
+//
+// the seats rotate through every way of handing out the colours with each
+// player sitting at least once, and every assignment plays the same opening,
+// a few random legal moves from the start position, so neither the colour
+// nor the opening favours anyone. a game gives out one point, to the last
+// colour standing or split between the colours still in when it is drawn,
+// a player's score is its points per seat and a fair share is 1/3
+
+enum {
+    PLAYER_PARANOID,
+    PLAYER_BEST_REPLY,
+    PLAYER_MCTS,
+    PLAYER_PROCESS,
+};
+
+typedef struct {
+    char *spec; // as given on the command line, also its name in the results
+    int kind;
+    NNUE *network; // shared by all games, only read
+} Player;
+
+typedef struct {
+    int players[3];      // the player in every seat, indexed by colour >> 3 - 1
+    double points[3];
+    uint64_t nodes[3];
+    double thinkTime[3];
+    int plies;
+    int reason;          // EndFlag
+} GameRecord;
+
+typedef struct {
+    Player players[MAX_PLAYERS];
+    int playerCount;
+    int assignments[MAX_ASSIGNMENTS][3];
+    int assignmentCount;
+
+    int games;
+    double seconds;   // on every clock at the start
+    double increment;
+    int openingPlies;
+    uint64_t seed;
+    size_t hashMegabytes;
+    FILE *gamesFile;  // NULL when the games aren't written out
+
+    GameRecord *records;
+    atomic_int finished;
+} Match;
+
+// a player in one game, started for it and stopped after
+typedef struct {
+    Player *player;
+    Engine *engine;
+    EngineProcess *process;
+} Seat;
+
+static inline uint64_t NextRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool ParsePlayer(Player *player, char *spec)
+{
+    *player = (Player) { .spec = spec };
+    if(strcmp(spec, "paranoid") == 0)        player->kind = PLAYER_PARANOID;
+    else if(strcmp(spec, "best-reply") == 0) player->kind = PLAYER_BEST_REPLY;
+    else if(strcmp(spec, "mcts") == 0)       player->kind = PLAYER_MCTS;
+    else if(strncmp(spec, "nnue=", 5) == 0)
+    {
+        player->kind = PLAYER_PARANOID;
+        player->network = LoadNNUE(spec + 5);
+        if(player->network == NULL)
+        {
+            fprintf(stderr, "could not load the network %s\n", spec + 5);
+            return false;
+        }
+    }
+    else player->kind = PLAYER_PROCESS;
+    return true;
+}
+
+// every way to seat the players where each of them plays at least once
+static void BuildAssignments(Match *match)
+{
+    int count = match->playerCount;
+    for(int a = 0; a < count; a++)
+    for(int b = 0; b < count; b++)
+    for(int c = 0; c < count; c++)
+    {
+        if(count == 3 && (a == b || b == c || a == c)) continue;
+        if(count == 2 && a == b && b == c) continue;
+        int *assignment = match->assignments[match->assignmentCount++];
+        assignment[0] = a;
+        assignment[1] = b;
+        assignment[2] = c;
+    }
+}
+
+static bool StartSeat(Seat *seat, Player *player, size_t hashMegabytes)
+{
+    *seat = (Seat) { .player = player };
+    if(player->kind == PLAYER_MCTS) return true;
+    if(player->kind != PLAYER_PROCESS)
+    {
+        seat->engine = CreateEngine(hashMegabytes);
+        return seat->engine != NULL;
+    }
+
+    seat->process = StartEngine(player->spec);
+    if(seat->process == NULL) return false;
+
+    char line[4096];
+    bool ready = SendToEngine(seat->process, "protocol");
+    while(ready && (ready = ReadEngineLine(seat->process, line, sizeof(line), ENGINE_TIMEOUT_MS) == 1) && strcmp(line, "protocolok") != 0);
+
+    if(ready)
+    {
+        SendToEngine(seat->process, "setoption hash %zu", hashMegabytes);
+        SendToEngine(seat->process, "setoption threads 1");
+        SendToEngine(seat->process, "newgame");
+        ready = SendToEngine(seat->process, "isready");
+    }
+    while(ready && (ready = ReadEngineLine(seat->process, line, sizeof(line), ENGINE_TIMEOUT_MS) == 1) && strcmp(line, "readyok") != 0);
+
+    if(!ready)
+    {
+        StopEngine(seat->process);
+        seat->process = NULL;
+    }
+    return ready;
+}
+
+static void StopSeat(Seat *seat)
+{
+    if(seat->process != NULL) StopEngine(seat->process);
+    if(seat->engine != NULL)  DestroyEngine(seat->engine);
+}
+
+// the move of the seat on the board's clock, a null move when an engine
+// process didn't answer in time or with a legal move
+static Move Think(Seat *seat, Board *board, Nob_String_Builder *position, uint64_t *nodes)
+{
+    Player *player = seat->player;
+    *nodes = 0;
+    if(player->kind != PLAYER_MCTS && seat->engine == NULL && seat->process == NULL) return nullMove;
+    if(player->kind == PLAYER_MCTS)
+    {
+        MCTSLimits limits = { .threads = 1, .useClock = true, .memoryMegabytes = 64 };
+        MCTSResult result = SearchMCTS(board, limits);
+        *nodes = result.playouts;
+        return result.bestMove;
+    }
+
+    if(player->kind != PLAYER_PROCESS)
+    {
+        SearchLimits limits = {
+            .algorithm = (player->kind == PLAYER_BEST_REPLY) ? SEARCH_BEST_REPLY : SEARCH_PARANOID,
+            .threads   = 1,
+            .useClock  = true,
+            .network   = player->network,
+        };
+        SearchResult result = Search(seat->engine, board, limits);
+        *nodes = result.nodes;
+        return result.bestMove;
+    }
+
+    SendToEngine(seat->process, "%.*s", (int)position->count, position->items);
+    SendToEngine(seat->process, "go wtime %.0f gtime %.0f btime %.0f inc %.0f",
+                 board->clock.seconds[0] * 1000, board->clock.seconds[1] * 1000, board->clock.seconds[2] * 1000, board->clock.increment * 1000);
+
+    // a little past the clock, the caller sees it flagged
+    int index = (board->colourToMove >> 3) - 1;
+    double deadline = GetMonotonicTime() + board->clock.seconds[index] + 0.1;
+    char line[4096];
+    while(true)
+    {
+        int left = (int)((deadline - GetMonotonicTime()) * 1000);
+        if(left <= 0 || ReadEngineLine(seat->process, line, sizeof(line), left) != 1) return nullMove;
+
+        // the nodes of the last finished iteration stand for the whole search
+        char *nodesToken = strstr(line, " nodes ");
+        if(strncmp(line, "info ", 5) == 0 && nodesToken != NULL) *nodes = strtoull(nodesToken + 7, NULL, 10);
+        if(strncmp(line, "bestmove ", 9) != 0) continue;
+
+        char played[8] = "";
+        sscanf(line + 9, "%7s", played);
+        Move move;
+        return ParseProtocolMove(board, played, &move) ? move : nullMove;
+    }
+}
+
+// the move as start,target,flag after a space, the notation can't tell two
+// pieces that reach the same square apart and this replays exactly
+static void AppendMoveTriple(Nob_String_Builder *moves, Move move)
+{
+    char text[16];
+    snprintf(text, sizeof(text), " %d,%d,%d", move.start, move.target, move.flag);
+    nob_sb_append_cstr(moves, text);
+}
+
+// random legal moves from the start position, an opening where somebody
+// runs out of moves is thrown away for the next one
+static void PlayOpening(Match *match, int opening, Board *board, Nob_String_Builder *position, Nob_String_Builder *moves)
+{
+    static _Thread_local MoveList list = { 0 };
+    uint64_t random = match->seed ^ ((uint64_t)opening * 0xD6E8FEB86659FD93ULL);
+    while(true)
+    {
+        InitBoard(board, DEFAULT_FEN);
+        position->count = 0;
+        nob_sb_append_cstr(position, "position startpos moves");
+        moves->count = 0;
+
+        bool playable = true;
+        for(int ply = 0; ply < match->openingPlies && playable; ply++)
+        {
+            GenerateMoves(board, &list);
+            if(list.count == 0)
+            {
+                playable = false;
+                break;
+            }
+            Move move = list.moves[NextRandom(&random) % list.count];
+
+            char text[8] = " ";
+            FormatProtocolMove(move, &text[1]);
+            nob_sb_append_cstr(position, text);
+            AppendMoveTriple(moves, move);
+            MakeMove(board, move);
+        }
+        if(playable && HasLegalMove(board)) return;
+    }
+}
+
+static void PlayGame(void *arg, int gameIndex)
+{
+    Match *match = arg;
+    GameRecord *record = &match->records[gameIndex];
+    int *assignment = match->assignments[gameIndex % match->assignmentCount];
+
+    // a seat that didn't start loses on time
+    Seat seats[3] = { 0 };
+    for(int i = 0; i < 3; i++)
+    {
+        record->players[i] = assignment[i];
+        if(!StartSeat(&seats[i], &match->players[assignment[i]], match->hashMegabytes)) printf("%s did not start\n", match->players[assignment[i]].spec);
+    }
+
+    Board board = { 0 };
+    Nob_String_Builder position = { 0 };
+    Nob_String_Builder moves = { 0 };
+    PlayOpening(match, gameIndex / match->assignmentCount, &board, &position, &moves);
+    for(int i = 0; i < 3; i++) board.clock.seconds[i] = match->seconds;
+    board.clock.increment = match->increment;
+
+    bool out[3] = { false };
+    int winner = NONE;
+    while(true)
+    {
+        uint8_t colour = board.colourToMove;
+        int index = (colour >> 3) - 1;
+
+        if((board.fiftyMoveClock / 3) >= 50) record->reason = FIFTYRULE;
+        else if(IsRepetition(&board))        record->reason = REPETITION;
+        else if(IsInsufficientMaterial(&board)) record->reason = INSUFFMAT;
+        else record->reason = NOTHING;
+        if(record->reason != NOTHING) break;
+
+        // the first colour without moves is out, after that the game is over
+        bool noMoves = !HasLegalMove(&board);
+        bool checked = InCheck();
+        Move move = nullMove;
+        if(!noMoves)
+        {
+            double start = GetMonotonicTime();
+            uint64_t nodes;
+            move = Think(&seats[index], &board, &position, &nodes);
+            double time = GetMonotonicTime() - start;
+            record->nodes[index]     += nodes;
+            record->thinkTime[index] += time;
+            board.clock.seconds[index] -= time;
+            if(board.clock.seconds[index] <= 0) move = nullMove;
+        }
+
+        if(IsNullMove(move))
+        {
+            int reason = noMoves ? (checked ? CHECKMATE : STALEMATE) : TIMEOUT;
+            if(board.eliminatedColour != NONE && reason == STALEMATE)
+            {
+                record->reason = STALEMATE;
+                break;
+            }
+
+            out[index] = true;
+            record->reason = reason;
+            nob_sb_append_cstr(&moves, " xxx");
+            if(board.eliminatedColour != NONE)
+            {
+                for(int i = 0; i < 3; i++) if(!out[i]) winner = (i + 1) << 3;
+                break;
+            }
+
+            char token[] = { ' ', 'x', GetColourString(colour)[0], '\0' };
+            nob_sb_append_cstr(&position, token);
+            EliminateColour(&board, colour);
+            NextMove(&board);
+            continue;
+        }
+
+        board.clock.seconds[index] += board.clock.increment;
+        char text[8] = " ";
+        FormatProtocolMove(move, &text[1]);
+        nob_sb_append_cstr(&position, text);
+        AppendMoveTriple(&moves, move);
+        MakeMove(&board, move);
+        record->plies++;
+    }
+
+    // a draw splits the point between the colours still in
+    int standing = 0;
+    for(int i = 0; i < 3; i++) standing += !out[i];
+    for(int i = 0; i < 3; i++)
+    {
+        if(winner != NONE) record->points[i] = (winner == (i + 1) << 3) ? 1.0 : 0.0;
+        else record->points[i] = out[i] ? 0.0 : 1.0 / standing;
+    }
+
+    // one write per game, lines from different threads don't mix
+    if(match->gamesFile != NULL)
+    {
+        // the points of every colour as the last token, like 0-1-0 or 1/2-0-1/2
+        for(int i = 0; i < 3; i++)
+        {
+            nob_sb_append_cstr(&moves, (i == 0) ? " " : "-");
+            if(record->points[i] == 0 || record->points[i] == 1) nob_sb_append_cstr(&moves, (record->points[i] == 0) ? "0" : "1");
+            else nob_sb_append_cstr(&moves, (standing == 2) ? "1/2" : "1/3");
+        }
+        nob_sb_append_cstr(&moves, "\n");
+        fwrite(moves.items + 1, 1, moves.count - 1, match->gamesFile);
+    }
+
+    int finished = atomic_fetch_add(&match->finished, 1) + 1;
+    const char *result = (winner != NONE) ? GetColourString(winner) : "draw";
+    printf("game %4d/%d: %s, %s, %s: %s by %s after %d plies\n", finished, match->games,
+           match->players[assignment[0]].spec, match->players[assignment[1]].spec, match->players[assignment[2]].spec,
+           result, EndFlagString[record->reason], record->plies);
+    fflush(stdout);
+
+    free(moves.items);
+    free(position.items);
+    free(board.mapHistory.items);
+    for(int i = 0; i < 3; i++) StopSeat(&seats[i]);
+}
+
+// the score of every player is its points per seat over the games it
+// played, with a 95% interval from how much that varied from game to game
+static void PrintResults(Match *match, double wallTime)
+{
+    printf("===========================\n");
+    printf("%d games in %.1fs, %.2fs+%.2fs per colour\n", match->games, wallTime, match->seconds, match->increment);
+
+    uint64_t totalNodes = 0;
+    double totalTime = 0;
+    for(int p = 0; p < match->playerCount; p++)
+    {
+        int games = 0, seats = 0, wins = 0, draws = 0;
+        double points = 0, sum = 0, squares = 0, time = 0;
+        uint64_t nodes = 0;
+        for(int g = 0; g < match->games; g++)
+        {
+            GameRecord *record = &match->records[g];
+            int seated = 0;
+            double gamePoints = 0;
+            for(int i = 0; i < 3; i++)
+            {
+                if(record->players[i] != p) continue;
+                seated++;
+                gamePoints += record->points[i];
+                nodes += record->nodes[i];
+                time  += record->thinkTime[i];
+                if(record->points[i] == 1.0) wins++;
+                else if(record->points[i] > 0) draws++;
+            }
+            if(seated == 0) continue;
+
+            double score = gamePoints / seated;
+            games++;
+            seats  += seated;
+            points += gamePoints;
+            sum     += score;
+            squares += score * score;
+        }
+        if(games == 0) continue;
+
+        double mean = sum / games;
+        double variance = (games > 1) ? (squares - sum * mean) / (games - 1) : 0;
+        double interval = 1.96 * sqrt((variance > 0) ? variance / games : 0);
+        printf("%-24s %.3f +- %.3f per seat, %.1f points from %d seats (%d wins, %d draws), %.0f nodes/s\n",
+               match->players[p].spec, points / seats, interval, points, seats, wins, draws, (time > 0) ? nodes / time : 0.0);
+        totalNodes += nodes;
+        totalTime  += time;
+    }
+    printf("%llu nodes in %.1fs of thinking, %.0f nodes/s per game, %.0f nodes/s over all games\n",
+           (unsigned long long)totalNodes, totalTime, (totalTime > 0) ? totalNodes / totalTime : 0.0,
+           (wallTime > 0) ? totalNodes / wallTime : 0.0);
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s [options] <player> <player> [player]\n", program);
+    printf("players:\n");
+    printf("\tparanoid, best-reply or mcts: the searches in this build\n");
+    printf("\tnnue=<file>:                  the paranoid search evaluating with the network\n");
+    printf("\tanything else:                the command of an engine speaking the text protocol\n");
+    printf("options:\n");
+    printf("\t--games <n>:         games to play (default %d)\n", DEFAULT_GAMES);
+    printf("\t--tc <min>+<inc>:    the time control to scale (default %d+%d)\n", DEFAULT_MINUTES, DEFAULT_INCREMENT);
+    printf("\t--scale <f>:         factor for the clocks and the increment (default %g)\n", DEFAULT_SCALE);
+    printf("\t--opening-plies <n>: random moves before the players take over (default %d)\n", DEFAULT_OPENING_PLIES);
+    printf("\t--seed <n>:          picks the openings (default 1)\n");
+    printf("\t--hash <MB>:         table of every player in every game (default %d)\n", DEFAULT_HASH_MB);
+    printf("\t--concurrency <n>:   games at the same time, 0 for one per core (default 0)\n");
+    printf("\t--out <file>:        append the games as start,target,flag moves, one per line ending with the points of every colour\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    Match match = {
+        .games         = DEFAULT_GAMES,
+        .openingPlies  = DEFAULT_OPENING_PLIES,
+        .seed          = 1,
+        .hashMegabytes = DEFAULT_HASH_MB,
+    };
+    TimeControl timeControl = { .minutes = DEFAULT_MINUTES, .increment = DEFAULT_INCREMENT };
+    double scale = DEFAULT_SCALE;
+    int concurrency = 0;
+    char *outPath = NULL;
+
+    GenerateMoveData();
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--games") == 0 && argc > 0)              match.games = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--tc") == 0 && argc > 0)            sscanf(nob_shift_args(&argc, &argv), "%d+%d", &timeControl.minutes, &timeControl.increment);
+        else if(strcmp(option, "--scale") == 0 && argc > 0)         scale = atof(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--opening-plies") == 0 && argc > 0) match.openingPlies = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--seed") == 0 && argc > 0)          match.seed = strtoull(nob_shift_args(&argc, &argv), NULL, 10);
+        else if(strcmp(option, "--hash") == 0 && argc > 0)          match.hashMegabytes = strtoul(nob_shift_args(&argc, &argv), NULL, 10);
+        else if(strcmp(option, "--concurrency") == 0 && argc > 0)   concurrency = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--out") == 0 && argc > 0)           outPath = nob_shift_args(&argc, &argv);
+        else if(option[0] != '-' && match.playerCount < MAX_PLAYERS)
+        {
+            if(!ParsePlayer(&match.players[match.playerCount++], option)) return 1;
+        }
+        else
+        {
+            PrintUsage(program);
+            return 1;
+        }
+    }
+    if(match.playerCount < 2 || match.games <= 0)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    match.seconds   = timeControl.minutes * 60 * scale;
+    match.increment = timeControl.increment * scale;
+    if(outPath != NULL)
+    {
+        match.gamesFile = fopen(outPath, "a");
+        if(match.gamesFile == NULL)
+        {
+            fprintf(stderr, "could not open %s\n", outPath);
+            return 1;
+        }
+    }
+
+    BuildAssignments(&match);
+    match.records = calloc(match.games, sizeof(GameRecord));
+    ThreadPool *pool = CreateThreadPool(concurrency);
+    printf("%d games on %d threads, %d seat assignments per opening\n", match.games, ThreadPoolSize(pool), match.assignmentCount);
+
+    double start = GetMonotonicTime();
+    ParallelFor(pool, match.games, PlayGame, &match);
+    PrintResults(&match, GetMonotonicTime() - start);
+
+    DestroyThreadPool(pool);
+    if(match.gamesFile != NULL) fclose(match.gamesFile);
+    for(int i = 0; i < match.playerCount; i++) if(match.players[i].network != NULL) FreeNNUE(match.players[i].network);
+    free(match.records);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
@@ -15,6 +16,8 @@ bool keepRunning = true;
 #endif
 
 #define PLAYERS 3
+#define ENGINE_TIMEOUT_MS 5000
+#define BOT_HASH_MB 64
 
 typedef struct {
     Board board;
@@ -44,7 +47,60 @@ double pingTimer[PLAYERS];
 uint32_t pingData = 0;
 
 GameState gameState = NOGAME;
-MoveList legalMoves = {0};
+Tablebases *tablebases = NULL;
+
+// a seat played by an engine process or a bot, see SeatLoop
+typedef struct {
+    char *command; // the engine to run, NULL for a bot
+    Thread *thread;
+    EngineProcess *process;
+    atomic_bool leave;
+    atomic_bool finished;
+    // this end of the seat's connection, the server sees it as the peer of
+    // one of its clients. the address and the port together tell bots apart
+    // from people, a remote player may well use the same port
+    atomic_uint address;
+    atomic_int port;
+
+    // the replies the engine expects to its last move, see StartPondering
+    char ponderMoves[2][8];
+    int ponderMoveCount;
+    int answersOwed; // every go is answered by one bestmove, older ones are thrown away
+
+    // a bot thinks on the bot queue with these
+    Engine *engine;
+    Board board;
+    SearchLimits limits;
+    atomic_bool cancelled;
+    atomic_bool done;
+    Move move;
+} Seat;
+
+Seat engineSeats[PLAYERS];
+int engineSeatCount = 0;
+
+Seat botSeats[PLAYERS];
+double botWait   = -1;  // seconds someone waits before bots take the empty seats, negative for never
+double botBudget = 1.0; // seconds of one core a bot may think per move
+int botThreads   = 1;   // bots think on this many threads, however many there are
+int botAlgorithm = SEARCH_PARANOID;
+size_t botHash   = BOT_HASH_MB; // megabytes of the one table every bot searches on
+bool botHugePages = true;
+OpeningBook *botBook = NULL; // bots play from it while the position is in it
+int botGames = 0; // games the bots play among themselves before the server quits, 0 to wait for people
+TranspositionTable *botTable = NULL;
+JobQueue *botQueue = NULL;
+bool ponderSeats = false; // engine seats think on the opponents' time
+
+// how pondering went for one seat over a game
+typedef struct {
+    int ponders;
+    int hits;
+    double ponderedOnHits; // thinking done before the clock started
+    double hitReplyTime;
+    double otherReplyTime;
+    int otherReplies;
+} PonderStats;
 
 void Wait(double t);
 double GetTime();
@@ -52,8 +108,6 @@ int InitServer(Server *server);
 int AwaitPlayers(Server *server);
 void CloseServer(Server *server);
 void HandlePlayerMessage(Server *server, int *disconnectedIndices, int *PdisconnectedCount);
-bool IsInsufficientMaterial(Server *server);
-bool IsRepetition(Server *server);
 int GetWinner(Server *server);
 
 void SignalHandler(int _)
@@ -173,18 +227,7 @@ void HandlePlayerMessage(Server *server, int *disconnectedIndices, int *Pdisconn
                 }
 
                 Move playedMove = msg.playMove.move;
-                bool isLegal = false;
-                for(int i = 0; i < legalMoves.count; i++)
-                {
-                    Move move = legalMoves.moves[i];
-                    if(playedMove.start  != move.start)  continue;
-                    if(playedMove.target != move.target) continue;
-                    if(playedMove.flag   != move.flag)   continue;
-                    isLegal = true;
-                    break;
-                }
-
-                if(isLegal)
+                if(IsLegalMove(&server->board, playedMove))
                 {
                     IncrementClock(&server->board);
                     MakeMove(&server->board, playedMove);
@@ -373,8 +416,6 @@ void StartGame(Server *server, char *FEN)
     InitBoard(&server->board, FEN);
     InitClock(&server->board, timeControl);
 
-    GenerateMoves(&server->board, &legalMoves);
-
     for(int i = 0; i < 3; i++) 
     {
         server->rematch[i]    = false;
@@ -418,24 +459,22 @@ bool UpdateGame(Server *server, double deltaTime, struct EndOfGame *gameEnd)
             endReason = FIFTYRULE;
             isDraw = true;
         }
-        else if(IsRepetition(server))
+        else if(IsRepetition(&server->board))
         {
             endReason = REPETITION;
             isDraw = true;
         }
-        else if(IsInsufficientMaterial(server))
+        else if(IsInsufficientMaterial(&server->board))
         {
             endReason = INSUFFMAT;
             isDraw    = true;
         }
 
-        GenerateMoves(&server->board, &legalMoves);
-        if(legalMoves.count == 0)
+        if(!HasLegalMove(&server->board))
         {
             if(server->eliminatedPlayerCount == 0) 
             {
                 EliminatePlayer(server, playerIndex);
-                GenerateMoves(&server->board, &legalMoves);
             }
             else 
             {
@@ -451,6 +490,27 @@ bool UpdateGame(Server *server, double deltaTime, struct EndOfGame *gameEnd)
                 }
             }
         }
+        else if(endReason == -1 && server->eliminatedPlayerCount == 1 && tablebases != NULL)
+        {
+            // the two player endgame is decided already, no need to play it out
+            TBResult result;
+            bool decided = ProbeTablebases(tablebases, &server->board, &result);
+            // unless the fifty-move rule gets there before the mate
+            if(decided && result.wdl != 0 && FiftyMoveClockAfter(&server->board, result.dtm) / 3 >= 50) decided = false;
+            if(decided)
+            {
+                endReason = TABLEBASE;
+                if(result.wdl == 0) isDraw = true;
+                else if(result.wdl < 0) EliminatePlayer(server, playerIndex);
+                else
+                {
+                    for(int i = 0; i < server->playerCount; i++)
+                    {
+                        if(i != playerIndex && !server->eliminated[i]) EliminatePlayer(server, i);
+                    }
+                }
+            }
+        }
     }
 
     UpdateClock(&server->board, deltaTime);
@@ -518,87 +578,6 @@ int GetWinner(Server *server)
     return -1;
 }
 
-bool IsInsufficientMaterial(Server *server)
-{
-    bool allMoatsBridged = true;
-    for(int i = 0; i < 3; i++)
-    {
-        allMoatsBridged = allMoatsBridged && server->board.bridgedMoats[i];
-    }
-
-    for(int i = 0; i < server->playerCount; i++)
-    {
-        if(server->eliminated[i]) continue;
-        int colour = server->colour[i];
-
-        // a pawn can promote to a queen or rook
-        // even when all moats are bridged it is still theoretically possible to checkmate with a king and rook/queen
-        PieceList *pawns = GetPieceList(&server->board, colour | PAWN);
-        PieceList *rooks = GetPieceList(&server->board, colour | ROOK);
-        PieceList *queens = GetPieceList(&server->board, colour | QUEEN);
-        if((queens->count + rooks->count + pawns->count) >= 1) return false;
-
-        PieceList *knights = GetPieceList(&server->board, colour | KNIGHT);
-        PieceList *bishops = GetPieceList(&server->board, colour | BISHOP);
-
-        int darkBishopCount = 0;
-        int lightBishopCount = 0;
-        for(int i = 0; i < bishops->count; i++)
-        {
-            int square = bishops->pieces[i];
-            int rank = square / 24;
-            int file = square % 24;
-
-            bool isWhite = (rank+file)%2;
-            if(isWhite) lightBishopCount++;
-            else darkBishopCount++;
-        }
-
-        // when at least one moat is bridged it can be used as a wall just like the edge in normal chess
-        // this allows you to deliver checkmate with 2 knights, 2 bishops, or 1 knight + 1 bishop
-        if(!allMoatsBridged) 
-        {
-            if(knights->count >= 2) return false;
-            if(knights->count >= 1 && bishops->count >= 1) return false;
-            // if you have no knights you need at least 1 bishop on either colour square
-            if(lightBishopCount >= 1 && darkBishopCount >= 1) return false;
-        }
-        else 
-        {
-            // but when all moats are bridged it becomes more complicated
-            // at least 3 knights are sufficient to deliver checkmate
-            if(knights->count >= 3) return false;
-            // if you have at least 3 bishops you need at least 2 bishops on one colour square and 1 on the other
-            if(bishops->count >= 3 && lightBishopCount >= 1 && darkBishopCount >= 1) return false;
-            // if you have only 1 bishop you need at least 2 other knights
-            if(bishops->count == 1 && knights->count >= 2) return false;
-            // if you have only 1 knight you need at least 1 bishop on either colour square
-            if(knights->count == 1 && lightBishopCount >= 1 && darkBishopCount >= 1) return false;
-        }
-    }
-    return true;
-}
-
-bool IsRepetition(Server *server)
-{
-    Board *board = &server->board;
-    int duplicateCount = 0;
-
-    for(int i = 0; i < board->mapHistory.count; i++)
-    {
-        bool isEqual = true;
-        for(int j = 0; j < NOB_ARRAY_LEN(board->map); j++)
-        {
-            BoardMap *map = &board->mapHistory.items[i];
-            isEqual = isEqual && (board->map[j] == (*map)[j]);
-            if(!isEqual) break;
-        }
-        if(isEqual) duplicateCount++;
-    }
-
-    return duplicateCount >= 3;
-}
-
 void CloseServer(Server *server)
 {
     printf("closing server!\n");
@@ -642,25 +621,588 @@ double GetTime()
     #endif
 }
 
-int main()
+// waits for the engine to finish its handshake and measures how long a line
+// takes to go to the engine and back
+bool EngineHandshake(EngineProcess *engine, char *command)
+{
+    char line[4096];
+    char name[256] = "";
+    if(!SendToEngine(engine, "protocol")) return false;
+    while(true)
+    {
+        if(ReadEngineLine(engine, line, sizeof(line), ENGINE_TIMEOUT_MS) != 1) return false;
+        if(strncmp(line, "id name ", 8) == 0) snprintf(name, sizeof(name), "%.255s", line + 8);
+        if(strcmp(line, "protocolok") == 0) break;
+    }
+
+    int roundTrips = 100;
+    double start = GetMonotonicTime();
+    for(int i = 0; i < roundTrips; i++)
+    {
+        if(!SendToEngine(engine, "isready")) return false;
+        do {
+            if(ReadEngineLine(engine, line, sizeof(line), ENGINE_TIMEOUT_MS) != 1) return false;
+        } while(strcmp(line, "readyok") != 0);
+    }
+    printf("engine %s (%s) is ready, %.1fus per round trip\n", name, command, (GetMonotonicTime() - start) / roundTrips * 1000000);
+    return true;
+}
+
+bool StartSeatPlayer(Seat *seat)
+{
+    if(seat->command == NULL)
+    {
+        seat->engine = CreateSharingEngine(botTable);
+        return seat->engine != NULL;
+    }
+
+    seat->answersOwed = 0;
+    seat->process = StartEngine(seat->command);
+    if(seat->process != NULL && EngineHandshake(seat->process, seat->command)) return true;
+    printf("engine %s did not start\n", seat->command);
+    return false;
+}
+
+void StopSeatPlayer(Seat *seat)
+{
+    if(seat->process != NULL) StopEngine(seat->process);
+    if(seat->engine != NULL)  DestroyEngine(seat->engine);
+    seat->process = NULL;
+    seat->engine  = NULL;
+}
+
+// runs on the bot queue, a search that was cancelled before it started is skipped
+void BotThink(void *arg)
+{
+    Seat *seat = arg;
+    seat->move = nullMove;
+    if(!atomic_load(&seat->cancelled))
+    {
+        SearchResult result = Search(seat->engine, &seat->board, seat->limits);
+        seat->move = result.bestMove;
+    }
+    atomic_store(&seat->done, true);
+}
+
+// an engine gets the whole game as a position command, a bot a copy of the
+// board. the bot budgets its time from the clock like an engine would, but
+// never thinks longer than botBudget seconds of one core. a book move is
+// played without thinking
+void StartThinking(Seat *seat, Board *board, Nob_String_Builder *position)
+{
+    if(seat->process != NULL)
+    {
+        SendToEngine(seat->process, "%.*s", (int)position->count, position->items);
+        SendToEngine(seat->process, "go wtime %.0f gtime %.0f btime %.0f inc %.0f",
+                     board->clock.seconds[0] * 1000, board->clock.seconds[1] * 1000, board->clock.seconds[2] * 1000, board->clock.increment * 1000);
+        seat->answersOwed++;
+        return;
+    }
+
+    Move bookMove;
+    if(botBook != NULL && PickBookMove(botBook, board, rand(), &bookMove))
+    {
+        seat->move = bookMove;
+        atomic_store(&seat->cancelled, false);
+        atomic_store(&seat->done, true);
+        return;
+    }
+
+    seat->board = *board;
+    seat->board.mapHistory = (BoardMapHistory) { 0 };
+    seat->limits = (SearchLimits) {
+        .algorithm = botAlgorithm,
+        .threads   = 1,
+        .useClock  = true,
+        .timeLimit = botBudget,
+    };
+    atomic_store(&seat->cancelled, false);
+    atomic_store(&seat->done, false);
+    SubmitJob(botQueue, BotThink, seat);
+}
+
+// returns 1 with the chosen move, a null move if it wasn't legal, 0 while
+// still thinking and -1 when the engine is gone
+int PollThinking(Seat *seat, Board *board, Move *move)
+{
+    if(seat->process != NULL)
+    {
+        char line[4096];
+        int rc = ReadEngineLine(seat->process, line, sizeof(line), 1);
+        if(rc <= 0) return rc;
+        if(strncmp(line, "bestmove ", 9) != 0) return 0;
+        if(--seat->answersOwed > 0) return 0;
+
+        char played[8] = "";
+        int count = sscanf(line + 9, "%7s ponder %7s %7s", played, seat->ponderMoves[0], seat->ponderMoves[1]);
+        seat->ponderMoveCount = (count > 1) ? count - 1 : 0;
+        if(ParseProtocolMove(board, played, move)) return 1;
+
+        printf("engine %s played %s, which isn't legal\n", seat->command, played);
+        *move = nullMove;
+        return 1;
+    }
+
+    if(!atomic_load(&seat->done))
+    {
+        Wait(0.001);
+        return 0;
+    }
+    *move = seat->move;
+    return 1;
+}
+
+// stops the thinking and throws the move away
+void StopThinking(Seat *seat)
+{
+    if(seat->process != NULL)
+    {
+        char line[4096];
+        SendToEngine(seat->process, "stop");
+        while(seat->answersOwed > 0 && ReadEngineLine(seat->process, line, sizeof(line), ENGINE_TIMEOUT_MS) == 1)
+        {
+            if(strncmp(line, "bestmove", 8) == 0) seat->answersOwed--;
+        }
+        return;
+    }
+
+    // the search clears its stop flag when it starts, so keep asking until it is done
+    atomic_store(&seat->cancelled, true);
+    while(!atomic_load(&seat->done))
+    {
+        StopSearch(seat->engine);
+        Wait(0.001);
+    }
+}
+
+// lets the engine think about the position after the moves it predicted
+// while the opponents play them, returns false when there is nothing to
+// ponder on. the moves must lead back to the seat's turn
+bool StartPondering(Seat *seat, uint8_t colour, Board *board, Nob_String_Builder *position, Move predicted[2], int *predictedCount)
+{
+    if(!ponderSeats || seat->process == NULL || seat->ponderMoveCount == 0) return false;
+
+    Board after = *board;
+    for(int i = 0; i < seat->ponderMoveCount; i++)
+    {
+        if(!ParseProtocolMove(&after, seat->ponderMoves[i], &predicted[i])) return false;
+        MakeSearchMove(&after, predicted[i]);
+    }
+    if(after.colourToMove != colour || !HasLegalMove(&after)) return false;
+    *predictedCount = seat->ponderMoveCount;
+
+    SendToEngine(seat->process, "%.*s %s %s", (int)position->count, position->items,
+                 seat->ponderMoves[0], (seat->ponderMoveCount > 1) ? seat->ponderMoves[1] : "");
+    SendToEngine(seat->process, "go ponder wtime %.0f gtime %.0f btime %.0f inc %.0f",
+                 board->clock.seconds[0] * 1000, board->clock.seconds[1] * 1000, board->clock.seconds[2] * 1000, board->clock.increment * 1000);
+    seat->answersOwed++;
+    return true;
+}
+
+static inline bool SameMove(Move a, Move b)
+{
+    return a.start == b.start && a.target == b.target && a.flag == b.flag;
+}
+
+static void RememberSeatEnd(Seat *seat, Socket *sock)
+{
+    atomic_store(&seat->address, LocalAddress(sock));
+    atomic_store(&seat->port, LocalPort(sock));
+}
+
+// a seat joins over loopback like any other client, so the rest of the server
+// doesn't know the difference, and plays the moves its engine process or bot
+// comes up with
+void SeatLoop(void *arg)
+{
+    Seat *seat = arg;
+    char *name = (seat->command != NULL) ? seat->command : "bot";
+    if(!StartSeatPlayer(seat))
+    {
+        StopSeatPlayer(seat);
+        atomic_store(&seat->finished, true);
+        return;
+    }
+
+    Socket *sock = JoinGame("127.0.0.1", PORT);
+    if(sock != NULL) RememberSeatEnd(seat, sock);
+    Board board = { 0 };
+    Nob_String_Builder position = { 0 };
+    uint8_t colour = 0;
+    bool playing  = false;
+    bool thinking = false;
+    bool moveSent = false;
+
+    bool pondering = false;
+    bool ponderHit = false; // the move being thought about was pondered on
+    Move predicted[2];
+    int predictedCount = 0;
+    int predictedPlayed = 0;
+    double ponderStart = 0;
+    double thinkStart = 0;
+    PonderStats stats = { 0 };
+
+    while(keepRunning && sock != NULL && !atomic_load(&seat->leave))
+    {
+        PollFd poller = { .sock = sock, .events = PollRead };
+        Message msg = { 0 };
+        if(Poll(&poller, 1, thinking ? 0 : 10) > 0 && (poller.revents & PollRead) != 0)
+        {
+            if(Read(sock, &msg, sizeof(msg)) <= 0) break;
+
+            // anything that changes the board makes the move being thought about useless
+            if((thinking || pondering) && (msg.flag == ELIMINATED || msg.flag == ENDOFGAME || msg.flag == GAMESTART))
+            {
+                StopThinking(seat);
+                thinking  = false;
+                pondering = false;
+            }
+
+            // so does any other move than the predicted one
+            if(pondering && msg.flag == MOVEPLAYED && !SameMove(msg.movePlayed.move, predicted[predictedPlayed++]))
+            {
+                StopThinking(seat);
+                pondering = false;
+            }
+
+            switch(msg.flag)
+            {
+                case GAMESTART: {
+                    colour   = msg.gameStart.colour;
+                    playing  = true;
+                    moveSent = false;
+                    InitBoard(&board, msg.gameStart.FEN);
+                    InitClock(&board, msg.gameStart.timeControl);
+
+                    char FEN[256];
+                    FormatProtocolFen(msg.gameStart.FEN, FEN, sizeof(FEN));
+                    position.count = 0;
+                    nob_sb_append_cstr(&position, "position fen ");
+                    nob_sb_append_cstr(&position, FEN);
+                    nob_sb_append_cstr(&position, " moves");
+                    if(seat->process != NULL) SendToEngine(seat->process, "newgame");
+                    else ClearEngine(seat->engine);
+                    stats = (PonderStats) { 0 };
+                }; break;
+                case MOVEPLAYED: {
+                    char move[8] = " ";
+                    FormatProtocolMove(msg.movePlayed.move, &move[1]);
+                    nob_sb_append_cstr(&position, move);
+                    uint8_t mover = board.colourToMove;
+                    SetClock(&board, mover, msg.movePlayed.clockTime);
+                    MakeMove(&board, msg.movePlayed.move);
+                    moveSent = false;
+
+                    if(pondering && predictedPlayed == predictedCount)
+                    {
+                        SendToEngine(seat->process, "ponderhit");
+                        pondering  = false;
+                        thinking   = true;
+                        ponderHit  = true;
+                        thinkStart = GetMonotonicTime();
+                        stats.hits++;
+                        stats.ponderedOnHits += thinkStart - ponderStart;
+                    }
+                    else if(mover == colour && playing && StartPondering(seat, colour, &board, &position, predicted, &predictedCount))
+                    {
+                        pondering = true;
+                        predictedPlayed = 0;
+                        ponderStart = GetMonotonicTime();
+                        stats.ponders++;
+                    }
+                }; break;
+                case ELIMINATED: {
+                    uint8_t eliminated = msg.eliminated.colour;
+                    char token[] = { ' ', 'x', GetColourString(eliminated)[0], '\0' };
+                    nob_sb_append_cstr(&position, token);
+                    SetClock(&board, eliminated, msg.eliminated.clockTime);
+                    EliminateColour(&board, eliminated);
+                    if(board.colourToMove == eliminated) NextMove(&board);
+                    if(eliminated == colour) playing = false;
+                    moveSent = false;
+                }; break;
+                case ENDOFGAME: {
+                    playing = false;
+                    if(stats.ponders > 0)
+                    {
+                        printf("%s: %d of %d ponders hit (%.0f%%), %.1fs of thinking done on the opponents' time, "
+                               "replies took %.2fs after a hit and %.2fs otherwise\n",
+                               name, stats.hits, stats.ponders, 100.0 * stats.hits / stats.ponders, stats.ponderedOnHits,
+                               (stats.hits > 0) ? stats.hitReplyTime / stats.hits : 0.0,
+                               (stats.otherReplies > 0) ? stats.otherReplyTime / stats.otherReplies : 0.0);
+                    }
+                    Message response = { .flag = REMATCH, .rematch.agree = true };
+                    Write(sock, &response, sizeof(response));
+                }; break;
+                case PING: {
+                    Message response = { .flag = PING, .ping.data = msg.ping.data };
+                    Write(sock, &response, sizeof(response));
+                }; break;
+                case GAMEINPROGRESS: {
+                    // engines wait for the next game, bots are only wanted for this one
+                    Close(sock);
+                    sock = NULL;
+                    if(seat->process != NULL)
+                    {
+                        Wait(0.5);
+                        sock = JoinGame("127.0.0.1", PORT);
+                        if(sock != NULL) RememberSeatEnd(seat, sock);
+                    }
+                }; break;
+                case GOODBYE: {
+                    Close(sock);
+                    sock = NULL;
+                }; break;
+            }
+            if(sock == NULL) break;
+        }
+
+        // without a legal move the server is about to eliminate us
+        if(playing && !thinking && !moveSent && board.colourToMove == colour && HasLegalMove(&board))
+        {
+            StartThinking(seat, &board, &position);
+            thinking   = true;
+            ponderHit  = false;
+            thinkStart = GetMonotonicTime();
+        }
+
+        // nothing but info comes while pondering, it only has to be kept from filling the pipe
+        char line[4096];
+        if(pondering) while(ReadEngineLine(seat->process, line, sizeof(line), 0) == 1)
+        {
+            if(strncmp(line, "bestmove", 8) == 0) seat->answersOwed--;
+        }
+
+        if(thinking)
+        {
+            Move move;
+            int rc = PollThinking(seat, &board, &move);
+            if(rc < 0) break;
+            if(rc == 1)
+            {
+                thinking = false;
+                double replyTime = GetMonotonicTime() - thinkStart;
+                if(ponderHit) stats.hitReplyTime += replyTime;
+                else
+                {
+                    stats.otherReplyTime += replyTime;
+                    stats.otherReplies++;
+                }
+
+                if(!IsNullMove(move))
+                {
+                    Message response = { .flag = PLAYMOVE, .playMove.move = move };
+                    Write(sock, &response, sizeof(response));
+                    moveSent = true;
+                }
+            }
+        }
+    }
+
+    if(thinking || pondering) StopThinking(seat);
+    if(sock != NULL) Close(sock);
+    StopSeatPlayer(seat);
+    free(position.items);
+    free(board.mapHistory.items);
+    printf("%s left\n", name);
+    atomic_store(&seat->finished, true);
+}
+
+// the players that are not bots, engine seats count as players
+int CountPeople(Server *server)
+{
+    int people = 0;
+    for(int i = 0; i < server->playerCount; i++)
+    {
+        uint32_t address = PeerAddress(server->clients[i]);
+        int port = PeerPort(server->clients[i]);
+        bool bot = false;
+        for(int j = 0; j < PLAYERS; j++)
+        {
+            bot = bot || (botSeats[j].thread != NULL
+                       && atomic_load(&botSeats[j].address) == address
+                       && atomic_load(&botSeats[j].port) == port);
+        }
+        if(!bot) people++;
+    }
+    return people;
+}
+
+// fills the empty seats with bots once someone waited botWait seconds for a
+// game, and sends the bots away again when nobody is left to play with unless
+// they are there to play botGames games on their own
+void UpdateBots(Server *server, double deltaTime)
+{
+    static double waited = 0;
+
+    int activeBots = 0;
+    for(int i = 0; i < PLAYERS; i++)
+    {
+        Seat *seat = &botSeats[i];
+        if(seat->thread == NULL) continue;
+        if(atomic_load(&seat->finished))
+        {
+            JoinThread(seat->thread);
+            *seat = (Seat) { 0 };
+        }
+        else activeBots++;
+    }
+
+    if(gameState == YESGAME)
+    {
+        waited = 0;
+        return;
+    }
+
+    int people = CountPeople(server);
+    if(people == 0 && botGames == 0)
+    {
+        for(int i = 0; i < PLAYERS; i++) if(botSeats[i].thread != NULL) atomic_store(&botSeats[i].leave, true);
+        waited = 0;
+        return;
+    }
+
+    // bots that are started but not accepted yet
+    int joiningBots = activeBots - (server->playerCount - people);
+    if(server->playerCount + joiningBots >= PLAYERS)
+    {
+        waited = 0;
+        return;
+    }
+
+    waited += deltaTime;
+    if(waited < botWait) return;
+    waited = 0;
+
+    for(int i = 0; i < PLAYERS && server->playerCount + joiningBots < PLAYERS; i++)
+    {
+        if(botSeats[i].thread != NULL) continue;
+        botSeats[i].thread = StartThread(SeatLoop, &botSeats[i]);
+        if(botSeats[i].thread != NULL) joiningBots++;
+    }
+    printf("filled the empty seats with bots\n");
+}
+
+// the bots search the same positions a move apart, this shows how much of
+// that the shared table catches
+void PrintBotTableStats()
+{
+    TTStats stats;
+    GetTranspositionStats(botTable, &stats);
+    if(stats.probes == 0) return;
+    printf("bot table: %zuMB, %.0f%% used, %.1f%% of %llu probes hit, %.1f%% collided, %.1f%% of %llu stores replaced a current entry\n",
+           stats.megabytes, 100 * stats.usage,
+           100.0 * stats.hits / stats.probes, (unsigned long long)stats.probes,
+           100.0 * stats.collisions / stats.probes,
+           (stats.stores > 0) ? 100.0 * stats.replacements / stats.stores : 0.0, (unsigned long long)stats.stores);
+    // a shared hit is a position only a bot of another colour had searched
+    printf("bot table: %.1f%% of probes found a move of another bot, %.1f%% of %llu evaluations were cached\n",
+           100.0 * stats.sharedHits / stats.probes,
+           (stats.evalProbes > 0) ? 100.0 * stats.evalHits / stats.evalProbes : 0.0, (unsigned long long)stats.evalProbes);
+}
+
+void PrintUsage(char *program)
 {
+    printf("usage: %s [options]\n", program);
+    printf("options:\n");
+    printf("\t--help:                   print this message\n");
+    printf("\t--tablebases <directory>: adjudicate two player endgames found in these tables\n");
+    printf("\t--engine <command>:       fill a seat with an engine process speaking the engine protocol, up to %d times\n", PLAYERS);
+    printf("\t--ponder:                 let engine seats think while their opponents do\n");
+    printf("\t--bots <seconds>:         fill the empty seats with bots after someone waited this long\n");
+    printf("\t--bot-budget <seconds>:   seconds of one core a bot may think per move (default %.1f)\n", botBudget);
+    printf("\t--bot-threads <n>:        threads all bots share, 0 for one per core (default %d)\n", botThreads);
+    printf("\t--bot-algorithm <name>:   paranoid or best-reply (default paranoid)\n");
+    printf("\t--bot-hash <megabytes>:   size of the transposition table all bots share (default %d)\n", BOT_HASH_MB);
+    printf("\t--no-huge-pages:          keep the bot table on normal pages\n");
+    printf("\t--book <file>:            let the bots play from an opening book made by the book tool\n");
+    printf("\t--bot-games <n>:          let three bots play n games among themselves, then quit\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--tablebases") == 0 && argc > 0)
+        {
+            tablebases = OpenTablebases(nob_shift_args(&argc, &argv));
+        }
+        else if(strcmp(option, "--engine") == 0 && argc > 0 && engineSeatCount < PLAYERS)
+        {
+            engineSeats[engineSeatCount++].command = nob_shift_args(&argc, &argv);
+        }
+        else if(strcmp(option, "--ponder") == 0)                  ponderSeats = true;
+        else if(strcmp(option, "--bots") == 0 && argc > 0)        botWait    = atof(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--bot-budget") == 0 && argc > 0)  botBudget  = atof(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--bot-threads") == 0 && argc > 0) botThreads = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--bot-algorithm") == 0 && argc > 0 && (botAlgorithm = ParseSearchAlgorithm(argv[0])) >= 0)
+        {
+            nob_shift_args(&argc, &argv);
+        }
+        else if(strcmp(option, "--bot-hash") == 0 && argc > 0)    botHash    = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--no-huge-pages") == 0)           botHugePages = false;
+        else if(strcmp(option, "--bot-games") == 0 && argc > 0)   botGames   = atoi(nob_shift_args(&argc, &argv));
+        else if(strcmp(option, "--book") == 0 && argc > 0)
+        {
+            char *path = nob_shift_args(&argc, &argv);
+            botBook = LoadOpeningBook(path);
+            if(botBook == NULL)
+            {
+                printf("could not load opening book %s\n", path);
+                return 1;
+            }
+        }
+        else
+        {
+            PrintUsage(program);
+            return strcmp(option, "--help") == 0 ? 0 : 1;
+        }
+    }
+
     #if defined(_WIN32)
         AllocConsole();
         freopen("CONOUT$", "w", stdout);
     #elif defined(__GNUC__)
         signal(SIGQUIT, SignalHandler);
+        // an engine that quits would otherwise take the server with it
+        signal(SIGPIPE, SIG_IGN);
     #endif
     signal(SIGINT,  SignalHandler);
     signal(SIGTERM, SignalHandler);
 
+    if(botGames > 0 && botWait < 0) botWait = 0;
+
     srand(time(NULL));
     InitSockets();
     Server server;
 
     if(InitServer(&server) != 0) return 1;
 
+    // the seats connect like clients, so the server has to listen first
+    if(engineSeatCount > 0 || botWait >= 0)
+    {
+        if(!Listen(server.serverSock, 3)) return 1;
+        // the move tables are built on first use, not by every seat at once
+        GenerateMoveData();
+        InitEvaluation();
+        for(int i = 0; i < engineSeatCount; i++) engineSeats[i].thread = StartThread(SeatLoop, &engineSeats[i]);
+        if(botWait >= 0)
+        {
+            botQueue = CreateJobQueue(botThreads);
+            botTable = CreateTranspositionTable(botHash, botHugePages);
+            if(botTable == NULL)
+            {
+                printf("could not allocate %zuMB for the bots\n", botHash);
+                return 1;
+            }
+        }
+    }
+
     Message message = { 0 };
     struct EndOfGame gameEnd = { 0 };
+    int gamesPlayed = 0;
 
     double prevFrameStart = 0;
     while(keepRunning)
@@ -696,7 +1238,10 @@ int main()
                        EndFlagString[gameEnd.reason], 
                        (gameEnd.winner == 0) ? "no one" : GetColourString(gameEnd.winner)
                 );
+                if(botTable != NULL) PrintBotTableStats();
                 gameState = AWAITINGREMATCH;
+                gamesPlayed++;
+                if(botGames > 0 && gamesPlayed >= botGames) keepRunning = false;
 
                 message.flag = ENDOFGAME;
                 message.endOfGame = gameEnd;
@@ -727,12 +1272,19 @@ int main()
             }
         }
 
+        if(botWait >= 0) UpdateBots(&server, deltaTime);
+
         double end = GetTime();
         double diff = end-start;
         Wait(target-diff);
     }
 
     CloseServer(&server);
+    for(int i = 0; i < engineSeatCount; i++) if(engineSeats[i].thread != NULL) JoinThread(engineSeats[i].thread);
+    for(int i = 0; i < PLAYERS; i++) if(botSeats[i].thread != NULL) JoinThread(botSeats[i].thread);
+    if(botQueue != NULL) DestroyJobQueue(botQueue);
+    if(botTable != NULL) DestroyTranspositionTable(botTable);
+    if(tablebases != NULL) CloseTablebases(tablebases);
     
     CleanupSockets();
     return 0;
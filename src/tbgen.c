@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+// retrograde tablebase generator
+//
+// the first pass finds mates and stalemates and looks up every capture in the
+// smaller tables, which are generated first. after that pass n walks back
+// from the positions decided in pass n-1: a position that can move into a
+// loss in n-1 wins in n, one whose every move hands the opponent a win, the
+// longest of them in n-1, loses in n. a result that only becomes final in a
+// later pass because of a capture waits in a bucket for that pass
+
+#define CHUNK_SIZE 4096
+#define MAX_DTM    252
+
+// generation only values, the file gets 0 for illegal and 1 for draws
+#define ENTRY_UNKNOWN 0
+#define ENTRY_ILLEGAL 255
+
+typedef struct {
+    uint64_t index;
+    int pass;
+} Deferred;
+
+typedef struct {
+    Deferred *items;
+    size_t count;
+    size_t capacity;
+} DeferredList;
+
+typedef struct {
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} IndexList;
+
+typedef struct {
+    TBMaterial material;
+    Tablebases *subtables;
+    uint8_t *entries;
+    uint64_t size;
+    uint64_t sideSize; // positions per side to move
+    int pass;
+    atomic_uint_fast64_t changed;
+    DeferredList *deferred; // one per chunk so the workers never share one
+    IndexList buckets[MAX_DTM+1];
+} Generator;
+
+// every square a piece type can come from to reach a square on an empty
+// board with all moats bridged, a superset that IsLegalMove narrows down
+static uint8_t originSquares[8][144][192];
+static uint8_t originCount[8][144];
+
+static void AddOrigin(int type, int start, int target)
+{
+    for(int i = 0; i < originCount[type][target]; i++) if(originSquares[type][target][i] == start) return;
+    originSquares[type][target][originCount[type][target]++] = start;
+}
+
+static void GenerateOrigins()
+{
+    for(int start = 0; start < 144; start++)
+    {
+        for(int dir = 0; dir < 8; dir++)
+        {
+            Move step = moves[start][dir][0];
+            if(!IsNullMove(step)) AddOrigin(KING, start, step.target);
+
+            Move jump = knightMoves[start][dir];
+            if(!IsNullMove(jump)) AddOrigin(KNIGHT, start, jump.target);
+
+            for(int i = 0; i < 24; i++)
+            {
+                Move move = moves[start][dir][i];
+                if(IsNullMove(move)) break;
+                AddOrigin(dir < 4 ? ROOK : BISHOP, start, move.target);
+                AddOrigin(QUEEN, start, move.target);
+            }
+        }
+    }
+}
+
+static inline uint8_t EncodeDtm(int dtm)
+{
+    return 2 + dtm;
+}
+
+static void Defer(Generator *generator, int chunk, uint64_t index, int pass)
+{
+    if(pass > MAX_DTM) return;
+    nob_da_append(&generator->deferred[chunk], ((Deferred) { .index = index, .pass = pass }));
+}
+
+// the result of the position after a move, from the point of view of its colour to move
+static bool ChildResult(Generator *generator, Board *child, bool capture, TBResult *result)
+{
+    if(capture) return ProbeTablebases(generator->subtables, child, result);
+
+    // without a capture the position stays in this table and BLACK stays eliminated
+    uint8_t entry = generator->entries[TablebaseIndex(&generator->material, child)];
+    if(entry == ENTRY_UNKNOWN || entry == ENTRY_ILLEGAL) return false;
+    return DecodeTablebaseEntry(entry, result);
+}
+
+static void InitialiseChunk(void *arg, int chunk)
+{
+    Generator *generator = arg;
+    static _Thread_local MoveList moveList = { 0 };
+    uint64_t start = (uint64_t)chunk * CHUNK_SIZE;
+    uint64_t end = (start + CHUNK_SIZE < generator->size) ? start + CHUNK_SIZE : generator->size;
+
+    for(uint64_t index = start; index < end; index++)
+    {
+        Board board;
+        if(!TablebaseBoard(&generator->material, index, &board))
+        {
+            generator->entries[index] = ENTRY_ILLEGAL;
+            continue;
+        }
+
+        // the colour that just moved can't be left in check
+        Board other = board;
+        other.colourToMove = (board.colourToMove == WHITE) ? GRAY : WHITE;
+        GenerateMoves(&other, &moveList);
+        if(InCheck())
+        {
+            generator->entries[index] = ENTRY_ILLEGAL;
+            continue;
+        }
+
+        GenerateMoves(&board, &moveList);
+        if(moveList.count == 0)
+        {
+            generator->entries[index] = InCheck() ? EncodeDtm(0) : 1;
+            continue;
+        }
+        generator->entries[index] = ENTRY_UNKNOWN;
+
+        // captures leave the table, their results are known already
+        int quietMoves = 0, shortestLoss = -1, longestWin = -1;
+        bool draw = false;
+        for(int i = 0; i < moveList.count; i++)
+        {
+            Move move = moveList.moves[i];
+            if(board.map[move.target] == NONE)
+            {
+                quietMoves++;
+                continue;
+            }
+
+            Board child = board;
+            MakeSearchMove(&child, move);
+            TBResult result;
+            if(!ProbeTablebases(generator->subtables, &child, &result) || result.wdl == 0) draw = true;
+            else if(result.wdl < 0 && (shortestLoss < 0 || result.dtm < shortestLoss)) shortestLoss = result.dtm;
+            else if(result.wdl > 0 && result.dtm > longestWin) longestWin = result.dtm;
+        }
+
+        if(shortestLoss >= 0) Defer(generator, chunk, index, shortestLoss + 1);
+        else if(quietMoves == 0 && !draw) Defer(generator, chunk, index, longestWin + 1);
+    }
+}
+
+// true when every move of board hands the opponent a win, longest is the
+// longest of those wins
+static bool AllMovesLose(Generator *generator, Board *board, int *longest)
+{
+    static _Thread_local MoveList moveList = { 0 };
+    GenerateMoves(board, &moveList);
+
+    *longest = -1;
+    for(int i = 0; i < moveList.count; i++)
+    {
+        Move move = moveList.moves[i];
+        bool capture = board->map[move.target] != NONE;
+        Board child = *board;
+        MakeSearchMove(&child, move);
+
+        TBResult result;
+        if(!ChildResult(generator, &child, capture, &result) || result.wdl <= 0) return false;
+        if(result.dtm > *longest) *longest = result.dtm;
+    }
+    return moveList.count > 0;
+}
+
+// visits the positions one move before the ones decided in the last pass
+static void PassChunk(void *arg, int chunk)
+{
+    Generator *generator = arg;
+    TBMaterial *material = &generator->material;
+    uint64_t start = (uint64_t)chunk * CHUNK_SIZE;
+    uint64_t end = (start + CHUNK_SIZE < generator->size) ? start + CHUNK_SIZE : generator->size;
+    int pass = generator->pass;
+    uint8_t decided = EncodeDtm(pass - 1);
+    uint64_t changed = 0;
+
+    for(uint64_t index = start; index < end; index++)
+    {
+        if(generator->entries[index] != decided) continue;
+
+        // the index is the side to move followed by the squares in material order
+        int squares[TB_MAX_PIECES];
+        uint64_t rest = index;
+        for(int i = material->count - 1; i >= 0; i--)
+        {
+            squares[i] = rest % 144;
+            rest /= 144;
+        }
+        uint8_t mover = (rest == 1) ? WHITE : GRAY; // moved into this position
+        uint64_t flippedIndex = (rest == 1) ? index - generator->sideSize : index + generator->sideSize;
+
+        uint64_t weight = 1;
+        for(int i = material->count - 1; i >= 0; weight *= 144, i--)
+        {
+            uint8_t piece = material->pieces[i];
+            if(GetPieceColour(piece) != mover) continue;
+
+            int type = GetPieceType(piece);
+            for(int j = 0; j < originCount[type][squares[i]]; j++)
+            {
+                int origin = originSquares[type][squares[i]][j];
+                bool occupied = false;
+                for(int k = 0; k < material->count; k++) occupied = occupied || squares[k] == origin;
+                if(occupied) continue;
+
+                uint64_t parentIndex = flippedIndex - squares[i] * weight + origin * weight;
+                if(generator->entries[parentIndex] != ENTRY_UNKNOWN) continue;
+
+                Board parent;
+                TablebaseBoard(material, parentIndex, &parent);
+                if(!IsLegalMove(&parent, (Move) { .start = origin, .target = squares[i], .flag = NOFLAG })) continue;
+
+                if(pass & 1)
+                {
+                    generator->entries[parentIndex] = EncodeDtm(pass);
+                    changed++;
+                    continue;
+                }
+
+                int longest;
+                if(!AllMovesLose(generator, &parent, &longest)) continue;
+                if(longest == pass - 1)
+                {
+                    generator->entries[parentIndex] = EncodeDtm(pass);
+                    changed++;
+                }
+                else Defer(generator, chunk, parentIndex, longest + 1);
+            }
+        }
+    }
+
+    atomic_fetch_add(&generator->changed, changed);
+}
+
+// moves what the workers deferred into the bucket of its pass
+static void CollectDeferred(Generator *generator, int chunks)
+{
+    for(int chunk = 0; chunk < chunks; chunk++)
+    {
+        DeferredList *list = &generator->deferred[chunk];
+        for(size_t i = 0; i < list->count; i++) nob_da_append(&generator->buckets[list->items[i].pass], list->items[i].index);
+        list->count = 0;
+    }
+}
+
+static bool Generate(ThreadPool *pool, const char *directory, TBMaterial *material);
+
+// the tables a capture can lead to, every capturable piece removed once
+static int Submaterials(TBMaterial *material, TBMaterial submaterials[TB_MAX_PIECES])
+{
+    int count = 0;
+    for(int i = 0; i < material->count; i++)
+    {
+        uint8_t piece = material->pieces[i];
+        if(piece == (WHITE | KING) || piece == (GRAY | KING)) continue;
+        if(i > 0 && material->pieces[i-1] == piece) continue;
+
+        TBMaterial *submaterial = &submaterials[count++];
+        submaterial->count = 0;
+        for(int j = 0; j < material->count; j++) if(j != i) submaterial->pieces[submaterial->count++] = material->pieces[j];
+    }
+    return count;
+}
+
+// generates the tables captures lead to that aren't there yet
+static bool GenerateSubtables(ThreadPool *pool, const char *directory, TBMaterial *material)
+{
+    TBMaterial submaterials[TB_MAX_PIECES];
+    int count = Submaterials(material, submaterials);
+
+    for(int i = 0; i < count; i++)
+    {
+        Tablebases *tablebases = OpenTablebases(directory);
+        bool exists = PreloadTablebase(tablebases, &submaterials[i]);
+        CloseTablebases(tablebases);
+        if(!exists && !Generate(pool, directory, &submaterials[i])) return false;
+    }
+    return true;
+}
+
+static bool Generate(ThreadPool *pool, const char *directory, TBMaterial *material)
+{
+    char name[64];
+    char path[512];
+    TablebaseName(material, name, sizeof(name));
+    snprintf(path, sizeof(path), "%s/%s.tb", directory, name);
+
+    if(!GenerateSubtables(pool, directory, material)) return false;
+
+    // everything is mapped up front, the worker threads only read
+    Tablebases *subtables = OpenTablebases(directory);
+    TBMaterial submaterials[TB_MAX_PIECES];
+    int subtableCount = Submaterials(material, submaterials);
+    for(int i = 0; i < subtableCount; i++) PreloadTablebase(subtables, &submaterials[i]);
+
+    Generator generator = { .material = *material, .subtables = subtables, .size = TablebaseSize(material) };
+    generator.entries = malloc(generator.size);
+    if(generator.entries == NULL)
+    {
+        fprintf(stderr, "%s: could not allocate %llu bytes\n", name, (unsigned long long)generator.size);
+        CloseTablebases(subtables);
+        return false;
+    }
+
+    printf("%s: %llu positions\n", name, (unsigned long long)generator.size);
+    double start = GetMonotonicTime();
+    int chunks = (generator.size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    generator.sideSize = generator.size / 2;
+    generator.deferred = calloc(chunks, sizeof(DeferredList));
+    ParallelFor(pool, chunks, InitialiseChunk, &generator);
+    CollectDeferred(&generator, chunks);
+
+    for(int pass = 1; pass <= MAX_DTM; pass++)
+    {
+        // results held back by captures are final now unless something quicker was found
+        uint64_t changed = 0;
+        IndexList *bucket = &generator.buckets[pass];
+        for(size_t i = 0; i < bucket->count; i++)
+        {
+            if(generator.entries[bucket->items[i]] != ENTRY_UNKNOWN) continue;
+            generator.entries[bucket->items[i]] = EncodeDtm(pass);
+            changed++;
+        }
+
+        generator.pass = pass;
+        atomic_store(&generator.changed, 0);
+        ParallelFor(pool, chunks, PassChunk, &generator);
+        CollectDeferred(&generator, chunks);
+
+        changed += atomic_load(&generator.changed);
+        if(changed != 0) printf("\tpass %3d: %llu positions\n", pass, (unsigned long long)changed);
+
+        bool pending = false;
+        for(int later = pass + 1; later <= MAX_DTM; later++) pending = pending || generator.buckets[later].count > 0;
+        if(changed == 0 && !pending) break;
+    }
+
+    // dtm ignores the fifty-move rule, these wins need a capture or a pawn
+    // move on the way even from a fresh count and the server plays them out
+    uint64_t wins = 0, losses = 0, draws = 0, longWins = 0;
+    for(uint64_t index = 0; index < generator.size; index++)
+    {
+        uint8_t entry = generator.entries[index];
+        if(entry == ENTRY_ILLEGAL) generator.entries[index] = 0;
+        else if(entry == ENTRY_UNKNOWN || entry == 1)
+        {
+            generator.entries[index] = 1;
+            draws++;
+        }
+        else if((entry - 2) & 1)
+        {
+            int dtm = entry - 2;
+            wins++;
+            if((dtm + (dtm + 1) / 2) / 3 >= 50) longWins++;
+        }
+        else losses++;
+    }
+
+    bool ok = WriteTablebase(path, material, generator.entries);
+    printf("%s: %llu wins, %llu draws, %llu losses in %.2fs -> %s\n", name,
+           (unsigned long long)wins, (unsigned long long)draws, (unsigned long long)losses,
+           GetMonotonicTime() - start, ok ? path : "write failed");
+    if(longWins > 0) printf("%s: %llu wins take longer than the fifty-move rule allows\n", name, (unsigned long long)longWins);
+
+    for(int chunk = 0; chunk < chunks; chunk++) free(generator.deferred[chunk].items);
+    for(int pass = 0; pass <= MAX_DTM; pass++) free(generator.buckets[pass].items);
+    free(generator.deferred);
+    free(generator.entries);
+    CloseTablebases(subtables);
+    return ok;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <material> [options]\n", program);
+    printf("material is written per colour, the eliminated colour is always B: WKR-GK-BK\n");
+    printf("options:\n");
+    printf("\t--help:            print this message\n");
+    printf("\t--dir <directory>: where tables are read from and written to (default .)\n");
+    printf("\t--threads <n>:     worker threads, 0 for one per core (default 0)\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc == 0)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    char *materialName = NULL;
+    char *directory = ".";
+    int threads = 0;
+    while(argc > 0)
+    {
+        char *option = nob_shift_args(&argc, &argv);
+        if(strcmp(option, "--help") == 0)
+        {
+            PrintUsage(program);
+            return 0;
+        }
+        else if(strcmp(option, "--dir") == 0 && argc > 0)     directory = nob_shift_args(&argc, &argv);
+        else if(strcmp(option, "--threads") == 0 && argc > 0) threads = atoi(nob_shift_args(&argc, &argv));
+        else materialName = option;
+    }
+
+    TBMaterial material;
+    if(materialName == NULL || !ParseTablebaseName(materialName, &material))
+    {
+        fprintf(stderr, "invalid material, both W and G need a king and at most %d pieces fit\n", TB_MAX_PIECES);
+        return 1;
+    }
+
+    GenerateMoveData();
+    GenerateOrigins();
+    ThreadPool *pool = CreateThreadPool(threads);
+    printf("generating with %d threads\n", ThreadPoolSize(pool));
+    bool ok = Generate(pool, directory, &material);
+    DestroyThreadPool(pool);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,636 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./common/common.h"
+#include "../nob.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TUNER_X86
+#endif
+
+#define DEFAULT_SKIP_PLIES 8
+#define DEFAULT_EPOCHS     300
+#define DEFAULT_RATE       1.0
+#define SAMPLE_WIDTH       32    // features per colour in a sample, EVAL_PARAMETER_COUNT rounded up for the simd kernel
+#define CHUNK_SAMPLES      16384 // float sums over one chunk, the chunks are added up in doubles
+#define MAX_LINE           16384
+#define TUNE_MAGIC         "3MCTUNE"
+#define TUNE_VERSION       1
+
+// evaluation tuner
+//
+// fits the weights of the hand written evaluation to game results, texel
+// style. every weight multiplies a count (see EvaluationFeatures), so a
+// position only has to be looked at once: convert replays the games and
+// writes the counts of every colour with the result of the game to a sample
+// file, tune maps that file and runs gradient descent over it
+//
+// the colours still in get a share of the game each, the probability of a
+// colour is exp(score / K) over the sum of them (the logistic function for
+// three players) and the loss is the cross entropy against the points the
+// colour got. K is fitted to the current weights first, then the weights
+// move with adam, one full pass over the samples per step, spread over all
+// cores in chunks, with an avx2 kernel when the cpu has one
+//
+// the games are the lines booktool reads, xxx eliminates the colour to move
+// and the last token may be the result, the points of white, gray and black
+// like 0-1-0 or 1/2-0-1/2 (selfplay --out writes them). a game without one
+// counts when it ended in a checkmate or stalemate on the board, otherwise it
+// is skipped
+//
+// sample file, little endian:
+//  TuneHeader
+//  TuneSample samples[sampleCount]
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t parameterCount;
+    uint64_t sampleCount;
+    uint64_t reserved;
+} TuneHeader;
+
+typedef struct {
+    uint8_t features[3][SAMPLE_WIDTH]; // counts, saturated at 255
+    uint8_t points[3];                 // times 6, so halves and thirds are whole
+    uint8_t playing;                   // bit i set when colour i is still in
+    uint8_t reserved[4];
+} TuneSample;
+
+typedef struct {
+    TuneSample *items;
+    size_t count;
+    size_t capacity;
+} TuneSamples;
+
+typedef struct {
+    const char *text;
+    size_t size;
+    int skipPlies;
+    int chunkCount;
+    TuneSamples *chunks;
+    uint64_t *games;
+    uint64_t *skipped;    // no result or unreadable moves
+    uint64_t *saturated;  // samples with a count cut at 255
+    uint64_t *mismatches; // positions where the counts don't add up to Evaluate
+} Converter;
+
+// the points of white, gray and black in sixths, false if token isn't a result
+static bool ParseResult(const char *token, uint8_t points[3])
+{
+    const char *c = token;
+    for(int i = 0; i < 3; i++)
+    {
+        if(*c < '0' || *c > '9') return false;
+        int numerator = strtol(c, (char **)&c, 10);
+        int denominator = 1;
+        if(*c == '/')
+        {
+            c++;
+            denominator = strtol(c, (char **)&c, 10);
+        }
+        if(denominator <= 0 || numerator * 6 % denominator != 0 || numerator > denominator) return false;
+        points[i] = numerator * 6 / denominator;
+        if(i < 2 && *c++ != '-') return false;
+    }
+    return *c == '\0';
+}
+
+static uint8_t PlayingColours(Board *board)
+{
+    uint8_t playing = 0;
+    for(int i = 0; i < 3; i++) if(((i + 1) << 3) != board->eliminatedColour) playing |= 1 << i;
+    return playing;
+}
+
+// the counts of the position as a sample, false when they don't match Evaluate
+static bool MakeSample(Board *board, TuneSample *sample, bool *saturated)
+{
+    int features[3][EVAL_PARAMETER_COUNT];
+    int scores[3];
+    EvaluationFeatures(board, features);
+    Evaluate(board, scores);
+
+    *sample = (TuneSample) { .playing = PlayingColours(board) };
+    *saturated = false;
+    bool matches = true;
+    for(int i = 0; i < 3; i++)
+    {
+        int sum = 0;
+        for(int k = 0; k < EVAL_PARAMETER_COUNT; k++)
+        {
+            sum += features[i][k] * evalParameters[k];
+            *saturated = *saturated || features[i][k] > 255;
+            sample->features[i][k] = (features[i][k] > 255) ? 255 : features[i][k];
+        }
+        matches = matches && sum == scores[i];
+    }
+    return matches;
+}
+
+// keeps the quiet positions of the game from skipPlies on, they get the
+// result once the game is over
+static void ConvertGame(Converter *converter, int chunk, Board *board, char *line)
+{
+    static _Thread_local TuneSamples game = { 0 };
+    game.count = 0;
+    InitBoard(board, DEFAULT_FEN);
+
+    bool known = false;
+    uint8_t points[3];
+    int ply = 0;
+    char *cursor = line;
+    while(true)
+    {
+        while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r') cursor++;
+        if(*cursor == '\0') break;
+        char *token = cursor;
+        while(*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r') cursor++;
+        if(*cursor != '\0') *cursor++ = '\0';
+
+        if(token[strlen(token)-1] == '.') continue;
+        if(ParseResult(token, points))
+        {
+            known = true;
+            break;
+        }
+        if(strcmp(token, "xxx") == 0)
+        {
+            // the second one ends the game, only the result can follow
+            if(board->eliminatedColour != NONE) continue;
+            EliminateColour(board, board->colourToMove);
+            NextMove(board);
+            continue;
+        }
+
+        Move move;
+        if(!ParseMoveToken(board, token, &move))
+        {
+            converter->skipped[chunk]++;
+            return;
+        }
+
+        // a position where the colour to move is in check is about to change a lot
+        if(ply >= converter->skipPlies && HasLegalMove(board) && !InCheck())
+        {
+            TuneSample sample;
+            bool saturated;
+            if(!MakeSample(board, &sample, &saturated)) converter->mismatches[chunk]++;
+            if(saturated) converter->saturated[chunk]++;
+            nob_da_append(&game, sample);
+        }
+        MakeMove(board, move);
+        ply++;
+    }
+
+    // without a result only a game that ended on the board counts
+    if(!known)
+    {
+        if(board->eliminatedColour == NONE || HasLegalMove(board))
+        {
+            converter->skipped[chunk]++;
+            return;
+        }
+        bool mate = InCheck();
+        for(int i = 0; i < 3; i++)
+        {
+            uint8_t colour = (i + 1) << 3;
+            bool standing = colour != board->eliminatedColour && colour != board->colourToMove;
+            points[i] = (colour == board->eliminatedColour) ? 0 : mate ? (standing ? 6 : 0) : 3;
+        }
+    }
+
+    for(size_t i = 0; i < game.count; i++)
+    {
+        memcpy(game.items[i].points, points, 3);
+        nob_da_append(&converter->chunks[chunk], game.items[i]);
+    }
+    converter->games[chunk]++;
+}
+
+// lines that start inside a chunk belong to it, like in booktool.c
+static void ConvertChunk(void *arg, int chunk)
+{
+    Converter *converter = arg;
+    static _Thread_local Board board = { 0 };
+    static _Thread_local char line[MAX_LINE];
+    size_t start = converter->size * chunk / converter->chunkCount;
+    size_t end   = converter->size * (chunk + 1) / converter->chunkCount;
+    if(start > 0) while(start < converter->size && converter->text[start-1] != '\n') start++;
+
+    while(start < end)
+    {
+        size_t length = 0;
+        while(start + length < converter->size && converter->text[start + length] != '\n') length++;
+
+        if(length > 0 && length < sizeof(line) && converter->text[start] != '#')
+        {
+            memcpy(line, &converter->text[start], length);
+            line[length] = '\0';
+            ConvertGame(converter, chunk, &board, line);
+        }
+        else if(length >= sizeof(line)) converter->skipped[chunk]++;
+        start += length + 1;
+    }
+}
+
+static int Convert(const char *gamesPath, const char *samplesPath, int skipPlies, int threads)
+{
+    size_t size;
+    void *text = MapFile(gamesPath, &size);
+    if(text == NULL)
+    {
+        fprintf(stderr, "could not read %s\n", gamesPath);
+        return 1;
+    }
+
+    ThreadPool *pool = CreateThreadPool(threads);
+    Converter converter = { .text = text, .size = size, .skipPlies = skipPlies };
+    converter.chunkCount = ThreadPoolSize(pool) * 8;
+    converter.chunks     = calloc(converter.chunkCount, sizeof(TuneSamples));
+    converter.games      = calloc(converter.chunkCount, sizeof(uint64_t));
+    converter.skipped    = calloc(converter.chunkCount, sizeof(uint64_t));
+    converter.saturated  = calloc(converter.chunkCount, sizeof(uint64_t));
+    converter.mismatches = calloc(converter.chunkCount, sizeof(uint64_t));
+
+    double start = GetMonotonicTime();
+    ParallelFor(pool, converter.chunkCount, ConvertChunk, &converter);
+
+    uint64_t games = 0, skipped = 0, saturated = 0, mismatches = 0, samples = 0;
+    for(int i = 0; i < converter.chunkCount; i++)
+    {
+        games      += converter.games[i];
+        skipped    += converter.skipped[i];
+        saturated  += converter.saturated[i];
+        mismatches += converter.mismatches[i];
+        samples    += converter.chunks[i].count;
+    }
+
+    bool ok = false;
+    FILE *file = fopen(samplesPath, "wb");
+    if(file != NULL)
+    {
+        TuneHeader header = { .magic = TUNE_MAGIC, .version = TUNE_VERSION, .parameterCount = EVAL_PARAMETER_COUNT, .sampleCount = samples };
+        ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for(int i = 0; i < converter.chunkCount && ok; i++)
+        {
+            TuneSamples *chunk = &converter.chunks[i];
+            ok = fwrite(chunk->items, sizeof(TuneSample), chunk->count, file) == chunk->count;
+        }
+        ok = (fclose(file) == 0) && ok;
+    }
+
+    printf("%llu games (%llu skipped), %llu samples of %zu bytes in %.2fs on %d threads -> %s\n",
+           (unsigned long long)games, (unsigned long long)skipped, (unsigned long long)samples, sizeof(TuneSample),
+           GetMonotonicTime() - start, ThreadPoolSize(pool), ok ? samplesPath : "write failed");
+    if(saturated > 0) printf("%llu samples have a count over 255, it was cut\n", (unsigned long long)saturated);
+    if(mismatches > 0) printf("the counts don't add up to Evaluate on %llu positions, EvaluationFeatures is behind\n", (unsigned long long)mismatches);
+
+    for(int i = 0; i < converter.chunkCount; i++) free(converter.chunks[i].items);
+    free(converter.chunks);
+    free(converter.games);
+    free(converter.skipped);
+    free(converter.saturated);
+    free(converter.mismatches);
+    DestroyThreadPool(pool);
+    UnmapFile(text, size);
+    return ok ? 0 : 1;
+}
+
+typedef struct {
+    const TuneSample *samples;
+    uint64_t count;
+    int chunkCount;
+    float weights[SAMPLE_WIDTH]; // divided by K
+    double *losses;              // per chunk
+    double *gradients;           // per chunk, SAMPLE_WIDTH each, of the loss over the scaled weights
+} Pass;
+
+// adds the loss of one sample given its three scaled scores and returns the
+// factor every colour's counts go into the gradient with
+static inline double SampleLoss(const TuneSample *sample, float scores[3], float factors[3])
+{
+    float highest = -INFINITY;
+    for(int i = 0; i < 3; i++) if((sample->playing >> i) & 1 && scores[i] > highest) highest = scores[i];
+
+    float exps[3], sum = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        exps[i] = ((sample->playing >> i) & 1) ? expf(scores[i] - highest) : 0;
+        sum += exps[i];
+    }
+
+    double loss = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        float p = exps[i] / sum;
+        float y = sample->points[i] / 6.0f;
+        factors[i] = p - y;
+        if(y > 0) loss -= y * logf((p > 1e-12f) ? p : 1e-12f);
+    }
+    return loss;
+}
+
+static double PassScalar(const Pass *pass, const TuneSample *samples, int count, float gradient[SAMPLE_WIDTH])
+{
+    double loss = 0;
+    for(int n = 0; n < count; n++)
+    {
+        const TuneSample *sample = &samples[n];
+        float scores[3], factors[3];
+        for(int i = 0; i < 3; i++)
+        {
+            float score = 0;
+            for(int k = 0; k < SAMPLE_WIDTH; k++) score += pass->weights[k] * sample->features[i][k];
+            scores[i] = score;
+        }
+
+        loss += SampleLoss(sample, scores, factors);
+        for(int i = 0; i < 3; i++)
+        {
+            if(factors[i] == 0) continue;
+            for(int k = 0; k < SAMPLE_WIDTH; k++) gradient[k] += factors[i] * sample->features[i][k];
+        }
+    }
+    return loss;
+}
+
+#ifdef TUNER_X86
+// the 32 counts of a colour as four vectors of 8 floats
+__attribute__((target("avx2,fma")))
+static inline void LoadFeatures(const uint8_t *features, __m256 out[4])
+{
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)features);
+    __m128i low  = _mm256_castsi256_si128(bytes);
+    __m128i high = _mm256_extracti128_si256(bytes, 1);
+    out[0] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(low));
+    out[1] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+    out[2] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(high));
+    out[3] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+}
+
+__attribute__((target("avx2,fma")))
+static double PassAVX2(const Pass *pass, const TuneSample *samples, int count, float gradient[SAMPLE_WIDTH])
+{
+    __m256 weights[4], sums[4];
+    for(int j = 0; j < 4; j++)
+    {
+        weights[j] = _mm256_loadu_ps(&pass->weights[j * 8]);
+        sums[j]    = _mm256_setzero_ps();
+    }
+
+    double loss = 0;
+    for(int n = 0; n < count; n++)
+    {
+        const TuneSample *sample = &samples[n];
+        __m256 features[3][4];
+        float scores[3], factors[3];
+        for(int i = 0; i < 3; i++)
+        {
+            LoadFeatures(sample->features[i], features[i]);
+            __m256 dot = _mm256_mul_ps(features[i][0], weights[0]);
+            dot = _mm256_fmadd_ps(features[i][1], weights[1], dot);
+            dot = _mm256_fmadd_ps(features[i][2], weights[2], dot);
+            dot = _mm256_fmadd_ps(features[i][3], weights[3], dot);
+            __m128 half = _mm_add_ps(_mm256_castps256_ps128(dot), _mm256_extractf128_ps(dot, 1));
+            half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+            scores[i] = _mm_cvtss_f32(half);
+        }
+
+        loss += SampleLoss(sample, scores, factors);
+        for(int i = 0; i < 3; i++)
+        {
+            if(factors[i] == 0) continue;
+            __m256 factor = _mm256_set1_ps(factors[i]);
+            for(int j = 0; j < 4; j++) sums[j] = _mm256_fmadd_ps(factor, features[i][j], sums[j]);
+        }
+    }
+
+    for(int j = 0; j < 4; j++) _mm256_storeu_ps(&gradient[j * 8], _mm256_add_ps(_mm256_loadu_ps(&gradient[j * 8]), sums[j]));
+    return loss;
+}
+#endif
+
+static double (*PassKernel)(const Pass *pass, const TuneSample *samples, int count, float gradient[SAMPLE_WIDTH]) = PassScalar;
+
+static const char *SelectTunerKernel(bool allowSimd)
+{
+    PassKernel = PassScalar;
+#ifdef TUNER_X86
+    if(allowSimd && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        PassKernel = PassAVX2;
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+static void PassChunk(void *arg, int chunk)
+{
+    Pass *pass = arg;
+    uint64_t start = (uint64_t)chunk * CHUNK_SAMPLES;
+    int count = (pass->count - start < CHUNK_SAMPLES) ? (int)(pass->count - start) : CHUNK_SAMPLES;
+
+    float gradient[SAMPLE_WIDTH] = { 0 };
+    pass->losses[chunk] = PassKernel(pass, &pass->samples[start], count, gradient);
+    for(int k = 0; k < SAMPLE_WIDTH; k++) pass->gradients[chunk * SAMPLE_WIDTH + k] = gradient[k];
+}
+
+// the mean loss of the weights over all samples, and its gradient over the
+// unscaled weights when gradient isn't NULL. the sums don't depend on the
+// number of threads
+static double RunPass(ThreadPool *pool, Pass *pass, const double weights[SAMPLE_WIDTH], double K, double gradient[SAMPLE_WIDTH])
+{
+    for(int k = 0; k < SAMPLE_WIDTH; k++) pass->weights[k] = weights[k] / K;
+    ParallelFor(pool, pass->chunkCount, PassChunk, pass);
+
+    double loss = 0;
+    if(gradient != NULL) memset(gradient, 0, sizeof(double) * SAMPLE_WIDTH);
+    for(int chunk = 0; chunk < pass->chunkCount; chunk++)
+    {
+        loss += pass->losses[chunk];
+        if(gradient == NULL) continue;
+        for(int k = 0; k < SAMPLE_WIDTH; k++) gradient[k] += pass->gradients[chunk * SAMPLE_WIDTH + k];
+    }
+    if(gradient != NULL) for(int k = 0; k < SAMPLE_WIDTH; k++) gradient[k] /= K * pass->count;
+    return loss / pass->count;
+}
+
+// golden section search on log K, the loss is smooth and has one minimum there
+static double FitK(ThreadPool *pool, Pass *pass, const double weights[SAMPLE_WIDTH])
+{
+    const double ratio = 0.6180339887498949;
+    double low = log(10.0), high = log(5000.0);
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double lossA = RunPass(pool, pass, weights, exp(a), NULL);
+    double lossB = RunPass(pool, pass, weights, exp(b), NULL);
+    for(int i = 0; i < 32; i++)
+    {
+        if(lossA < lossB)
+        {
+            high = b;
+            b = a, lossB = lossA;
+            a = high - ratio * (high - low);
+            lossA = RunPass(pool, pass, weights, exp(a), NULL);
+        }
+        else
+        {
+            low = a;
+            a = b, lossA = lossB;
+            b = low + ratio * (high - low);
+            lossB = RunPass(pool, pass, weights, exp(b), NULL);
+        }
+    }
+    return exp((low + high) / 2);
+}
+
+static int Tune(const char *samplesPath, int epochs, double rate, double fixedK, int threads, bool allowSimd)
+{
+    size_t size;
+    void *data = MapFile(samplesPath, &size);
+    TuneHeader *header = data;
+    if(data == NULL || size < sizeof(TuneHeader) || memcmp(header->magic, TUNE_MAGIC, sizeof(TUNE_MAGIC)) != 0 ||
+       header->version != TUNE_VERSION || header->parameterCount != EVAL_PARAMETER_COUNT ||
+       size < sizeof(TuneHeader) + header->sampleCount * sizeof(TuneSample) || header->sampleCount == 0)
+    {
+        fprintf(stderr, "%s is not a sample file for these parameters, convert the games again\n", samplesPath);
+        if(data != NULL) UnmapFile(data, size);
+        return 1;
+    }
+
+    ThreadPool *pool = CreateThreadPool(threads);
+    Pass pass = { .samples = (const TuneSample *)(header + 1), .count = header->sampleCount };
+    pass.chunkCount = (pass.count + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+    pass.losses     = calloc(pass.chunkCount, sizeof(double));
+    pass.gradients  = calloc((size_t)pass.chunkCount * SAMPLE_WIDTH, sizeof(double));
+    const char *kernel = SelectTunerKernel(allowSimd);
+
+    double weights[SAMPLE_WIDTH] = { 0 };
+    for(int k = 0; k < EVAL_PARAMETER_COUNT; k++) weights[k] = evalParameters[k];
+
+    double start = GetMonotonicTime();
+    double K = (fixedK > 0) ? fixedK : FitK(pool, &pass, weights);
+    double initialLoss = RunPass(pool, &pass, weights, K, NULL);
+    printf("%llu samples (%.0fMB) on %d threads with the %s kernel, K %.1f, loss %.6f\n",
+           (unsigned long long)pass.count, size / (1024.0 * 1024.0), ThreadPoolSize(pool), kernel, K, initialLoss);
+
+    // adam, the rate is how far a weight may move per step in centipawns
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    double moments[SAMPLE_WIDTH] = { 0 }, velocities[SAMPLE_WIDTH] = { 0 }, gradient[SAMPLE_WIDTH];
+    double loss = initialLoss;
+    double tuneStart = GetMonotonicTime();
+    for(int epoch = 1; epoch <= epochs; epoch++)
+    {
+        loss = RunPass(pool, &pass, weights, K, gradient);
+        for(int k = 0; k < EVAL_PARAMETER_COUNT; k++)
+        {
+            moments[k]    = beta1 * moments[k] + (1 - beta1) * gradient[k];
+            velocities[k] = beta2 * velocities[k] + (1 - beta2) * gradient[k] * gradient[k];
+            double moment   = moments[k] / (1 - pow(beta1, epoch));
+            double velocity = velocities[k] / (1 - pow(beta2, epoch));
+            weights[k] -= rate * moment / (sqrt(velocity) + epsilon);
+        }
+        if(epoch % 25 == 0 || epoch == epochs)
+        {
+            double elapsed = GetMonotonicTime() - tuneStart;
+            printf("epoch %4d: loss %.6f, %.3fs per epoch, %.0f samples/s\n", epoch, loss, elapsed / epoch, pass.count * epoch / elapsed);
+        }
+    }
+    loss = RunPass(pool, &pass, weights, K, NULL);
+
+    printf("===========================\n");
+    printf("loss %.6f -> %.6f in %.1fs, evalParameters for eval.c:\n", initialLoss, loss, GetMonotonicTime() - start);
+    for(int k = 0; k < EVAL_PARAMETER_COUNT; k++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "[%s]", evalParameterNames[k]);
+        printf("    %-24s = %d, // was %d\n", name, (int)lround(weights[k]), evalParameters[k]);
+    }
+
+    free(pass.losses);
+    free(pass.gradients);
+    DestroyThreadPool(pool);
+    UnmapFile(data, size);
+    return 0;
+}
+
+void PrintUsage(char *program)
+{
+    printf("usage: %s <command> [options]\n", program);
+    printf("commands:\n");
+    printf("\tconvert <games> <samples> [options]: replay the games, one per line, into a sample file\n");
+    printf("\t    --skip <plies>:    leave out the positions before this ply (default %d)\n", DEFAULT_SKIP_PLIES);
+    printf("\t    --threads <n>:     0 for one per core (default 0)\n");
+    printf("\ttune <samples> [options]:            fit the evaluation weights to the results and print them\n");
+    printf("\t    --epochs <n>:      full passes over the samples (default %d)\n", DEFAULT_EPOCHS);
+    printf("\t    --rate <cp>:       adam step size in centipawns (default %g)\n", DEFAULT_RATE);
+    printf("\t    --k <K>:           keep the score scale at K instead of fitting it\n");
+    printf("\t    --threads <n>:     0 for one per core (default 0)\n");
+    printf("\t    --scalar:          don't use the avx2 kernel\n");
+}
+
+int main(int argc, char **argv)
+{
+    char *program = nob_shift_args(&argc, &argv);
+    if(argc < 2)
+    {
+        PrintUsage(program);
+        return 1;
+    }
+
+    GenerateMoveData();
+    InitEvaluation();
+    char *command = nob_shift_args(&argc, &argv);
+
+    if(strcmp(command, "convert") == 0 && argc >= 2)
+    {
+        char *gamesPath   = nob_shift_args(&argc, &argv);
+        char *samplesPath = nob_shift_args(&argc, &argv);
+        int skipPlies = DEFAULT_SKIP_PLIES;
+        int threads = 0;
+        while(argc > 0)
+        {
+            char *option = nob_shift_args(&argc, &argv);
+            if(strcmp(option, "--skip") == 0 && argc > 0)         skipPlies = atoi(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--threads") == 0 && argc > 0) threads = atoi(nob_shift_args(&argc, &argv));
+            else
+            {
+                PrintUsage(program);
+                return 1;
+            }
+        }
+        return Convert(gamesPath, samplesPath, skipPlies, threads);
+    }
+
+    if(strcmp(command, "tune") == 0)
+    {
+        char *samplesPath = nob_shift_args(&argc, &argv);
+        int epochs = DEFAULT_EPOCHS;
+        double rate = DEFAULT_RATE;
+        double K = 0;
+        int threads = 0;
+        bool allowSimd = true;
+        while(argc > 0)
+        {
+            char *option = nob_shift_args(&argc, &argv);
+            if(strcmp(option, "--epochs") == 0 && argc > 0)       epochs = atoi(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--rate") == 0 && argc > 0)    rate = atof(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--k") == 0 && argc > 0)       K = atof(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--threads") == 0 && argc > 0) threads = atoi(nob_shift_args(&argc, &argv));
+            else if(strcmp(option, "--scalar") == 0)              allowSimd = false;
+            else
+            {
+                PrintUsage(program);
+                return 1;
+            }
+        }
+        return Tune(samplesPath, epochs, rate, K, threads, allowSimd);
+    }
+
+    PrintUsage(program);
+    return 1;
+}